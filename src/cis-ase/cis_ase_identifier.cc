@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.  */
 #define __STDC_LIMIT_MACROS
 #endif
 
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <cmath>
@@ -102,7 +103,6 @@ void CisAseIdentifier::parse_options(int argc, char* argv[]) {
         tumor_rna_ = string(argv[optind++]);
         ref_ = string(argv[optind++]);
         gtf_ = string(argv[optind++]);
-        gtf_parser_.set_gtffile(gtf_);
     }
     if(optind < argc ||
        somatic_vcf_ == "NA" ||
@@ -318,37 +318,37 @@ bool CisAseIdentifier::process_rna_hom(bcf_hdr_t* bcf_hdr, int tid,
 BED CisAseIdentifier::get_relevant_window(const char* chr, int pos) {
     CHRPOS min_start = pos;
     CHRPOS max_end = pos;
-    BIN start_bin = pos >> _binFirstShift;
-    BIN end_bin = pos >> _binFirstShift;
-    for (BINLEVEL i = 0; i < _binLevels; ++i) {
-        BIN offset = _binOffsetsExtended[i];
-        for (BIN b = (start_bin + offset); b <= (end_bin + offset); ++b) {
-            vector<string> transcripts = gtf_parser_.transcripts_from_bin(chr, b);
-            for(std::size_t i = 0; i < transcripts.size(); i++) {
-                const vector<BED> & exons =
-                    gtf_parser_.get_exons_from_transcript(transcripts[i]);
-                //check if transcript within the window
-                string transcript_strand = exons[0].strand;
-                if(is_variant_within_transcript_window(exons, pos, transcript_strand,
-                                            transcript_variant_window_)) {
-                    int last_exon = exons.size() - 1;
-                    if(exons[0].start < min_start) {
-                        min_start = exons[0].start;
-                    }
-                    if(exons[last_exon].start < min_start) {
-                        min_start = exons[last_exon].start;
-                    }
-                    if(exons[last_exon].end > max_end) {
-                        max_end = exons[last_exon].end;
-                    }
-                    if(exons[0].end > max_end) {
-                        max_end = exons[0].end;
-                    }
-                }
+    CHRPOS window_start = (CHRPOS) pos > transcript_variant_window_ ?
+                          pos - transcript_variant_window_ : 0;
+    CHRPOS window_end = pos + transcript_variant_window_;
+    const ContigTranscripts * contig = gtf_parser_->contig_transcripts(chr);
+    if(contig == NULL) {
+        return BED(chr, min_start, max_end);
+    }
+    const TranscriptIndex & index = contig->index();
+    size_t first, last;
+    index.overlap(window_start, window_end, first, last);
+    for(size_t i = first; i < last; i++) {
+        if(!index.overlaps(i, window_start, window_end))
+            continue;
+        ExonView exons = contig->exons(index.transcript(i));
+        //check if transcript within the window
+        if(is_variant_within_transcript_window(exons, pos,
+                                    transcript_variant_window_)) {
+            int last_exon = exons.size() - 1;
+            if(exons[0].start < min_start) {
+                min_start = exons[0].start;
+            }
+            if(exons[last_exon].start < min_start) {
+                min_start = exons[last_exon].start;
+            }
+            if(exons[last_exon].end > max_end) {
+                max_end = exons[last_exon].end;
+            }
+            if(exons[0].end > max_end) {
+                max_end = exons[0].end;
             }
         }
-        start_bin >>= _binNextShift;
-        end_bin >>= _binNextShift;
     }
     return BED(chr, min_start, max_end);
 }
@@ -387,75 +387,63 @@ void CisAseIdentifier::open_poly_vcf() {
     }
 }
 
-//Given a chr,start,end get all the level7 bins
-vector<BIN> get_bins_in_region(CHRPOS start, CHRPOS end) {
-    vector<BIN> bins;
-    BIN start_bin = start >> _binFirstShift;
-    BIN end_bin = end >> _binFirstShift;
-    BINLEVEL i = 0;
-    BIN offset = _binOffsetsExtended[i];
-    for (BIN b = (start_bin + offset); b <= (end_bin + offset); ++b) {
-        bins.push_back(b);
-    }
-    return bins;
-}
-
 //Get the information for SNPs within relevant window
 void CisAseIdentifier::process_snps_in_window(string somatic_region, BED region) {
     std::cerr << "\ninside process_snps " << region << endl;
-    vector<BIN> bins = get_bins_in_region(region.start, region.end);
-    for(vector<BIN>::iterator bin_it = bins.begin(); bin_it != bins.end(); ++bin_it) {
-        string index = construct_chrom_bin_index(region.chrom, *bin_it);
-        if(bin_to_exonic_variants_.find(index) != bin_to_exonic_variants_.end()) {
-            vector<AnnotatedVariant> variants = bin_to_exonic_variants_[index];
-            for(vector<AnnotatedVariant>::iterator variant_it = variants.begin();
-                    variant_it != variants.end(); ++variant_it) {
-                AnnotatedVariant variant = *variant_it;
-                string snp_region = common::create_region_string(variant.chrom.c_str(), variant.start, variant.end);
-                cerr << endl << "snp region is " << snp_region << endl;
-                //Check if SNP analyzed in RNA before
-                if(rna_snps_.count(snp_region)) {
-                    cerr << endl << "Variant in map - already analyzed";
-                    if(!rna_snps_[snp_region].is_het_dna) {
-                        cerr << "rna is hom, now running DNA snp-mpileup" << endl;
-                        //If RNA has been analyzed for the SNP so has DNA
-                        if(dna_snps_.count(snp_region)) {
-                            if(dna_snps_[snp_region].is_het_dna) {
-                                cerr << "DNA is het. potential ASE " << snp_region << endl;
-                            } else {
-                                cerr << "DNA not het" << endl;
-                            }
+    map<string, vector<AnnotatedVariant> >::const_iterator chrom_it =
+        exonic_variants_.find(region.chrom);
+    if(chrom_it != exonic_variants_.end()) {
+        const vector<AnnotatedVariant> &variants = chrom_it->second;
+        //Binary search for the first variant in the window
+        for(vector<AnnotatedVariant>::const_iterator variant_it =
+                lower_bound(variants.begin(), variants.end(),
+                            region.start, variant_start_less);
+                variant_it != variants.end() &&
+                variant_it->start <= region.end; ++variant_it) {
+            const AnnotatedVariant &variant = *variant_it;
+            string snp_region = common::create_region_string(variant.chrom.c_str(), variant.start, variant.end);
+            cerr << endl << "snp region is " << snp_region << endl;
+            //Check if SNP analyzed in RNA before
+            if(rna_snps_.count(snp_region)) {
+                cerr << endl << "Variant in map - already analyzed";
+                if(!rna_snps_[snp_region].is_het_dna) {
+                    cerr << "rna is hom, now running DNA snp-mpileup" << endl;
+                    //If RNA has been analyzed for the SNP so has DNA
+                    if(dna_snps_.count(snp_region)) {
+                        if(dna_snps_[snp_region].is_het_dna) {
+                            cerr << "DNA is het. potential ASE " << snp_region << endl;
+                        } else {
+                            cerr << "DNA not het" << endl;
                         }
-                    } else {
-                        cerr << "rna not hom" << endl;
                     }
-                    break;
+                } else {
+                    cerr << "rna not hom" << endl;
                 }
-                cerr << "running rna mpileup" << endl;
-                set_mpileup_conf_region(germline_conf_, snp_region);
-                //Reset ouput vcf line
-                vcf_op_.reset();
-                vcf_op_.set_somatic_region(somatic_region);
-                //Check if hom in RNA
+                continue;
+            }
+            cerr << "running rna mpileup" << endl;
+            set_mpileup_conf_region(germline_conf_, snp_region);
+            //Reset ouput vcf line
+            vcf_op_.reset();
+            vcf_op_.set_somatic_region(somatic_region);
+            //Check if hom in RNA
+            if(mpileup_run(&germline_conf_,
+                        &CisAseIdentifier::process_rna_hom,
+                        germline_rna_mmc_)) {
+                cerr << "rna is hom, now running DNA snp-mpileup" << endl;
+                //Check if het in DNA
                 if(mpileup_run(&germline_conf_,
-                            &CisAseIdentifier::process_rna_hom,
-                            germline_rna_mmc_)) {
-                    cerr << "rna is hom, now running DNA snp-mpileup" << endl;
-                    //Check if het in DNA
-                    if(mpileup_run(&germline_conf_,
-                                &CisAseIdentifier::process_germline_het,
-                                germline_dna_mmc_)) {
-                        cerr << "DNA is het. potential ASE " << snp_region << endl;
-                        vcf_op_.print_line(ofs_);
-                    } else {
-                        cerr << "DNA not het" << endl;
-                    }
+                            &CisAseIdentifier::process_germline_het,
+                            germline_dna_mmc_)) {
+                    cerr << "DNA is het. potential ASE " << snp_region << endl;
+                    vcf_op_.print_line(ofs_);
                 } else {
-                    cerr << "rna not hom" << endl;
+                    cerr << "DNA not het" << endl;
                 }
-                free_mpileup_conf(germline_conf_);
-                //bcf_destroy(line);
+            } else {
+                cerr << "rna not hom" << endl;
             }
+            free_mpileup_conf(germline_conf_);
         }
     }
 }
@@ -493,8 +481,8 @@ void CisAseIdentifier::cleanup() {
 }
 
 //create the map, where list of exonic variants are
-//indexed by "chr:bin"
-//map<bin, vector<AnnotatedVariant>> bin_to_exonic_variants_;
+//indexed by chr and sorted by start
+//map<chr, vector<AnnotatedVariant>> exonic_variants_;
 void CisAseIdentifier::annotate_exonic_polymorphisms() {
     bool all_exonic = true;
     bool all_intronic = false;
@@ -506,22 +494,26 @@ void CisAseIdentifier::annotate_exonic_polymorphisms() {
         AnnotatedVariant v1 = va.annotate_record_with_transcripts();
         if(relevant_poly_annot_ == "NA" ||
            v1.annotation.find(relevant_poly_annot_) != string::npos) {
-            BIN bin1 = getBin(v1.start, v1.start);
-            string index = construct_chrom_bin_index(v1.chrom, bin1);
-            bin_to_exonic_variants_[index].push_back(v1);
+            exonic_variants_[v1.chrom].push_back(v1);
             /*cerr << endl << "Variant is " << v1.chrom << " " << v1.start
-                 << " " << v1.end << " " << v1.annotation
-                 << " BIN: " << bin1 << " index " << index;*/
+                 << " " << v1.end << " " << v1.annotation;*/
         }
     }
-    cerr << "Size of vector is " << bin_to_exonic_variants_.size();
+    //The poly-vcf is usually sorted, keep the input order for ties
+    for(map<string, vector<AnnotatedVariant> >::iterator chrom_it =
+            exonic_variants_.begin(); chrom_it != exonic_variants_.end();
+            ++chrom_it) {
+        stable_sort(chrom_it->second.begin(), chrom_it->second.end(),
+                    compare_variant_starts);
+    }
+    cerr << "Size of vector is " << exonic_variants_.size();
 }
 
 //The workflow starts here
 void CisAseIdentifier::run() {
     mmc_init_all(); //load all the mmcs
     load_reference(); //load reference genome
-    gtf_parser_.load(); //load gene annotations
+    gtf_parser_ = load_annotation(gtf_); //load gene annotations
     set_ostream(); //Set the output stream
     annotate_exonic_polymorphisms();
     open_somatic_vcf();
@@ -55,9 +55,16 @@ extern "C" {
     void set_data_iter(mplp_conf_t *conf, char** fn, mplp_aux_t **data, int *beg0, int *end0);
 }
 
-//Return a string which is "chr:bin"
-inline string construct_chrom_bin_index(string chrom, BIN bin1) {
-    return chrom + ":" + common::num_to_str(bin1);
+//Order variants by start, used to search the exonic variants
+//of a contig without any limit on the contig length
+inline bool variant_start_less(const AnnotatedVariant &v1, CHRPOS pos) {
+    return v1.start < pos;
+}
+
+//Order variants by start
+inline bool compare_variant_starts(const AnnotatedVariant &v1,
+                                   const AnnotatedVariant &v2) {
+    return v1.start < v2.start;
 }
 
 //Results of genotype call
@@ -350,8 +357,8 @@ inline void free_mpileup_conf(mplp_conf_t conf) {
 //Workhorse for "cis-ase identify"
 class CisAseIdentifier {
     private:
-        //GTF parser object - holds the GTF in memory
-        GtfParser gtf_parser_;
+        //Loaded annotation - holds the GTF in memory
+        GtfHandle gtf_parser_;
         //Minimum depth to consider somatic/ASE
         uint32_t min_depth_;
         //Window around somatic variants to look for transcripts
@@ -402,8 +409,8 @@ class CisAseIdentifier {
         map<string, locus_info> rna_snps_;
         //Use binomial model for modeling ase?
         bool use_binomial_model_;
-        //list of exonic variants indexed by "chr:BIN"
-        map<string, vector<AnnotatedVariant> > bin_to_exonic_variants_;
+        //list of exonic variants indexed by chr, sorted by start
+        map<string, vector<AnnotatedVariant> > exonic_variants_;
         //Output VCF record
         VcfRecord vcf_op_;
     public:
@@ -474,7 +481,7 @@ class CisAseIdentifier {
         //init mmcs
         void mmc_init_all();
         //create the map, where list of exonic variants are
-        //indexed by "chr:bin"
+        //indexed by chr and sorted by start
         void annotate_exonic_polymorphisms();
         //If output file is not empty, attempt to open
         //If output file is empty, set to cout
@@ -42,6 +42,11 @@ void CisSpliceEffectsIdentifier::usage(ostream& out) {
         << "\n\t\t\t" << "The tool identifies events in variant.start +/- w basepairs."
         << "\n\t\t\t" << "Default behaviour is to look at the window between previous and next exons.";
     out << "\n\t\t" << "-j STR Output file containing the aberrant junctions in BED12 format.";
+    out << "\n\t\t" << "-p\tRead the reference from a 2-bit packed copy, ref.fa.packed."
+        << "\n\t\t\t" << "It is built on first use and shared by later runs.";
+    out << "\n\t\t" << "-s DIR\tReport the MaxEntScan scores of the donor and acceptor of each junction,"
+        << "\n\t\t\t" << "donor_score and acceptor_score. DIR is the MaxEntScan directory"
+        << "\n\t\t\t" << "with me2x5 and splicemodels/.";
     out << "\n";
 }
 
@@ -89,7 +94,7 @@ void CisSpliceEffectsIdentifier::parse_options(int argc, char* argv[]) {
     optind = 1; //Reset before parsing again.
     stringstream help_ss;
     char c;
-    while((c = getopt(argc, argv, "o:w:v:j:h")) != -1) {
+    while((c = getopt(argc, argv, "o:w:v:j:ps:h")) != -1) {
         switch(c) {
             case 'o':
                 output_file_ = string(optarg);
@@ -103,6 +108,12 @@ void CisSpliceEffectsIdentifier::parse_options(int argc, char* argv[]) {
             case 'j':
                 output_junctions_bed_ = string(optarg);
                 break;
+            case 'p':
+                use_packed_reference_ = true;
+                break;
+            case 's':
+                splice_models_ = string(optarg);
+                break;
             case 'h':
                 usage(help_ss);
                 throw common::cmdline_help_exception(help_ss.str());
@@ -126,6 +137,12 @@ void CisSpliceEffectsIdentifier::parse_options(int argc, char* argv[]) {
         throw runtime_error("\nError parsing inputs!(2)\n");
     }
     file_qc();
+    //Loaded before the alignments are read, so bad models fail early
+    if(splice_models_ != "NA") {
+        shared_ptr<SpliceSiteScorer> scorer(new SpliceSiteScorer);
+        scorer->load(splice_models_);
+        splice_scorer_ = scorer;
+    }
     cerr << "\nVariant file: " << vcf_;
     cerr << "\nAlignment file: " << bam_;
     cerr << "\nReference fasta file: " << ref_;
@@ -137,6 +154,8 @@ void CisSpliceEffectsIdentifier::parse_options(int argc, char* argv[]) {
         cerr << "\nOutput file: " << output_file_;
     if(output_junctions_bed_ != "NA")
         cerr << "\nOutput junctions BED file: " << output_junctions_bed_;
+    if(splice_models_ != "NA")
+        cerr << "\nSplice site models: " << splice_models_;
     if(annotated_variant_file_ != "NA") {
         cerr << "\nAnnotated variants file: " << annotated_variant_file_;
         write_annotated_variants_ = true;
@@ -145,12 +164,14 @@ void CisSpliceEffectsIdentifier::parse_options(int argc, char* argv[]) {
 }
 
 //Call the junctions annotator
-void CisSpliceEffectsIdentifier::annotate_junctions(const GtfParser& gp1) {
+void CisSpliceEffectsIdentifier::annotate_junctions(GtfHandle gp1) {
     JunctionsAnnotator ja1(ref_, gp1);
-    ja1.set_gtf_parser(gp1);
+    ja1.set_use_packed_reference(use_packed_reference_);
+    ja1.set_splice_scorer(splice_scorer_);
     set_ostream();
     //Annotate the junctions in the set and write to file
-    AnnotatedJunction::print_header(ofs_, true);
+    AnnotatedJunction::print_header(ofs_, true, vector<string>(),
+                                    ja1.score_splice_sites());
     int i = 0;
     //This is ugly, waiting to start using C++11/14
     for (set<Junction>::iterator j1 = unique_junctions_.begin(); j1 != unique_junctions_.end(); j1++) {
@@ -179,9 +200,8 @@ string CisSpliceEffectsIdentifier::get_junction_name(int i) {
 
 //The workhorse
 void CisSpliceEffectsIdentifier::identify() {
-    //GTF parser object
-    GtfParser gp1(gtf_);
-    gp1.load();
+    //Annotation, loaded once and shared by both annotators
+    GtfHandle gp1 = load_annotation(gtf_);
     //variant annotator
     VariantsAnnotator va(vcf_, gp1, annotated_variant_file_);
     va.open_vcf_in();
@@ -56,6 +56,12 @@ class CisSpliceEffectsIdentifier {
         //Window size to look in
         //Looks at variant.pos +/- window_size
         uint32_t window_size_;
+        //Read the reference from a 2-bit packed copy
+        bool use_packed_reference_;
+        //MaxEntScan directory of -s, NA to not score the splice sites
+        string splice_models_;
+        //Scores the donor and acceptor of each junction with -s
+        shared_ptr<const SpliceSiteScorer> splice_scorer_;
         //output stream to output annotated junctions file
         ofstream ofs_;
         //output stream to output BED12 junctions file
@@ -70,7 +76,9 @@ class CisSpliceEffectsIdentifier {
                                        output_junctions_bed_("NA"),
                                        annotated_variant_file_("NA"),
                                        write_annotated_variants_(false),
-                                       window_size_(0) {}
+                                       window_size_(0),
+                                       use_packed_reference_(false),
+                                       splice_models_("NA") {}
         //Destructor
         ~CisSpliceEffectsIdentifier() {
             if(ofs_.is_open()) {
@@ -102,7 +110,7 @@ class CisSpliceEffectsIdentifier {
         //Get the Input VCF
         string vcf() { return vcf_; }
         //Call the junctions annotator
-        void annotate_junctions(const GtfParser& gtf_p1);
+        void annotate_junctions(GtfHandle gtf_p1);
         //Get junction name given an index
         string get_junction_name(int i);
 };
@@ -23,6 +23,7 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.  */
 
 #include <cassert>
+#include <cctype>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
@@ -37,16 +38,6 @@ DEALINGS IN THE SOFTWARE.  */
 
 using namespace std;
 
-//Sort exons by start - positive strand
-bool sort_by_start_ps(const BED & a, const BED & b) {
-    return a.start < b.start;
-}
-
-//Sort exons by start - negative strand
-bool sort_by_start_ns(const BED & a, const BED & b) {
-    return a.start > b.start;
-}
-
 //Open the GTF file.
 void GtfParser::open() {
     gtf_fh_.open(gtffile_.c_str());
@@ -63,7 +54,7 @@ void GtfParser::close() {
 }
 
 //parse an exon single line into a Gtf struct
-Gtf GtfParser::parse_exon_line(string line) {
+Gtf GtfParser::parse_exon_line(string line) const {
     Gtf gtf1;
     vector<string> fields;
     Tokenize(line, fields);
@@ -90,7 +81,7 @@ Gtf GtfParser::parse_exon_line(string line) {
 
 //Parse the required field from attributes column
 string GtfParser::parse_attribute(vector<string> attributes1,
-                           string field_name) {
+                           string field_name) const {
     for (std::size_t i = 0; i < attributes1.size(); i++) {
         vector<string> tokens;
         //some attributes have a leading whitespace
@@ -106,122 +97,151 @@ string GtfParser::parse_attribute(vector<string> attributes1,
     return string("NA");
 }
 
-//Add an exon to the transcript map
-void GtfParser::add_exon_to_transcript_map(Gtf gtf1) {
+//Get the transcripts of a contig, adding it if it is new
+ContigTranscripts & GtfParser::add_contig(const string &chr) {
+    uint32_t contig = contig_names_.intern(chr);
+    if(contig == contigs_.size())
+        contigs_.push_back(ContigTranscripts(chr));
+    return contigs_[contig];
+}
+
+//Add an exon to the transcripts of its contig
+//Exons without a transcript_id are skipped
+void GtfParser::add_exon_to_contig(const Gtf &gtf1,
+                                   ContigTranscripts &contig) const {
     vector<string> attributes;
     Tokenize(gtf1.attributes, attributes, ';');
     string transcript_id = parse_attribute(attributes, "transcript_id");
     string gene_name = parse_attribute(attributes, "gene_name");
-    //create a BED6 object
-    BED exon = BED(gtf1.seqname, gtf1.start,
-                   gtf1.end, gtf1.feature,
-                   gtf1.score, gtf1.strand);
     if(transcript_id != string("NA")) {
-        transcript_map_[transcript_id].exons.push_back(exon);
-        set_transcript_gene(transcript_id, gene_name);
+        contig.add_exon(transcript_id, gene_name,
+                        parse_strand(gtf1.strand),
+                        gtf1.start, gtf1.end);
     }
 }
 
-//Return the exons corresponding to a transcript
-//The return value is a vector of BEDs
-const vector<BED> & GtfParser::get_exons_from_transcript(string transcript_id) {
-    return transcript_map_[transcript_id].exons;
+//Add an exon to the transcript store
+void GtfParser::add_exon_to_transcript_map(Gtf gtf1) {
+    vector<string> attributes;
+    Tokenize(gtf1.attributes, attributes, ';');
+    string transcript_id = parse_attribute(attributes, "transcript_id");
+    if(transcript_id != string("NA")) {
+        ContigTranscripts &contig = add_contig(gtf1.seqname);
+        add_transcript_contig(transcript_id,
+                              contig_names_.intern(gtf1.seqname));
+        add_exon_to_contig(gtf1, contig);
+    }
 }
 
-//Return vector of transcripts in a bin
-vector<string> GtfParser::transcripts_from_bin(string chr, BIN bin1) {
-    return chrbin_to_transcripts_[chr][bin1];
+//Record the contig of a transcript
+void GtfParser::add_transcript_contig(const string &transcript_id,
+                                      uint32_t contig) {
+    pair<map<string, uint32_t>::iterator, bool> it =
+        transcript_contigs_.insert(make_pair(transcript_id, contig));
+    if(!it.second && contig < it.first->second)
+        it.first->second = contig;
 }
 
-//Return the BIN that the transcript falls in
-//This is formed by using the ends of the transcript
-BIN GtfParser::bin_from_transcript(string transcript_id) {
-    return transcript_to_bin_[transcript_id];
+//Find the contig of a transcript and load it,
+//false if the transcript is not known
+bool GtfParser::find_transcript(const string &transcript_id,
+                                const ContigTranscripts * &contig,
+                                uint32_t &transcript) const {
+    map<string, uint32_t>::const_iterator it =
+        transcript_contigs_.find(transcript_id);
+    if(it == transcript_contigs_.end())
+        return false;
+    ensure_loaded(it->second);
+    contig = &contigs_[it->second];
+    return contig->find_transcript(transcript_id, transcript);
 }
 
-//Annotate each transcript with its bin
-//Maintain a map that allows one to jump from chr,bin to a vector of
-//transcript ids
-//Also maintain another hash that allows one to jump from transcriptID
-//to the bin that the entire transcript falls in.
-void GtfParser::annotate_transcript_with_bins() {
-    //make sure exons are sorted
-    if(!transcripts_sorted_) {
-        sort_exons_within_transcripts();
-    }
-    for (std::map<string, Transcript>::iterator it = transcript_map_.begin(); \
-            it != transcript_map_.end(); it++) {
-        string transcript_id = it->first;
-        vector<BED> & exons = (it->second).exons;
-        string chr = exons[0].chrom;
-        //start of first exon
-        CHRPOS start = exons[0].start;
-        //end of last exon
-        CHRPOS end = exons[exons.size() - 1].end;
-        BIN bin1 = getBin(start, end);
-        chrbin_to_transcripts_[chr][bin1].push_back(transcript_id);
-        transcript_to_bin_[transcript_id] = bin1;
+//Load a contig if it has not been loaded yet
+//Concurrent queries of the same contig wait for a single load
+void GtfParser::ensure_loaded(uint32_t contig) const {
+    if(lazy_) {
+        std::call_once(contig_loaded_[contig],
+                       &GtfParser::load_contig, this, contig);
     }
 }
 
-//Construct the junctions using exon information
-void GtfParser::construct_junctions() {
-    if(!transcripts_sorted_) {
-        sort_exons_within_transcripts();
-    }
-    for (std::map<string, Transcript>::iterator it = transcript_map_.begin(); \
-            it != transcript_map_.end(); it++) {
-        string transcript_id = it->first;
-        vector<BED> exon_vector = it->second.exons;
-        for (std::size_t i = 0; i < exon_vector.size() - 1; i++) {
-           //Create the junction
-           BED j1 =
-               BED(exon_vector[i].chrom, exon_vector[i].end,
-                   exon_vector[i+1].start);
-           transcript_map_[transcript_id].junctions.push_back(j1);
-        }
+//Return the transcripts on a chromosome, NULL if there are none
+const ContigTranscripts * GtfParser::contig_transcripts(const string &chr) const {
+    uint32_t contig;
+    if(!contig_names_.find(chr, contig))
+        return NULL;
+    return contig_transcripts(contig);
+}
+
+//Return the transcripts of a contig ID, NULL if there are none
+//or the ID is out of range
+const ContigTranscripts * GtfParser::contig_transcripts(uint32_t contig) const {
+    if(contig >= contigs_.size())
+        return NULL;
+    ensure_loaded(contig);
+    if(contigs_[contig].n_transcripts() == 0)
+        return NULL;
+    return &contigs_[contig];
+}
+
+//Return the exons corresponding to a transcript
+//The return value is a vector of BEDs built from the store,
+//empty if the transcript is not known
+vector<BED> GtfParser::get_exons_from_transcript(const string &transcript_id) const {
+    const ContigTranscripts *contig;
+    uint32_t transcript;
+    if(find_transcript(transcript_id, contig, transcript))
+        return contig->exon_beds(transcript);
+    return vector<BED>();
+}
+
+//Get the gene ID using the trancript ID
+string GtfParser::get_gene_from_transcript(const string &transcript_id) const {
+    const ContigTranscripts *contig;
+    uint32_t transcript;
+    if(find_transcript(transcript_id, contig, transcript))
+        return contig->gene_name(transcript);
+    return "NA";
+}
+
+//Build the interval index of each contig
+void GtfParser::index_transcripts() {
+    for(size_t i = 0; i < contigs_.size(); i++) {
+        contigs_[i].build_index();
     }
 }
 
 //Sort the exons within transcripts by start position
+//and pack them into the per-contig exon arrays
 void GtfParser::sort_exons_within_transcripts() {
-    for (std::map<string, Transcript>::iterator it = transcript_map_.begin(); \
-            it != transcript_map_.end(); it++) {
-        if(it->second.exons[0].strand == "+")
-            sort(it->second.exons.begin(), it->second.exons.end(), sort_by_start_ps);
-        else if(it->second.exons[0].strand == "-")
-            sort(it->second.exons.begin(), it->second.exons.end(), sort_by_start_ns);
-        else {
-            cerr << "Undefined strand for exon ";
-            cerr << it->second.exons[0].start << it->second.exons[0].end;
-            exit(1);
-        }
+    for(size_t i = 0; i < contigs_.size(); i++) {
+        contigs_[i].pack();
     }
-    transcripts_sorted_ = true;
 }
 
 //Print out transcripts - exons and junctions
-void GtfParser::print_transcripts() {
-     for (std::map<string, Transcript>::iterator it = transcript_map_.begin(); \
-          it != transcript_map_.end(); it++) {
-            std::cout << it->first << " => \n";
+//Every contig is printed, so a lazy annotation is loaded in full
+void GtfParser::print_transcripts() const {
+    for(size_t i = 0; i < contigs_.size(); i++) {
+        ensure_loaded(i);
+        const ContigTranscripts &contig = contigs_[i];
+        for(uint32_t t = 0; t < contig.n_transcripts(); t++) {
+            cout << contig.transcript_name(t) << " => \n";
             cout << "\tExons\n";
-            vector<BED> & exons = (it->second).exons;
-            for(vector<BED>::iterator it2 = exons.begin(); it2 != exons.end(); it2++) {
-                cout << "\t" << it2->chrom << "\t" << it2-> start << "\t" << it2->end << "\n";
+            ExonView exons = contig.exons(t);
+            for(size_t j = 0; j < exons.size(); j++) {
+                cout << "\t" << contig.chrom() << "\t" << exons[j].start << "\t" << exons[j].end << "\n";
             }
             cout << "\tJunctions\n";
-            vector<BED> & junctions = (it->second).junctions;
-            for(vector<BED>::iterator it2 = junctions.begin(); it2 != junctions.end(); it2++) {
-                cout << "\t" << it2->chrom << "\t" << it2-> start << "\t" << it2->end << "\n";
+            for(size_t j = 0; j + 1 < exons.size(); j++) {
+                cout << "\t" << contig.chrom() << "\t" << exons[j].end << "\t" << exons[j + 1].start << "\n";
             }
-     }
+        }
+    }
 }
 
-//Create a transcript map from the GTF
-//This is a <map> data structure
-//The key is transcript_id
-//The value is a vector<BED> corresponding to exons
+//Create the transcript store from the GTF
+//Exons are grouped by contig and transcript_id
 void GtfParser::create_transcript_map() {
     if(!gtf_fh_.is_open()) {
         GtfParser::open();
@@ -243,38 +263,156 @@ void GtfParser::set_gtffile(string filename) {
     gtffile_ = filename;
 }
 
-//Get the gene ID using the trancript ID
-string GtfParser::get_gene_from_transcript(string transcript_id) {
-    if(transcript_to_gene_.count(transcript_id)) {
-        return transcript_to_gene_[transcript_id];
-    } else {
-        return "NA";
-    }
-}
-
 //Load all the necessary objects into memory
 void GtfParser::load() {
     create_transcript_map();
-    construct_junctions();
     sort_exons_within_transcripts();
-    annotate_transcript_with_bins();
+    index_transcripts();
     //print_transcripts();
 }
 
-//Set the gene ID for a trancript ID
-inline void GtfParser::set_transcript_gene(string transcript_id, string gene_id) {
-    //check if key already exists
-    if(transcript_to_gene_.count(transcript_id) == 0)
-        transcript_to_gene_[transcript_id] = gene_id;
+//Record where the lines of each contig are in the GTF
+//Only the seqname and the transcript_id of each line are looked
+//at, consecutive lines on the same contig are merged into one block
+void GtfParser::scan_contig_blocks() {
+    if(!gtf_fh_.is_open()) {
+        GtfParser::open();
+    }
+    string line, current_chr;
+    uint32_t contig = 0;
+    streamoff offset = 0;
+    while(getline(gtf_fh_, line)) {
+        streamoff next = offset + line.size() + 1;
+        if(line.empty() || line[0] == '#') { //ignore comments
+            offset = next;
+            continue;
+        }
+        size_t tab = line.find('\t');
+        if(contig_blocks_.empty() ||
+           line.compare(0, tab, current_chr) != 0) {
+            current_chr = line.substr(0, tab);
+            contig = contig_names_.intern(current_chr);
+            if(contig == contigs_.size()) {
+                contigs_.push_back(ContigTranscripts(current_chr));
+                contig_blocks_.push_back(vector<GtfBlock>());
+            }
+            GtfBlock block = {offset, next};
+            contig_blocks_[contig].push_back(block);
+        } else {
+            contig_blocks_[contig].back().end = next;
+        }
+        string transcript_id = scan_transcript_id(line);
+        if(transcript_id != "NA")
+            add_transcript_contig(transcript_id, contig);
+        offset = next;
+    }
+    GtfParser::close();
+}
+
+//Transcript ID of an exon line, "NA" for other lines and
+//lines that do not parse. Bad lines are reported when their
+//contig is loaded.
+string GtfParser::scan_transcript_id(const string &line) const {
+    vector<string> fields;
+    Tokenize(line, fields);
+    if(fields.size() != 9 || fields[2] != "exon")
+        return "NA";
+    vector<string> attributes;
+    Tokenize(fields[8], attributes, ';');
+    return parse_attribute(attributes, "transcript_id");
+}
+
+//Read, pack and index the transcripts of one contig
+//Each load reads through its own filehandle so that
+//different contigs can be loaded at the same time
+void GtfParser::load_contig(uint32_t contig) const {
+    ifstream gtf_fh(gtffile_.c_str());
+    if(!gtf_fh.is_open()) {
+        throw runtime_error("Unable to open GTF file " + gtffile_);
+    }
+    ContigTranscripts &transcripts = contigs_[contig];
+    const vector<GtfBlock> &blocks = contig_blocks_[contig];
+    string line;
+    for(size_t i = 0; i < blocks.size(); i++) {
+        gtf_fh.clear();
+        gtf_fh.seekg(blocks[i].begin);
+        streamoff offset = blocks[i].begin;
+        while(offset < blocks[i].end && getline(gtf_fh, line)) {
+            offset += line.size() + 1;
+            if(line.empty() || line[0] == '#') //ignore comments
+                continue;
+            Gtf gtf_l = parse_exon_line(line);
+            if(gtf_l.is_exon) {
+                add_exon_to_contig(gtf_l, transcripts);
+            }
+        }
+    }
+    transcripts.build_index();
+}
+
+//Only find the contigs now, the transcripts of a contig
+//are read from the GTF and indexed when it is first queried
+void GtfParser::load_lazy() {
+    scan_contig_blocks();
+    contig_loaded_.reset(new std::once_flag[contigs_.size()]);
+    lazy_ = true;
 }
 
-//Assignment operator
-GtfParser& GtfParser::operator= (const GtfParser& gtf1) {
-    gtffile_ = gtf1.gtffile_;
-    transcripts_sorted_ = gtf1.transcripts_sorted_;
-    transcript_to_gene_ = gtf1.transcript_to_gene_;
-    transcript_map_ = gtf1.transcript_map_;
-    transcript_to_bin_ = gtf1.transcript_to_bin_;
-    chrbin_to_transcripts_ = gtf1.chrbin_to_transcripts_;
-    return *this;
+//Load a GTF file into a shared annotation
+//With lazy set, contigs are loaded when they are first queried
+GtfHandle load_annotation(const string &gtffile, bool lazy) {
+    std::shared_ptr<GtfParser> gtf(new GtfParser(gtffile));
+    if(lazy)
+        gtf->load_lazy();
+    else
+        gtf->load();
+    return gtf;
+}
+
+//Is name usable in output column and VCF INFO tag names
+static bool valid_source_name(const string &name) {
+    if(name.empty())
+        return false;
+    for(size_t i = 0; i < name.size(); i++) {
+        if(!isalnum(name[i]) && name[i] != '_' && name[i] != '.')
+            return false;
+    }
+    return true;
+}
+
+//Load the annotation sources of spec, either a single GTF file or
+//a comma separated list of name=file.gtf. A spec naming an existing
+//file is always a single GTF, so paths with ',' or '=' still work.
+AnnotationSources load_annotation_sources(const string &spec, bool lazy) {
+    AnnotationSources sources;
+    vector<string> entries;
+    bool single_file = common::file_exists(spec);
+    if(single_file)
+        entries.push_back(spec);
+    else
+        Tokenize(spec, entries, ',');
+    for(size_t i = 0; i < entries.size(); i++) {
+        AnnotationSource source;
+        string gtffile = entries[i];
+        size_t eq = entries[i].find('=');
+        if(eq != string::npos && !single_file) {
+            source.name = entries[i].substr(0, eq);
+            gtffile = entries[i].substr(eq + 1);
+        } else {
+            size_t slash = gtffile.rfind('/');
+            source.name = gtffile.substr(slash == string::npos ? 0 : slash + 1);
+            size_t dot = source.name.find('.');
+            source.name = source.name.substr(0, dot);
+        }
+        if(entries.size() > 1 && !valid_source_name(source.name)) {
+            throw runtime_error("Invalid annotation source name \"" +
+                                source.name + "\"");
+        }
+        source.gtf = load_annotation(gtffile, lazy);
+        sources.push_back(source);
+    }
+    if(sources.empty()) {
+        throw runtime_error("No annotation file given.");
+    }
+    return sources;
 }
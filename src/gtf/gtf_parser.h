@@ -27,37 +27,24 @@ DEALINGS IN THE SOFTWARE.  */
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include "bedFile.h"
 #include "lineFileUtilities.h"
+#include "transcript_index.h"
+#include "transcript_store.h"
 
 using namespace std;
 
-//BedVector to hold BED entries.
-typedef vector<BED> BedVector;
+//Contigs, indexed by contig ID
+typedef vector<ContigTranscripts> ContigVector;
 
-//Each transcript is a map
-//key is the transcript_id
-//value is a BedVector corresponding to exons
-typedef map<string, bedVector> TranscriptToExon;
-
-//A vector of transcripts
-typedef vector<string> TranscriptVector;
-
-//Jump from a bin to a vector of transcripts
-//The index for this vector is the UCSC bin
-typedef map<int, TranscriptVector> BinToTranscripts;
-
-//Jump from a chromosome and bin to transcript
-typedef map<string, BinToTranscripts> ChrBinToTranscripts;
-
-//Jump from a transcript ID to all the bins its exons fall in
-typedef map<string, BIN> TranscriptToBin;
-
-//Struct to hold each Transcript
-struct Transcript {
-    vector<BED> exons;
-    vector<BED> junctions;
+//A run of consecutive GTF lines on the same contig,
+//as byte offsets [begin, end) into the file
+struct GtfBlock {
+    streamoff begin;
+    streamoff end;
 };
 
 //Struct to hold each GTF line
@@ -110,80 +97,137 @@ class GtfParser {
         string gtffile_;
         //GTF filehandle
         ifstream gtf_fh_;
-        //Are exons within transcripts sorted
-        bool transcripts_sorted_;
-        //Jump from transcript-id to gene-id
-        map<string, string> transcript_to_gene_;
-        //Store transcripts as a vector of exon BEDs
-        //keyed by transcript_id
-        map<string, Transcript> transcript_map_;
-        //Bin for transcript
-        TranscriptToBin transcript_to_bin_;
-        //keyed by transcript_id
-        ChrBinToTranscripts chrbin_to_transcripts_;
+        //Contig names
+        StringPool contig_names_;
+        //Transcripts and exons of each contig
+        //Filled in on first query when loading lazily
+        mutable ContigVector contigs_;
+        //Are the contigs loaded on first query
+        bool lazy_;
+        //Blocks of GTF lines of each contig, indexed by contig ID
+        vector<vector<GtfBlock> > contig_blocks_;
+        //One flag per contig, set once the contig is loaded
+        std::unique_ptr<std::once_flag[]> contig_loaded_;
+        //Contig ID of each transcript, the lowest one if a transcript
+        //ID is used on several contigs
+        map<string, uint32_t> transcript_contigs_;
+        //Record the contig of a transcript
+        void add_transcript_contig(const string &transcript_id,
+                                   uint32_t contig);
+        //Find the contig of a transcript and load it,
+        //false if the transcript is not known
+        bool find_transcript(const string &transcript_id,
+                             const ContigTranscripts * &contig,
+                             uint32_t &transcript) const;
+        //Transcript ID of an exon line, "NA" for other lines and
+        //lines that do not parse
+        string scan_transcript_id(const string &line) const;
+        //Get the transcripts of a contig, adding it if it is new
+        ContigTranscripts & add_contig(const string &chr);
+        //Add an exon to the transcripts of its contig
+        void add_exon_to_contig(const Gtf &gtf1,
+                                ContigTranscripts &contig) const;
+        //Record where the lines of each contig are in the GTF
+        void scan_contig_blocks();
+        //Read, pack and index the transcripts of one contig
+        void load_contig(uint32_t contig) const;
+        //Load a contig if it has not been loaded yet
+        void ensure_loaded(uint32_t contig) const;
+        //Not copyable - share a loaded annotation through a GtfHandle
+        GtfParser(const GtfParser &gp1);
+        GtfParser& operator= (const GtfParser& gtf1);
     public:
         //Constructor
         GtfParser()
-            : transcripts_sorted_(false)
+            : lazy_(false)
         {}
         //Constructor
         GtfParser(string gtf1)
             : gtffile_(gtf1)
-            , transcripts_sorted_(false)
+            , lazy_(false)
         {}
-        //Copy constructor
-        GtfParser(const GtfParser &gp1) {
-            gtffile_ = gp1.gtffile_;
-            transcripts_sorted_ = gp1.transcripts_sorted_;
-            transcript_to_gene_ = gp1.transcript_to_gene_;
-            transcript_map_ = gp1.transcript_map_;
-            transcript_to_bin_ = gp1.transcript_to_bin_;
-            chrbin_to_transcripts_ = gp1.chrbin_to_transcripts_;
-        }
         //Parse an exon line into a gtf struct
-        Gtf parse_exon_line(string line);
+        Gtf parse_exon_line(string line) const;
         //Parse the required field from attributes column
         string parse_attribute(vector<string> attributes1,
-                           string field_name);
+                           string field_name) const;
         //Close the gtf filehandle
         void close();
-        //Assemble transcripts into a map
-        //this is an associative container,
-        //key is the transcript name, the value
-        //is a vector of BEDs corresponding to exons.
+        //Read the exons of the GTF into the transcript store,
+        //grouped by contig and transcript
         void create_transcript_map();
-        //Add an exon to a transcript map
+        //Add an exon to the transcript store
         void add_exon_to_transcript_map(Gtf gtf1);
         //Open the gtf file
         void open();
         //Set the gtf filename
         void set_gtffile(string filename);
         //Get the gtf filename
-        string gtffile() { return gtffile_; }
+        string gtffile() const { return gtffile_; }
         //Sort the exons within transcripts by start position
+        //and pack them into the per-contig exon arrays
         void sort_exons_within_transcripts();
-        //Construct junction information using exons
-        void construct_junctions();
-        //Annotate each transcript with its bin
-        void annotate_transcript_with_bins();
+        //Build the interval index of each contig
+        void index_transcripts();
         //Print out transcripts
-        void print_transcripts();
-        //Return vector of transcripts in a bin
-        vector<string> transcripts_from_bin(string chr, BIN b1);
-        //Return the bins that the exon-exon junctions
-        //of a transcript fall in
-        BIN bin_from_transcript(string transcript_id);
+        void print_transcripts() const;
+        //Return the transcripts on a chromosome, NULL if there are none
+        const ContigTranscripts * contig_transcripts(const string &chr) const;
+        //Return the transcripts of a contig ID, NULL if there are none
+        //or the ID is out of range
+        const ContigTranscripts * contig_transcripts(uint32_t contig) const;
+        //Look up the ID of a contig, false if it is not in the GTF
+        bool find_contig(const string &chr, uint32_t &contig) const {
+            return contig_names_.find(chr, contig);
+        }
+        //Number of contigs, contig IDs are [0, n_contigs())
+        size_t n_contigs() const { return contig_names_.size(); }
         //Return the exons corresponding to a transcript
-        //The return value is a vector of BEDs
-        const vector<BED> & get_exons_from_transcript(string transcript_id);
+        //The return value is a vector of BEDs built from the store,
+        //empty if the transcript is not known
+        vector<BED> get_exons_from_transcript(const string &transcript_id) const;
         //Get the gene ID using the trancript ID
-        string get_gene_from_transcript(string transcript_id);
-        //Set the gene ID for a trancript ID
-        void set_transcript_gene(string transcript_id, string gene_id);
+        string get_gene_from_transcript(const string &transcript_id) const;
         //Load all the necessary objects into memory
         void load();
-        //Assignment operator
-        GtfParser& operator= (const GtfParser& gtf1);
+        //Only find the contigs now, the transcripts of a contig
+        //are read from the GTF and indexed when it is first queried
+        void load_lazy();
+        //Are the contigs loaded on first query
+        bool lazy() const { return lazy_; }
 };
 
+//Shared handle to a loaded annotation. The annotation is not
+//modified after load, so the const queries are safe to call
+//from several threads at once.
+typedef std::shared_ptr<const GtfParser> GtfHandle;
+
+//Load a GTF file into a shared annotation
+//With lazy set, contigs are loaded when they are first queried. Only
+//the seqname of a line is read up front then, so bad lines are not
+//found until their contig is queried - set it only for runs limited
+//to a few contigs.
+GtfHandle load_annotation(const string &gtffile, bool lazy = false);
+
+//A loaded annotation and the name it is reported under
+struct AnnotationSource {
+    //Name of the source e.g "ensembl", used in column and tag names
+    string name;
+    //The annotation
+    GtfHandle gtf;
+};
+
+//Annotation sources, the first one is the primary annotation.
+//Each source is loaded into its own GtfParser with its own index,
+//the sources are not merged into one index. The annotators query
+//every source for each junction or variant in the same pass.
+typedef vector<AnnotationSource> AnnotationSources;
+
+//Load the annotation sources of spec, either a single GTF file or
+//a comma separated list of name=file.gtf. Sources without a name are
+//named after the file. Names may only contain letters, digits,
+//'_' and '.'
+AnnotationSources load_annotation_sources(const string &spec,
+                                          bool lazy = false);
+
 #endif
@@ -25,14 +25,14 @@ DEALINGS IN THE SOFTWARE.  */
 #include <stdexcept>
 #include <vector>
 #include "bedFile.h"
+#include "gtf_utils.h"
 using namespace std;
 
 //Return True if variant within a certain window from the transcript
-bool is_variant_within_transcript_window(const vector<BED> &exons, uint32_t pos,
-                                                string transcript_strand,
-                                                uint32_t window_size) {
+bool is_variant_within_transcript_window(const ExonView &exons, uint32_t pos,
+                                         uint32_t window_size) {
     int n_exons = exons.size();
-    if(transcript_strand == "+") {
+    if(exons.strand() == STRAND_PLUS) {
         //variant inside transcript
         if(pos >= exons[0].start && pos <= exons[n_exons - 1].end) {
             return true;
@@ -47,7 +47,7 @@ bool is_variant_within_transcript_window(const vector<BED> &exons, uint32_t pos,
            exons[0].end < pos) {
             return true;
         }
-    } else if(transcript_strand == "-") {
+    } else if(exons.strand() == STRAND_MINUS) {
         //variant inside transcript
         if(pos >= exons[n_exons - 1].start && pos <= exons[0].end) {
             return true;
@@ -24,7 +24,8 @@ DEALINGS IN THE SOFTWARE.  */
 
 #include <vector>
 #include "bedFile.h"
+#include "transcript_store.h"
 
 //Return True if variant within a certain window from the transcript
-bool is_variant_within_transcript_window(const vector<BED> &exons, uint32_t pos,
-                              string transcript_strand, uint32_t window_size);
+bool is_variant_within_transcript_window(const ExonView &exons, uint32_t pos,
+                                         uint32_t window_size);
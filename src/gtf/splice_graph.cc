@@ -0,0 +1,246 @@
+/*  splice_graph.cc -- exons and introns of the loci of a contig
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <algorithm>
+#include <bitset>
+#include "splice_graph.h"
+#include "transcript_store.h"
+
+using namespace std;
+
+//Order exons by locus, then transcript, then start
+struct LocusExonOrder {
+    const vector<uint32_t> &loci;
+    LocusExonOrder(const vector<uint32_t> &l1) : loci(l1) {}
+    template <class E>
+    bool operator() (const E &a, const E &b) const {
+        if(loci[a.transcript] != loci[b.transcript])
+            return loci[a.transcript] < loci[b.transcript];
+        if(a.transcript != b.transcript)
+            return a.transcript < b.transcript;
+        return a.start < b.start;
+    }
+};
+
+//Order transcripts by the start of their span
+struct SpanOrder {
+    const vector<CHRPOS> &starts;
+    SpanOrder(const vector<CHRPOS> &s1) : starts(s1) {}
+    bool operator() (uint32_t a, uint32_t b) const {
+        if(starts[a] != starts[b])
+            return starts[a] < starts[b];
+        return a < b;
+    }
+};
+
+//Sort (key, bit) entries and merge the bits of equal keys
+//into one bitset of `words` words per key
+template <class K>
+static void build_bitsets(vector<pair<K, uint32_t> > &entries, uint32_t words,
+                          vector<K> &keys, vector<uint64_t> &bits) {
+    sort(entries.begin(), entries.end());
+    keys.clear();
+    bits.clear();
+    for(size_t i = 0; i < entries.size(); i++) {
+        if(keys.empty() || keys.back() != entries[i].first) {
+            keys.push_back(entries[i].first);
+            bits.resize(bits.size() + words, 0);
+        }
+        bits[bits.size() - words + entries[i].second / 64] |=
+            (uint64_t) 1 << (entries[i].second % 64);
+    }
+}
+
+//Is an entry used by one of the transcripts, leaving out the
+//transcripts in except if it is not NULL
+static inline bool used_by(const uint64_t *bits, const uint64_t *except,
+                           const vector<uint64_t> &transcripts) {
+    for(size_t w = 0; w < transcripts.size(); w++) {
+        uint64_t used = bits[w] & transcripts[w];
+        if(except)
+            used &= ~except[w];
+        if(used)
+            return true;
+    }
+    return false;
+}
+
+//Add a transcript, all transcripts must be on the same strand
+void SpliceGraph::add_transcript(uint32_t transcript, const ExonView &exons) {
+    minus_strand_ = (exons.strand() == STRAND_MINUS);
+    pending_transcripts_.push_back(transcript);
+    for(size_t i = 0; i < exons.size(); i++) {
+        PendingExon e1 = {transcript, exons[i].start, exons[i].end};
+        pending_.push_back(e1);
+    }
+}
+
+//Group the transcripts into loci and build the bitsets
+//Transcripts whose spans overlap, directly or through other
+//transcripts, end up in the same locus
+void SpliceGraph::build(size_t n_transcripts) {
+    loci_.clear();
+    transcript_locus_.assign(n_transcripts, 0);
+    transcript_bit_.assign(n_transcripts, 0);
+    vector<CHRPOS> span_starts(n_transcripts), span_ends(n_transcripts);
+    for(size_t i = 0; i < pending_.size(); i++) {
+        uint32_t t = pending_[i].transcript;
+        if(i == 0 || pending_[i - 1].transcript != t) {
+            span_starts[t] = pending_[i].start;
+            span_ends[t] = pending_[i].end;
+        }
+        span_starts[t] = min(span_starts[t], pending_[i].start);
+        span_ends[t] = max(span_ends[t], pending_[i].end);
+    }
+    vector<uint32_t> order(pending_transcripts_);
+    sort(order.begin(), order.end(), SpanOrder(span_starts));
+    for(size_t i = 0; i < order.size(); i++) {
+        uint32_t t = order[i];
+        if(loci_.empty() || span_starts[t] > loci_.back().end) {
+            SpliceLocus locus;
+            locus.start = span_starts[t];
+            locus.end = span_ends[t];
+            locus.n_transcripts = 0;
+            loci_.push_back(locus);
+        }
+        SpliceLocus &locus = loci_.back();
+        locus.end = max(locus.end, span_ends[t]);
+        transcript_locus_[t] = loci_.size() - 1;
+        transcript_bit_[t] = locus.n_transcripts++;
+    }
+    sort(pending_.begin(), pending_.end(), LocusExonOrder(transcript_locus_));
+    vector<PendingExon> exons;
+    for(size_t i = 0; i < pending_.size(); ) {
+        uint32_t locus = transcript_locus_[pending_[i].transcript];
+        exons.clear();
+        for(; i < pending_.size() &&
+              transcript_locus_[pending_[i].transcript] == locus; i++) {
+            exons.push_back(pending_[i]);
+        }
+        build_locus(loci_[locus], exons);
+    }
+    vector<PendingExon>().swap(pending_);
+    vector<uint32_t>().swap(pending_transcripts_);
+}
+
+//Build one locus from the exons of its transcripts
+//The exons are sorted by transcript and then by start
+void SpliceGraph::build_locus(SpliceLocus &locus,
+                              vector<PendingExon> &exons) {
+    locus.words = (locus.n_transcripts + 63) / 64;
+    locus.regular = true;
+    vector<pair<CHRPOS, uint32_t> > starts, ends;
+    vector<pair<pair<CHRPOS, CHRPOS>, uint32_t> > exon_entries, intron_entries;
+    for(size_t i = 0; i < exons.size(); i++) {
+        uint32_t bit = transcript_bit_[exons[i].transcript];
+        starts.push_back(make_pair(exons[i].start, bit));
+        ends.push_back(make_pair(exons[i].end, bit));
+        exon_entries.push_back(make_pair(make_pair(exons[i].start,
+                                                   exons[i].end), bit));
+        if(i + 1 < exons.size() &&
+           exons[i + 1].transcript == exons[i].transcript) {
+            if(exons[i].end >= exons[i + 1].start)
+                locus.regular = false;
+            intron_entries.push_back(make_pair(make_pair(exons[i].end,
+                                                         exons[i + 1].start), bit));
+        }
+    }
+    build_bitsets(starts, locus.words, locus.starts, locus.start_bits);
+    build_bitsets(ends, locus.words, locus.ends, locus.end_bits);
+    build_bitsets(exon_entries, locus.words, locus.exons, locus.exon_bits);
+    build_bitsets(intron_entries, locus.words, locus.introns, locus.intron_bits);
+}
+
+//Add the exons of the transcripts in a locus that are skipped
+//by the junction [start, end] to counts
+//When every transcript of the locus overlaps the junction, every
+//stored position is used and the counts are the widths of the
+//ranges found by binary search, only the positions at the junction
+//ends have to be checked against the bitsets.
+void SpliceGraph::count_skipped(uint32_t locus_id,
+                                const vector<uint64_t> &transcripts,
+                                CHRPOS start, CHRPOS end,
+                                SkippedCounts &counts) const {
+    const SpliceLocus &locus = loci_[locus_id];
+    const uint32_t words = locus.words;
+    uint32_t n_used = 0;
+    for(size_t w = 0; w < transcripts.size(); w++) {
+        n_used += bitset<64>(transcripts[w]).count();
+    }
+    bool all_used = (n_used == locus.n_transcripts);
+    //Transcripts that splice exactly [start, end]
+    const uint64_t *intron = NULL;
+    pair<CHRPOS, CHRPOS> junction(start, end);
+    vector<pair<CHRPOS, CHRPOS> >::const_iterator intron_it =
+        lower_bound(locus.introns.begin(), locus.introns.end(), junction);
+    if(intron_it != locus.introns.end() && *intron_it == junction)
+        intron = &locus.intron_bits[(intron_it - locus.introns.begin()) * words];
+    //Starts in (start, end], the donor exon on the negative strand
+    //starts at end
+    size_t first = upper_bound(locus.starts.begin(), locus.starts.end(), start) -
+                   locus.starts.begin();
+    size_t last = upper_bound(locus.starts.begin(), locus.starts.end(), end) -
+                  locus.starts.begin();
+    if(all_used && first < last) {
+        counts.starts += last - first - 1;
+        first = last - 1;
+    }
+    for(size_t i = first; i < last; i++) {
+        const uint64_t *except = NULL;
+        if(minus_strand_ && locus.starts[i] == end)
+            except = intron;
+        if(used_by(&locus.start_bits[i * words], except, transcripts))
+            counts.starts++;
+    }
+    //Ends in [start, end), the donor exon on the positive strand
+    //ends at start
+    first = lower_bound(locus.ends.begin(), locus.ends.end(), start) -
+            locus.ends.begin();
+    last = lower_bound(locus.ends.begin(), locus.ends.end(), end) -
+           locus.ends.begin();
+    if(all_used && first < last) {
+        counts.ends += last - first - 1;
+        last = first + 1;
+    }
+    for(size_t i = first; i < last; i++) {
+        const uint64_t *except = NULL;
+        if(!minus_strand_ && locus.ends[i] == start)
+            except = intron;
+        if(used_by(&locus.end_bits[i * words], except, transcripts))
+            counts.ends++;
+    }
+    //Exons inside (start, end)
+    if(counts.exon)
+        return;
+    first = upper_bound(locus.exons.begin(), locus.exons.end(),
+                        make_pair(start, (CHRPOS) -1)) - locus.exons.begin();
+    for(size_t i = first; i < locus.exons.size() &&
+                          locus.exons[i].first < end; i++) {
+        if(locus.exons[i].second < end &&
+           used_by(&locus.exon_bits[i * words], NULL, transcripts)) {
+            counts.exon = true;
+            return;
+        }
+    }
+}
@@ -0,0 +1,140 @@
+/*  splice_graph.h -- exons and introns of the loci of a contig
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef SPLICE_GRAPH_H_
+#define SPLICE_GRAPH_H_
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include "bedFile.h"
+
+using namespace std;
+
+class ExonView;
+
+//Exons skipped by a junction
+struct SkippedCounts {
+    //Distinct exon starts inside the junction
+    uint32_t starts;
+    //Distinct exon ends inside the junction
+    uint32_t ends;
+    //Is an exon completely inside the junction
+    bool exon;
+    SkippedCounts()
+        : starts(0)
+        , ends(0)
+        , exon(false)
+    {}
+};
+
+//Transcripts on one strand that overlap each other, along with the
+//exon starts, exon ends, exons and introns they use. Each of these is
+//stored once, sorted, with a bitset of the transcripts that use it.
+struct SpliceLocus {
+    //Span of the transcripts
+    CHRPOS start;
+    CHRPOS end;
+    //Number of transcripts
+    uint32_t n_transcripts;
+    //Number of 64 bit words in a transcript bitset
+    uint32_t words;
+    //Are the exons of every transcript disjoint
+    bool regular;
+    //Exon starts and their transcript bitsets
+    vector<CHRPOS> starts;
+    vector<uint64_t> start_bits;
+    //Exon ends and their transcript bitsets
+    vector<CHRPOS> ends;
+    vector<uint64_t> end_bits;
+    //Exons and their transcript bitsets
+    vector<pair<CHRPOS, CHRPOS> > exons;
+    vector<uint64_t> exon_bits;
+    //Introns as (end of the left exon, start of the right exon)
+    //and their transcript bitsets
+    vector<pair<CHRPOS, CHRPOS> > introns;
+    vector<uint64_t> intron_bits;
+};
+
+//The loci on one strand of a contig.
+//Loci do not overlap, so an exon boundary belongs to a single locus
+//and the skipped counts of a junction are the sum over its loci.
+class SpliceGraph {
+    private:
+        //Exon of a transcript while the graph is built
+        struct PendingExon {
+            uint32_t transcript;
+            CHRPOS start;
+            CHRPOS end;
+        };
+        //Strand of the transcripts
+        bool minus_strand_;
+        //Loci, sorted by start
+        vector<SpliceLocus> loci_;
+        //Locus of each transcript, by contig transcript ID
+        vector<uint32_t> transcript_locus_;
+        //Bit of each transcript within its locus
+        vector<uint32_t> transcript_bit_;
+        //Exons added since the last build
+        vector<PendingExon> pending_;
+        //Transcripts added since the last build, in exon order
+        vector<uint32_t> pending_transcripts_;
+        //Build one locus from the exons of its transcripts
+        void build_locus(SpliceLocus &locus,
+                         vector<PendingExon> &exons);
+    public:
+        //Constructor
+        SpliceGraph()
+            : minus_strand_(false)
+        {}
+        //Add a transcript, all transcripts must be on the same strand
+        void add_transcript(uint32_t transcript, const ExonView &exons);
+        //Group the transcripts into loci and build the bitsets
+        //n_transcripts is the number of transcripts on the contig
+        void build(size_t n_transcripts);
+        //Number of loci
+        size_t n_loci() const { return loci_.size(); }
+        //Locus of a transcript
+        uint32_t locus(uint32_t transcript) const {
+            return transcript_locus_[transcript];
+        }
+        //Bit of a transcript within its locus
+        uint32_t bit(uint32_t transcript) const {
+            return transcript_bit_[transcript];
+        }
+        //Locus with this ID
+        const SpliceLocus & locus_data(uint32_t locus) const {
+            return loci_[locus];
+        }
+        //Add the exons of the transcripts in a locus that are skipped
+        //by the junction [start, end] to counts. Starts are counted in
+        //(start, end] and ends in [start, end). The donor exon of a
+        //transcript that splices exactly [start, end] is not skipped.
+        //Only valid for regular loci, see SpliceLocus::regular.
+        void count_skipped(uint32_t locus, const vector<uint64_t> &transcripts,
+                           CHRPOS start, CHRPOS end,
+                           SkippedCounts &counts) const;
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*  splice_sites.cc -- annotated splice sites of a contig
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <algorithm>
+#include "splice_sites.h"
+#include "transcript_store.h"
+
+using namespace std;
+
+//Sort a vector and drop duplicates
+template <class T>
+static void sort_unique(vector<T> &v) {
+    sort(v.begin(), v.end());
+    v.erase(unique(v.begin(), v.end()), v.end());
+}
+
+//Add the exons and introns of a transcript
+//Exons are ordered from first to last, so on the negative
+//strand the left exon of an intron is the later one
+void SpliceSites::add_transcript(const ExonView &exons) {
+    if(exons.size() == 1) {
+        single_exon_starts_.push_back(exons[0].start);
+        single_exon_ends_.push_back(exons[0].end);
+        return;
+    }
+    for(size_t i = 0; i < exons.size(); i++) {
+        exon_starts_.push_back(exons[i].start);
+        exon_ends_.push_back(exons[i].end);
+        if(i + 1 < exons.size()) {
+            if(exons.strand() == STRAND_MINUS)
+                introns_.push_back(make_pair(exons[i + 1].end, exons[i].start));
+            else
+                introns_.push_back(make_pair(exons[i].end, exons[i + 1].start));
+        }
+    }
+}
+
+//Sort the positions and drop duplicates
+void SpliceSites::build() {
+    sort_unique(exon_starts_);
+    sort_unique(exon_ends_);
+    sort_unique(single_exon_starts_);
+    sort_unique(single_exon_ends_);
+    sort_unique(introns_);
+    intron_lefts_.clear();
+    intron_rights_.clear();
+    for(size_t i = 0; i < introns_.size(); i++) {
+        intron_lefts_.push_back(introns_[i].first);
+        intron_rights_.push_back(introns_[i].second);
+    }
+    sort_unique(intron_lefts_);
+    sort_unique(intron_rights_);
+}
+
+//Distance from pos to the closest position in sorted, pos - closest.
+//Of two positions as close, the one before pos is taken.
+static bool nearest(const vector<CHRPOS> &sorted, CHRPOS pos,
+                    int64_t &distance) {
+    if(sorted.empty())
+        return false;
+    vector<CHRPOS>::const_iterator it = lower_bound(sorted.begin(),
+                                                    sorted.end(), pos);
+    if(it == sorted.end() ||
+       (it != sorted.begin() && pos - *(it - 1) <= *it - pos))
+        --it;
+    distance = (int64_t) pos - *it;
+    return true;
+}
+
+//Is pos the start of an annotated exon
+bool SpliceSites::has_exon_start(CHRPOS pos, bool include_single_exon) const {
+    if(binary_search(exon_starts_.begin(), exon_starts_.end(), pos))
+        return true;
+    return include_single_exon &&
+           binary_search(single_exon_starts_.begin(),
+                         single_exon_starts_.end(), pos);
+}
+
+//Is pos the end of an annotated exon
+bool SpliceSites::has_exon_end(CHRPOS pos, bool include_single_exon) const {
+    if(binary_search(exon_ends_.begin(), exon_ends_.end(), pos))
+        return true;
+    return include_single_exon &&
+           binary_search(single_exon_ends_.begin(),
+                         single_exon_ends_.end(), pos);
+}
+
+//Distance from pos to the closest left end of an intron
+bool SpliceSites::nearest_intron_left(CHRPOS pos, int64_t &distance) const {
+    return nearest(intron_lefts_, pos, distance);
+}
+
+//Distance from pos to the closest right end of an intron
+bool SpliceSites::nearest_intron_right(CHRPOS pos, int64_t &distance) const {
+    return nearest(intron_rights_, pos, distance);
+}
+
+//Is [start, end] an annotated intron
+bool SpliceSites::has_intron(CHRPOS start, CHRPOS end) const {
+    return binary_search(introns_.begin(), introns_.end(),
+                         make_pair(start, end));
+}
@@ -0,0 +1,80 @@
+/*  splice_sites.h -- annotated splice sites of a contig
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef SPLICE_SITES_H_
+#define SPLICE_SITES_H_
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include "bedFile.h"
+
+using namespace std;
+
+class ExonView;
+
+//Annotated exon boundaries and introns on one strand of a contig.
+//Positions are kept in sorted arrays, so checking whether a junction
+//end is annotated is a binary search instead of a walk over the
+//exons of every overlapping transcript.
+//Exon ends are the left ends of introns and exon starts the right
+//ends, i.e on the positive strand the ends are donors and on the
+//negative strand they are acceptors.
+class SpliceSites {
+    private:
+        //Exon starts of multi-exon transcripts
+        vector<CHRPOS> exon_starts_;
+        //Exon ends of multi-exon transcripts
+        vector<CHRPOS> exon_ends_;
+        //Exon starts of single-exon transcripts
+        vector<CHRPOS> single_exon_starts_;
+        //Exon ends of single-exon transcripts
+        vector<CHRPOS> single_exon_ends_;
+        //Introns as (end of the left exon, start of the right exon)
+        vector<pair<CHRPOS, CHRPOS> > introns_;
+        //Left and right ends of the introns, each sorted, to find the
+        //annotated splice site closest to a position
+        vector<CHRPOS> intron_lefts_;
+        vector<CHRPOS> intron_rights_;
+    public:
+        //Add the exons and introns of a transcript
+        void add_transcript(const ExonView &exons);
+        //Sort the positions and drop duplicates
+        void build();
+        //Is pos the start of an annotated exon
+        bool has_exon_start(CHRPOS pos, bool include_single_exon) const;
+        //Is pos the end of an annotated exon
+        bool has_exon_end(CHRPOS pos, bool include_single_exon) const;
+        //Is [start, end] an annotated intron, with start the end
+        //of the left exon and end the start of the right exon
+        bool has_intron(CHRPOS start, CHRPOS end) const;
+        //Distance from pos to the closest left end of an intron,
+        //pos - closest. Returns false if there are no introns
+        bool nearest_intron_left(CHRPOS pos, int64_t &distance) const;
+        //Distance from pos to the closest right end of an intron,
+        //pos - closest. Returns false if there are no introns
+        bool nearest_intron_right(CHRPOS pos, int64_t &distance) const;
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*  transcript_index.cc -- interval index over the transcripts of a contig
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <algorithm>
+#include <stdexcept>
+#include "transcript_index.h"
+
+using namespace std;
+
+//Order entries by start, then end, then transcript ID
+//so that the index does not depend on the GTF line order
+struct TranscriptIndexOrder {
+    const vector<CHRPOS> &starts;
+    const vector<CHRPOS> &ends;
+    const vector<uint32_t> &ids;
+    TranscriptIndexOrder(const vector<CHRPOS> &s1,
+                         const vector<CHRPOS> &e1,
+                         const vector<uint32_t> &i1)
+        : starts(s1), ends(e1), ids(i1) {}
+    bool operator() (size_t a, size_t b) const {
+        if(starts[a] != starts[b])
+            return starts[a] < starts[b];
+        if(ends[a] != ends[b])
+            return ends[a] < ends[b];
+        return ids[a] < ids[b];
+    }
+};
+
+//Add a transcript to the index
+void TranscriptIndex::add(CHRPOS start, CHRPOS end, uint32_t transcript) {
+    starts_.push_back(start);
+    ends_.push_back(end);
+    transcripts_.push_back(transcript);
+    built_ = false;
+}
+
+//Sort the intervals and compute the running max-end
+void TranscriptIndex::build() {
+    if(built_)
+        return;
+    vector<size_t> order(starts_.size());
+    for(size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(),
+         TranscriptIndexOrder(starts_, ends_, transcripts_));
+    vector<CHRPOS> starts(order.size()), ends(order.size());
+    vector<uint32_t> transcripts(order.size());
+    for(size_t i = 0; i < order.size(); i++) {
+        starts[i] = starts_[order[i]];
+        ends[i] = ends_[order[i]];
+        transcripts[i] = transcripts_[order[i]];
+    }
+    starts_.swap(starts);
+    ends_.swap(ends);
+    transcripts_.swap(transcripts);
+    max_ends_.resize(ends_.size());
+    CHRPOS max_end = 0;
+    for(size_t i = 0; i < ends_.size(); i++) {
+        max_end = max(max_end, ends_[i]);
+        max_ends_[i] = max_end;
+    }
+    built_ = true;
+}
+
+//Get the range [first, last) of entries that could overlap [start, end]
+//max_ends_ is non-decreasing, so both ends of the range are binary searches
+void TranscriptIndex::overlap(CHRPOS start, CHRPOS end,
+                              size_t &first, size_t &last) const {
+    if(!built_) {
+        throw runtime_error("Transcript index queried before it was built.");
+    }
+    first = lower_bound(max_ends_.begin(), max_ends_.end(), start) -
+            max_ends_.begin();
+    last = upper_bound(starts_.begin(), starts_.end(), end) -
+           starts_.begin();
+    if(last < first)
+        last = first;
+}
+
+//Move the sweep to a query that ends at end, floor is a lower bound
+//on the start of this query and of every later query
+bool TranscriptSweep::advance(const TranscriptIndex &index,
+                              CHRPOS floor, CHRPOS end) {
+    if(!sorted_)
+        return false;
+    if(&index != index_) {
+        if(!swept_.insert(&index).second) {
+            sorted_ = false;
+            active_.clear();
+            return false;
+        }
+        index_ = &index;
+        next_ = 0;
+        active_.clear();
+    } else if(floor < floor_) {
+        sorted_ = false;
+        active_.clear();
+        return false;
+    }
+    floor_ = floor;
+    //Drop the entries that end before every later query
+    size_t kept = 0;
+    for(size_t i = 0; i < active_.size(); i++) {
+        if(index.end(active_[i]) >= floor)
+            active_[kept++] = active_[i];
+    }
+    active_.resize(kept);
+    //Add the entries that start before the end of this query
+    for(; next_ < index.size() && index.start(next_) <= end; next_++) {
+        if(index.end(next_) >= floor)
+            active_.push_back(next_);
+    }
+    return true;
+}
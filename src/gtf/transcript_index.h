@@ -0,0 +1,120 @@
+/*  transcript_index.h -- interval index over the transcripts of a contig
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef TRANSCRIPT_INDEX_H_
+#define TRANSCRIPT_INDEX_H_
+
+#include <set>
+#include <vector>
+#include "bedFile.h"
+
+using namespace std;
+
+//Interval index over the transcripts of one contig.
+//The intervals are kept sorted by start along with a running
+//maximum of the ends. Every interval that overlaps a query lies
+//in one contiguous range of this array - the range starts at the
+//first entry whose running max-end reaches the query start and
+//stops before the first entry that starts after the query end.
+//Coordinates are closed intervals, [start, end].
+class TranscriptIndex {
+    private:
+        //Transcript starts, sorted
+        vector<CHRPOS> starts_;
+        //Transcript ends, in the same order as starts_
+        vector<CHRPOS> ends_;
+        //Running maximum of ends_
+        vector<CHRPOS> max_ends_;
+        //Transcript IDs, in the same order as starts_
+        vector<uint32_t> transcripts_;
+        //Has the index been built since the last add
+        bool built_;
+    public:
+        //Constructor
+        TranscriptIndex()
+            : built_(true)
+        {}
+        //Add a transcript to the index
+        void add(CHRPOS start, CHRPOS end, uint32_t transcript);
+        //Sort the intervals and compute the running max-end
+        void build();
+        //Number of transcripts in the index
+        size_t size() const { return starts_.size(); }
+        //Get the range [first, last) of entries that could overlap
+        //[start, end]. Entries in the range still have to be
+        //checked with overlaps()
+        void overlap(CHRPOS start, CHRPOS end,
+                     size_t &first, size_t &last) const;
+        //Does entry i overlap [start, end]
+        bool overlaps(size_t i, CHRPOS start, CHRPOS end) const {
+            return starts_[i] <= end && ends_[i] >= start;
+        }
+        //Start of entry i
+        CHRPOS start(size_t i) const { return starts_[i]; }
+        //End of entry i
+        CHRPOS end(size_t i) const { return ends_[i]; }
+        //Transcript ID of entry i
+        uint32_t transcript(size_t i) const { return transcripts_[i]; }
+};
+
+//Sweep over the entries of TranscriptIndex for queries that arrive
+//sorted by start, like the junctions from `junctions extract`.
+//The entries that have started are kept in an active list in index
+//order and dropped once they end before every later query, so a
+//sorted stream of queries walks the index once.
+class TranscriptSweep {
+    private:
+        //Index being swept
+        const TranscriptIndex *index_;
+        //Indexes swept before, coming back to one means the queries
+        //are not sorted by contig
+        set<const TranscriptIndex *> swept_;
+        //First entry that has not been added to active_
+        size_t next_;
+        //Lower bound on the start of every later query
+        CHRPOS floor_;
+        //Entries that could overlap the last query, in index order
+        vector<size_t> active_;
+        //Have the queries been sorted so far
+        bool sorted_;
+    public:
+        //Constructor
+        TranscriptSweep()
+            : index_(NULL)
+            , next_(0)
+            , floor_(0)
+            , sorted_(true)
+        {}
+        //Move the sweep to a query that ends at end. floor is a lower
+        //bound on the start of this query and of every later query on
+        //the same index. Returns false once the queries turn out not
+        //to be sorted, the sweep is then off for good and the caller
+        //should use TranscriptIndex::overlap instead.
+        bool advance(const TranscriptIndex &index, CHRPOS floor, CHRPOS end);
+        //Entries that could overlap the last query, in index order.
+        //Entries still have to be checked with overlaps()
+        const vector<size_t> & active() const { return active_; }
+};
+
+#endif
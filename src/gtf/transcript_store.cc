@@ -0,0 +1,162 @@
+/*  transcript_store.cc -- compact storage of transcripts and exons
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include "transcript_store.h"
+
+using namespace std;
+
+//Add an exon to a transcript
+//The gene of a transcript is taken from its first exon
+void ContigTranscripts::add_exon(const string &transcript_name,
+                                 const string &gene_name,
+                                 Strand strand, CHRPOS start, CHRPOS end) {
+    uint32_t transcript = transcript_names_.intern(transcript_name);
+    if(transcript == transcripts_.size()) {
+        TranscriptRecord t1;
+        t1.name = transcript;
+        t1.gene = gene_names_.intern(gene_name);
+        t1.first_exon = 0;
+        t1.n_exons = 0;
+        t1.strand = strand;
+        transcripts_.push_back(t1);
+    }
+    PendingExon e1 = {transcript, start, end};
+    pending_.push_back(e1);
+}
+
+//Order exons by transcript, then from the first to the last exon
+//of the transcript - ascending start on the positive strand and
+//descending start on the negative strand.
+struct ExonOrder {
+    const vector<TranscriptRecord> &transcripts;
+    ExonOrder(const vector<TranscriptRecord> &t1) : transcripts(t1) {}
+    template <class E>
+    bool operator() (const E &a, const E &b) const {
+        if(a.transcript != b.transcript)
+            return a.transcript < b.transcript;
+        if(transcripts[a.transcript].strand == STRAND_MINUS)
+            return a.start > b.start;
+        return a.start < b.start;
+    }
+};
+
+//Sort the exons within transcripts and pack them
+//into the flat exon arrays
+void ContigTranscripts::pack() {
+    if(pending_.empty())
+        return;
+    //Unpack the exons that were already packed
+    vector<PendingExon> exons;
+    exons.reserve(exon_starts_.size() + pending_.size());
+    for(uint32_t t = 0; t < transcripts_.size(); t++) {
+        const TranscriptRecord &t1 = transcripts_[t];
+        for(uint32_t i = t1.first_exon; i < t1.first_exon + t1.n_exons; i++) {
+            PendingExon e1 = {t, exon_starts_[i], exon_ends_[i]};
+            exons.push_back(e1);
+        }
+    }
+    exons.insert(exons.end(), pending_.begin(), pending_.end());
+    vector<PendingExon>().swap(pending_);
+    for(size_t i = 0; i < exons.size(); i++) {
+        if(transcripts_[exons[i].transcript].strand == STRAND_UNKNOWN) {
+            cerr << "Undefined strand for exon ";
+            cerr << exons[i].start << exons[i].end;
+            exit(1);
+        }
+    }
+    stable_sort(exons.begin(), exons.end(), ExonOrder(transcripts_));
+    exon_starts_.resize(exons.size());
+    exon_ends_.resize(exons.size());
+    for(uint32_t t = 0; t < transcripts_.size(); t++) {
+        transcripts_[t].n_exons = 0;
+    }
+    for(size_t i = 0; i < exons.size(); i++) {
+        TranscriptRecord &t1 = transcripts_[exons[i].transcript];
+        if(t1.n_exons == 0)
+            t1.first_exon = i;
+        t1.n_exons++;
+        exon_starts_[i] = exons[i].start;
+        exon_ends_[i] = exons[i].end;
+    }
+}
+
+//Pack the exons and build the interval index,
+//the splice site tables and the splice graphs
+//The interval of a transcript spans its first to its last exon.
+void ContigTranscripts::build_index() {
+    pack();
+    index_ = TranscriptIndex();
+    splice_sites_[0] = SpliceSites();
+    splice_sites_[1] = SpliceSites();
+    splice_graphs_[0] = SpliceGraph();
+    splice_graphs_[1] = SpliceGraph();
+    for(uint32_t t = 0; t < transcripts_.size(); t++) {
+        ExonView exons = this->exons(t);
+        CHRPOS start = min(exons[0].start, exons[exons.size() - 1].start);
+        CHRPOS end = max(exons[0].end, exons[exons.size() - 1].end);
+        index_.add(start, end, t);
+        splice_sites_[exons.strand() == STRAND_MINUS].add_transcript(exons);
+        splice_graphs_[exons.strand() == STRAND_MINUS].add_transcript(t, exons);
+    }
+    index_.build();
+    splice_sites_[0].build();
+    splice_sites_[1].build();
+    splice_graphs_[0].build(transcripts_.size());
+    splice_graphs_[1].build(transcripts_.size());
+}
+
+//Exons of a transcript
+ExonView ContigTranscripts::exons(uint32_t transcript) const {
+    if(!packed()) {
+        throw runtime_error("Exons of " + chrom_ + " have not been packed.");
+    }
+    const TranscriptRecord &t1 = transcripts_[transcript];
+    return ExonView(&exon_starts_[0] + t1.first_exon,
+                    &exon_ends_[0] + t1.first_exon,
+                    t1.n_exons, t1.strand);
+}
+
+//Exons of a transcript as BED6 entries, the packed exons followed by
+//the exons not packed yet in input order
+//The exon name and score are not stored, these are always "exon" and "."
+vector<BED> ContigTranscripts::exon_beds(uint32_t transcript) const {
+    vector<BED> beds;
+    const TranscriptRecord &t1 = transcripts_[transcript];
+    string strand = strand_to_str(t1.strand);
+    for(uint32_t i = t1.first_exon; i < t1.first_exon + t1.n_exons; i++) {
+        beds.push_back(BED(chrom_, exon_starts_[i], exon_ends_[i],
+                           "exon", ".", strand));
+    }
+    for(size_t i = 0; i < pending_.size(); i++) {
+        if(pending_[i].transcript == transcript) {
+            beds.push_back(BED(chrom_, pending_[i].start, pending_[i].end,
+                               "exon", ".", strand));
+        }
+    }
+    return beds;
+}
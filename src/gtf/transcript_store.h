@@ -0,0 +1,246 @@
+/*  transcript_store.h -- compact storage of transcripts and exons
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef TRANSCRIPT_STORE_H_
+#define TRANSCRIPT_STORE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "bedFile.h"
+#include "splice_graph.h"
+#include "splice_sites.h"
+#include "transcript_index.h"
+
+using namespace std;
+
+//Strand of a transcript
+enum Strand {
+    STRAND_PLUS,
+    STRAND_MINUS,
+    STRAND_UNKNOWN
+};
+
+//Convert "+"/"-" to a Strand
+inline Strand parse_strand(const string &strand) {
+    if(strand == "+")
+        return STRAND_PLUS;
+    if(strand == "-")
+        return STRAND_MINUS;
+    return STRAND_UNKNOWN;
+}
+
+//Convert a Strand to "+"/"-"/"."
+inline const char* strand_to_str(Strand strand) {
+    switch(strand) {
+        case STRAND_PLUS:
+            return "+";
+        case STRAND_MINUS:
+            return "-";
+        default:
+            return ".";
+    }
+}
+
+//Intern strings as dense integer IDs
+class StringPool {
+    private:
+        //ID to string
+        vector<string> names_;
+        //string to ID
+        map<string, uint32_t> ids_;
+    public:
+        //Return the ID of name, adding it if it is new
+        uint32_t intern(const string &name) {
+            map<string, uint32_t>::iterator it = ids_.find(name);
+            if(it != ids_.end())
+                return it->second;
+            uint32_t id = names_.size();
+            names_.push_back(name);
+            ids_.insert(make_pair(name, id));
+            return id;
+        }
+        //Look up the ID of name, false if it was never interned
+        bool find(const string &name, uint32_t &id) const {
+            map<string, uint32_t>::const_iterator it = ids_.find(name);
+            if(it == ids_.end())
+                return false;
+            id = it->second;
+            return true;
+        }
+        //Get the string for an ID
+        const string & name(uint32_t id) const { return names_[id]; }
+        //Number of strings in the pool
+        size_t size() const { return names_.size(); }
+};
+
+//Coordinates of an exon, one based and closed like the GTF
+struct Exon {
+    CHRPOS start;
+    CHRPOS end;
+};
+
+//Read-only view of the exons of one transcript.
+//The exons are ordered from the first exon to the last exon of the
+//transcript, i.e by descending start on the negative strand.
+class ExonView {
+    private:
+        const CHRPOS *starts_;
+        const CHRPOS *ends_;
+        uint32_t size_;
+        Strand strand_;
+    public:
+        ExonView(const CHRPOS *starts, const CHRPOS *ends,
+                 uint32_t size, Strand strand)
+            : starts_(starts)
+            , ends_(ends)
+            , size_(size)
+            , strand_(strand)
+        {}
+        //Number of exons
+        size_t size() const { return size_; }
+        //Strand of the transcript
+        Strand strand() const { return strand_; }
+        //Exon i
+        Exon operator[] (size_t i) const {
+            Exon e = {starts_[i], ends_[i]};
+            return e;
+        }
+};
+
+//A transcript, the exons are exon_starts_/exon_ends_
+//[first_exon, first_exon + n_exons) of its contig
+struct TranscriptRecord {
+    //ID in the transcript pool of the contig
+    uint32_t name;
+    //ID in the gene pool of the contig
+    uint32_t gene;
+    //Offset of the first exon
+    uint32_t first_exon;
+    //Number of exons
+    uint32_t n_exons;
+    //Strand of the transcript
+    Strand strand;
+};
+
+//The transcripts of one contig.
+//Transcript and gene names are interned, exons are held in two flat
+//coordinate arrays with the exons of each transcript contiguous.
+class ContigTranscripts {
+    private:
+        //An exon that has not been packed yet
+        struct PendingExon {
+            uint32_t transcript;
+            CHRPOS start;
+            CHRPOS end;
+        };
+        //Name of the contig
+        string chrom_;
+        //Transcript names
+        StringPool transcript_names_;
+        //Gene names
+        StringPool gene_names_;
+        //Transcripts, indexed by transcript ID
+        vector<TranscriptRecord> transcripts_;
+        //Exon starts
+        vector<CHRPOS> exon_starts_;
+        //Exon ends
+        vector<CHRPOS> exon_ends_;
+        //Exons added since the last pack, in input order
+        vector<PendingExon> pending_;
+        //Interval index over the transcripts
+        TranscriptIndex index_;
+        //Annotated splice sites on the positive and negative strands
+        SpliceSites splice_sites_[2];
+        //Loci on the positive and negative strands
+        SpliceGraph splice_graphs_[2];
+    public:
+        //Constructor
+        ContigTranscripts(const string &chrom)
+            : chrom_(chrom)
+        {}
+        //Name of the contig
+        const string & chrom() const { return chrom_; }
+        //Add an exon to a transcript
+        //The gene of a transcript is taken from its first exon
+        void add_exon(const string &transcript_name,
+                      const string &gene_name,
+                      Strand strand, CHRPOS start, CHRPOS end);
+        //Sort the exons within transcripts and pack them
+        //into the flat exon arrays
+        void pack();
+        //Are all the exons packed
+        bool packed() const { return pending_.empty(); }
+        //Pack the exons and build the interval index,
+        //the splice site tables and the splice graphs
+        void build_index();
+        //Number of transcripts
+        size_t n_transcripts() const { return transcripts_.size(); }
+        //Look up a transcript by name
+        bool find_transcript(const string &name, uint32_t &transcript) const {
+            return transcript_names_.find(name, transcript);
+        }
+        //Exons of a transcript, from the first to the last exon.
+        //Throws unless the contig is packed.
+        ExonView exons(uint32_t transcript) const;
+        //Exons of a transcript as BEDs, the packed exons followed by
+        //the exons not packed yet in input order
+        vector<BED> exon_beds(uint32_t transcript) const;
+        //Strand of a transcript
+        Strand strand(uint32_t transcript) const {
+            return transcripts_[transcript].strand;
+        }
+        //Name of a transcript
+        const string & transcript_name(uint32_t transcript) const {
+            return transcript_names_.name(transcripts_[transcript].name);
+        }
+        //Gene ID of a transcript
+        uint32_t gene(uint32_t transcript) const {
+            return transcripts_[transcript].gene;
+        }
+        //Gene name of a transcript
+        const string & gene_name(uint32_t transcript) const {
+            return gene_names_.name(transcripts_[transcript].gene);
+        }
+        //Name of a gene ID
+        const string & gene_name_by_id(uint32_t gene) const {
+            return gene_names_.name(gene);
+        }
+        //Interval index over the transcripts
+        const TranscriptIndex & index() const { return index_; }
+        //Annotated splice sites on a strand, strand must be + or -
+        const SpliceSites & splice_sites(Strand strand) const {
+            return splice_sites_[strand == STRAND_MINUS];
+        }
+        //Loci on a strand, strand must be + or -
+        const SpliceGraph & splice_graph(Strand strand) const {
+            return splice_graphs_[strand == STRAND_MINUS];
+        }
+        //Number of exons of a transcript
+        uint32_t n_exons(uint32_t transcript) const {
+            return transcripts_[transcript].n_exons;
+        }
+};
+
+#endif
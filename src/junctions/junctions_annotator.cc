@@ -22,6 +22,9 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
 FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.  */
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <getopt.h>
 #include <stdexcept>
 #include <string>
@@ -52,54 +55,82 @@ void JunctionsAnnotator::set_ofstream_object(ofstream &out) {
     common::copy_stream(ofs_, out);
 }
 
+//Print the IDs in ids whose names differ from the previous one, the
+//IDs are sorted by name first
+template <class Name>
+static void print_sorted_names(ostream &out, IdList &ids, Name name) {
+    if(ids.empty()) {
+        out << "NA";
+        return;
+    }
+    sort(ids.begin(), ids.end(), [&name](uint32_t a, uint32_t b) {
+        return name(a) < name(b);
+    });
+    for(const uint32_t *id = ids.begin(); id != ids.end(); ++id) {
+        if(id != ids.begin()) {
+            if(name(*id) == name(*(id - 1)))
+                continue;
+            out << ",";
+        }
+        out << name(*id);
+    }
+}
+
+//Print the genes of the transcripts comma separated, sorted and
+//without repeats, "NA" if there are none
+void TranscriptOverlap::print_genes(ostream &out) const {
+    const ContigTranscripts *contig1 = contig;
+    IdList genes;
+    for(const uint32_t *t = transcripts.begin(); t != transcripts.end(); ++t) {
+        genes.push_back(contig1->gene(*t));
+    }
+    print_sorted_names(out, genes, [contig1](uint32_t gene) -> const string & {
+        return contig1->gene_name_by_id(gene);
+    });
+}
+
+//Print the transcripts comma separated, sorted and without repeats,
+//"NA" if there are none
+void TranscriptOverlap::print_transcripts(ostream &out) const {
+    const ContigTranscripts *contig1 = contig;
+    IdList sorted = transcripts;
+    print_sorted_names(out, sorted, [contig1](uint32_t transcript) -> const string & {
+        return contig1->transcript_name(transcript);
+    });
+}
+
 //Open junctions file
 void JunctionsAnnotator::open_junctions() {
-    junctions_.Open();
+    junctions_.open(junctions_file_, junction_regions());
 }
 
 //Open junctions file
 void JunctionsAnnotator::close_junctions() {
-    junctions_.Close();
+    junctions_.close();
 }
 
 //Adjust the start and end of the junction
-void JunctionsAnnotator::adjust_junction_ends(BED & line) {
+void JunctionsAnnotator::adjust_junction_ends(AnnotatedJunction & line) {
     //Adjust the start and end with block sizes
     //The junction start is thick_start + block_size1
     //The junction end is thick_end - block_size2 + 1
-    if(line.fields.size() != 12  || line.fields[10].empty()) {
-        stringstream position;
-        position << line.chrom << ":" << line.start;
-        throw runtime_error("BED line not in BED12 format. start: " +
-                            position.str());
-    }
-    string blocksize_field = line.fields[10];
-    vector<int> block_sizes;
-    Tokenize(blocksize_field, block_sizes, ',');
-    line.start += block_sizes[0];
-    line.end -= block_sizes[1] - 1;
+    //The reader has checked the line is BED12
+    line.thick_start = line.start;
+    line.start += line.block_size1;
+    line.end -= line.block_size2 - 1;
 }
 
 //Get a single line from the junctions file
-bool JunctionsAnnotator::get_single_junction(BED & line) {
-    junctions_._status = BED_INVALID;
-    if(junctions_.GetNextBed(line) && junctions_._status == BED_VALID) {
-        return true;
-    } else {
-        return false;
-    }
+bool JunctionsAnnotator::get_single_junction(AnnotatedJunction & line) {
+    return junctions_.next(line);
 }
 
 //Get the splice_site bases
 void JunctionsAnnotator::get_splice_site(AnnotatedJunction & line) {
-    string position1 = line.chrom + ":" +
-                      common::num_to_str(line.start + 1) + "-" + common::num_to_str(line.start + 2);
-    string position2 = line.chrom + ":" +
-                      common::num_to_str(line.end - 2) + "-" + common::num_to_str(line.end - 1);
     string seq1, seq2;
     try {
-        seq1 = get_reference_sequence(position1);
-        seq2 = get_reference_sequence(position2);
+        seq1 = get_reference_sequence(line.chrom, line.start + 1, line.start + 2);
+        seq2 = get_reference_sequence(line.chrom, line.end - 2, line.end - 1);
     } catch (const runtime_error& e) {
         throw e;
     }
@@ -110,131 +141,155 @@ void JunctionsAnnotator::get_splice_site(AnnotatedJunction & line) {
     } else {
         line.splice_site = seq1 + "-" + seq2;
     }
+    if(splice_scorer_)
+        score_splice_site_strength(line);
     return;
 }
 
+//Score the donor and acceptor of a junction.
+//The context of the left end is 3 exon bases and 20 intron bases, the
+//right end 20 intron bases and 3 exon bases. On the positive strand the
+//donor starts the left context and the acceptor is the right context,
+//on the negative strand the donor starts the reverse complement of the
+//right context and the acceptor is the reverse complement of the left.
+void JunctionsAnnotator::score_splice_site_strength(AnnotatedJunction & line) {
+    line.splice_scores = true;
+    line.donor_score = NAN;
+    line.acceptor_score = NAN;
+    const CHRPOS exon = SpliceSiteScorer::kDonorExon;
+    const CHRPOS intron = SpliceSiteScorer::kAcceptorIntron;
+    const size_t length = SpliceSiteScorer::kAcceptorLength;
+    //The context starts before the contig, or the strand is not known
+    if(line.start < exon || line.end <= intron ||
+       (line.strand != "+" && line.strand != "-"))
+        return;
+    string donor = get_reference_sequence(line.chrom, line.start - exon + 1,
+                                          line.start + intron);
+    string acceptor = get_reference_sequence(line.chrom, line.end - intron,
+                                             line.end + exon - 1);
+    if(line.strand == "-") {
+        donor.swap(acceptor);
+        donor = common::rev_comp(donor);
+        acceptor = common::rev_comp(acceptor);
+    }
+    //Contexts shorter than length run off the end of the contig
+    double score;
+    if(donor.size() == length &&
+       splice_scorer_->score_donor(donor.data(), score))
+        line.donor_score = score;
+    if(acceptor.size() == length &&
+       splice_scorer_->score_acceptor(acceptor.data(), score))
+        line.acceptor_score = score;
+}
+
 //Extract gtf info
+//A run limited to regions only loads the contigs of the regions, and
+//loads them here so a bad GTF is reported before any output is written
 bool JunctionsAnnotator::load_gtf() {
     try {
-        gtf_.load();
+        vector<JunctionRegion> regions = junction_regions();
+        AnnotationSources sources = load_annotation_sources(gtffile_,
+                                                            !regions.empty());
+        for(size_t i = 0; i < regions.size(); i++) {
+            for(size_t j = 0; j < sources.size(); j++) {
+                sources[j].gtf->contig_transcripts(regions[i].chrom);
+            }
+        }
+        gtf_ = sources[0].gtf;
+        extra_sources_.assign(sources.begin() + 1, sources.end());
     } catch (runtime_error e) {
         throw e;
     }
     return true;
 }
 
-//Find overlap between transcript and junction on the negative strand,
-//function returns true if either the acceptor or the donor is known
-bool JunctionsAnnotator::overlap_ps(const vector<BED>& exons,
-                                          AnnotatedJunction & junction) {
-    //skip single exon genes
-    if(skip_single_exon_genes_ && exons.size() == 1) return false;
+//Annotate with the reference, options and loaded annotation of
+//another annotator
+void JunctionsAnnotator::share_annotation(const JunctionsAnnotator &other) {
+    ref_ = other.ref_;
+    skip_single_exon_genes_ = other.skip_single_exon_genes_;
+    use_packed_reference_ = other.use_packed_reference_;
+    splice_scorer_ = other.splice_scorer_;
+    nearest_splice_sites_ = other.nearest_splice_sites_;
+    gtffile_ = other.gtffile_;
+    gtf_ = other.gtf_;
+    extra_sources_ = other.extra_sources_;
+}
+
+//Walk the exons of a positive strand transcript to find the exons
+//skipped by the junction. Only used for loci that are not regular,
+//the positions are collected in irregular_starts_/irregular_ends_
+void JunctionsAnnotator::overlap_ps(const ExonView & exons,
+                                    AnnotatedJunction & junction) {
     bool junction_start = false;
-    bool known_junction = false;
-    //check if transcript overlaps with junction
-    if(exons[0].start > junction.end ||
-            exons[exons.size() - 1].end < junction.start)
-        return known_junction;
     for(std::size_t i = 0; i < exons.size(); i++) {
         if(exons[i].start > junction.end) {
             //No need to look any further
             //the rest of the exons are outside the junction
             break;
         }
-        //known junction
-        if(exons[i].end == junction.start &&
+        //known junction, the donor exon is not skipped
+        if(i + 1 < exons.size() &&
+                exons[i].end == junction.start &&
                 exons[i + 1].start == junction.end) {
-            junction.known_acceptor = true;
-            junction.known_donor = true;
-            junction.known_junction = true;
-            known_junction = true;
+            continue;
+        }
+        if(!junction_start) {
+            if(exons[i].end >= junction.start) {
+                junction_start = true;
+            }
         }
-        else {
-            if(!junction_start) {
-                if(exons[i].end >= junction.start) {
-                    junction_start = true;
-                }
+        if(junction_start) {
+            if(exons[i].start > junction.start &&
+                    exons[i].end < junction.end) {
+                junction.exons_skipped = true;
             }
-            if(junction_start) {
-                if(exons[i].start > junction.start &&
-                        exons[i].end < junction.end) {
-                    junction.exons_skipped.insert(exons[i].name);
-                }
-                if(exons[i].start > junction.start) {
-                    junction.donors_skipped.insert(exons[i].start);
-                }
-                if(exons[i].end < junction.end) {
-                    junction.acceptors_skipped.insert(exons[i].end);
-                }
-                if(exons[i].end == junction.start) {
-                    junction.known_donor = true;
-                }
-                //TODO - check for last exon
-                if(exons[i].start == junction.end) {
-                    junction.known_acceptor = true;
-                }
+            if(exons[i].start > junction.start) {
+                irregular_starts_.push_back(exons[i].start);
+            }
+            if(exons[i].end < junction.end) {
+                irregular_ends_.push_back(exons[i].end);
             }
         }
     }
-    annotate_anchor(junction);
-    return (junction.anchor != "N");
 }
 
-//Find overlap between transcript and junction on the negative strand,
-//function returns true if either the acceptor or the donor is known
-bool JunctionsAnnotator::overlap_ns(const vector<BED> & exons,
-                                          AnnotatedJunction & junction) {
-    //skip single exon genes
-    if(skip_single_exon_genes_ && exons.size() == 1) return false;
+//Walk the exons of a negative strand transcript to find the exons
+//skipped by the junction. Only used for loci that are not regular,
+//the positions are collected in irregular_starts_/irregular_ends_
+void JunctionsAnnotator::overlap_ns(const ExonView & exons,
+                                    AnnotatedJunction & junction) {
     bool junction_start = false;
-    bool known_junction = false;
-    //check if transcript overlaps with junction
-    if(exons[0].end < junction.start ||
-            exons[exons.size() - 1].start > junction.end) {
-        return known_junction;
-    }
     for(std::size_t i = 0; i < exons.size(); i++) {
         if(exons[i].end < junction.start) {
             //No need to look any further
             //the rest of the exons are outside the junction
             break;
         }
-        //Check if this is a known junction
-        if(exons[i].start == junction.end &&
+        //Check if this is a known junction, the donor exon is not skipped
+        if(i + 1 < exons.size() &&
+                exons[i].start == junction.end &&
                 exons[i + 1].end == junction.start) {
-            junction.known_acceptor = true;
-            junction.known_donor = true;
-            junction.known_junction = true;
-            known_junction = true;
+            continue;
         }
-        else {
-            if(!junction_start) {
-                if(exons[i].start <= junction.end) {
-                    junction_start = true;
-                }
+        if(!junction_start) {
+            if(exons[i].start <= junction.end) {
+                junction_start = true;
+            }
+        }
+        if(junction_start) {
+            if(exons[i].start > junction.start &&
+                    exons[i].end < junction.end) {
+                junction.exons_skipped = true;
+            }
+            if(exons[i].start > junction.start) {
+                irregular_starts_.push_back(exons[i].start);
             }
-            if(junction_start) {
-                if(exons[i].start > junction.start &&
-                        exons[i].end < junction.end) {
-                    junction.exons_skipped.insert(exons[i].name);
-                }
-                if(exons[i].start > junction.start) {
-                    junction.donors_skipped.insert(exons[i].start);
-                }
-                if(exons[i].end < junction.end) {
-                    junction.acceptors_skipped.insert(exons[i].end);
-                }
-                if(exons[i].start == junction.end) {
-                    junction.known_donor = true;
-                }
-                if(exons[i].end == junction.start) {
-                    junction.known_acceptor = true;
-                }
+            if(exons[i].end < junction.end) {
+                irregular_ends_.push_back(exons[i].end);
             }
         }
     }
-    annotate_anchor(junction);
-    return (junction.anchor != "N");
 }
 
 //Annotate the anchor i.e is this a known/novel donor-acceptor pair
@@ -254,77 +309,319 @@ void JunctionsAnnotator::annotate_anchor(AnnotatedJunction & junction) {
 }
 
 //Check for overlap between a transcript and junctions
-//Check if the junction we saw is a known junction
-//Calculate exons_skipped, donors_skipped, acceptors_skipped
-void JunctionsAnnotator::check_for_overlap(string transcript_id, AnnotatedJunction & junction) {
-    const vector<BED> & exons =
-        gtf_.get_exons_from_transcript(transcript_id);
-    if(!exons.size()) {
-        throw runtime_error("Unexpected error. No exons for transcript "
-                            + transcript_id);
-    }
-    string transcript_strand = exons[0].strand;
+//Returns true if the transcript counts towards the skipped exons,
+//the transcript and its gene are listed if the junction has a
+//known donor or acceptor
+bool JunctionsAnnotator::check_for_overlap(const ContigTranscripts & contig,
+                                           uint32_t transcript,
+                                           AnnotatedJunction & junction) {
     //Make sure the strands of the junction and transcript match
-    if(junction.strand != transcript_strand)
+    if(parse_strand(junction.strand) != contig.strand(transcript))
+        return false;
+    //skip single exon genes
+    if(skip_single_exon_genes_ && contig.n_exons(transcript) == 1)
+        return false;
+    if(junction.anchor != "N") {
+        junction.overlap.add(contig, transcript);
+    }
+    return true;
+}
+
+//Set known_donor, known_acceptor and known_junction from the
+//splice site tables of the contig, and annotate the anchor
+//Junctions with an unknown strand match no transcripts
+void JunctionsAnnotator::annotate_splice_sites(const ContigTranscripts & contig,
+                                               AnnotatedJunction & junction) {
+    Strand strand = parse_strand(junction.strand);
+    if(strand == STRAND_UNKNOWN)
         return;
-    //Remember exons are sorted from exon1 to last exon
-    if(junction.strand == "+") {
-        if(overlap_ps(exons, junction)) {
-            junction.transcripts_overlap.insert(transcript_id);
-            junction.genes_overlap.insert(
-                    gtf_.get_gene_from_transcript(transcript_id));
-        }
-    } else if(junction.strand == "-") {
-        if(overlap_ns(exons, junction)) {
-            junction.transcripts_overlap.insert(transcript_id);
-            junction.genes_overlap.insert(
-                    gtf_.get_gene_from_transcript(transcript_id));
-        }
+    const SpliceSites & sites = contig.splice_sites(strand);
+    bool single_exon = !skip_single_exon_genes_;
+    bool left_known = sites.has_exon_end(junction.start, single_exon);
+    bool right_known = sites.has_exon_start(junction.end, single_exon);
+    if(strand == STRAND_PLUS) {
+        junction.known_donor = left_known;
+        junction.known_acceptor = right_known;
     } else {
-        throw runtime_error("\nUnknown strand " + junction.strand);
+        junction.known_donor = right_known;
+        junction.known_acceptor = left_known;
+    }
+    junction.known_junction = sites.has_intron(junction.start, junction.end);
+    annotate_anchor(junction);
+}
+
+//Names of the annotation sources after the first
+vector<string> JunctionsAnnotator::extra_source_names() const {
+    vector<string> names;
+    for(size_t i = 0; i < extra_sources_.size(); i++) {
+        names.push_back(extra_sources_[i].name);
+    }
+    return names;
+}
+
+//Find the annotated donor and acceptor nearest to the junction.
+//Annotated donors and acceptors are the ends of annotated introns,
+//on the positive strand the donors are their left ends and on the
+//negative strand their right ends.
+void JunctionsAnnotator::annotate_nearest_splice_sites(AnnotatedJunction & junction) {
+    junction.nearest_sites = true;
+    Strand strand = parse_strand(junction.strand);
+    const ContigTranscripts * contig = gtf_->contig_transcripts(junction.chrom);
+    if(contig == NULL || strand == STRAND_UNKNOWN)
+        return;
+    const SpliceSites & sites = contig->splice_sites(strand);
+    int64_t left, right;
+    if(!sites.nearest_intron_left(junction.start, left) ||
+       !sites.nearest_intron_right(junction.end, right))
+        return;
+    if(strand == STRAND_PLUS) {
+        junction.donor_distance = left;
+        junction.acceptor_distance = right;
+    } else {
+        junction.donor_distance = -right;
+        junction.acceptor_distance = -left;
     }
 }
 
 //Annotate with gtf
-//Takes a single junction BED and annotates with GTF
+//Takes a single junction BED and annotates with the primary annotation,
+//then each additional source into its own SourceAnnotation
 void JunctionsAnnotator::annotate_junction_with_gtf(AnnotatedJunction & j1) {
-    //From BedTools
-    BIN start_bin, end_bin;
-    start_bin = (j1.start >> _binFirstShift);
-    end_bin = ((j1.end-1) >> _binFirstShift);
-    //We loop through each UCSC BIN level for feature A's chrom.
-    //For each BIN, we loop through each B feature and add it to
-    // hits if it meets all of the user's requests.
-    for (BINLEVEL i = 0; i < _binLevels; ++i) {
-        BIN offset = _binOffsetsExtended[i];
-        for (BIN b = (start_bin + offset); b <= (end_bin + offset); ++b) {
-            vector<string> transcripts = gtf_.transcripts_from_bin(j1.chrom, b);
-            if(transcripts.size())
-                for(std::size_t i = 0; i < transcripts.size(); i++)
-                    check_for_overlap(transcripts[i], j1);
+    sweeps_.resize(extra_sources_.size() + 1);
+    annotate_junction_with_source(*gtf_, sweeps_[0], j1);
+    if(nearest_splice_sites_)
+        annotate_nearest_splice_sites(j1);
+    j1.source_annotations.resize(extra_sources_.size());
+    for(size_t i = 0; i < extra_sources_.size(); i++) {
+        source_junction_.reset();
+        source_junction_.chrom = j1.chrom;
+        source_junction_.start = j1.start;
+        source_junction_.end = j1.end;
+        source_junction_.strand = j1.strand;
+        source_junction_.thick_start = j1.thick_start;
+        annotate_junction_with_source(*extra_sources_[i].gtf, sweeps_[i + 1],
+                                      source_junction_);
+        SourceAnnotation &source = j1.source_annotations[i];
+        source.anchor = source_junction_.anchor;
+        source.known_donor = source_junction_.known_donor;
+        source.known_acceptor = source_junction_.known_acceptor;
+        source.known_junction = source_junction_.known_junction;
+        source.overlap = source_junction_.overlap;
+    }
+}
+
+//Annotate a junction against one annotation
+//The overlapping transcripts are visited by start, so the transcripts
+//of a locus come one after the other and each locus is counted once
+//from the splice graph. Loci that are not regular fall back to
+//walking the exons of each transcript.
+//While the junctions arrive sorted by thick_start the candidates come
+//from the sweep, else from a binary search of the transcript index.
+void JunctionsAnnotator::annotate_junction_with_source(const GtfParser & gtf,
+                                                       TranscriptSweep & sweep,
+                                                       AnnotatedJunction & j1) {
+    const ContigTranscripts * contig = gtf.contig_transcripts(j1.chrom);
+    if(contig == NULL)
+        return;
+    annotate_splice_sites(*contig, j1);
+    Strand strand = parse_strand(j1.strand);
+    if(strand == STRAND_UNKNOWN)
+        return;
+    const SpliceGraph & graph = contig->splice_graph(strand);
+    const TranscriptIndex & index = contig->index();
+    SkippedCounts counts;
+    bool in_locus = false;
+    uint32_t locus = 0;
+    irregular_starts_.clear();
+    irregular_ends_.clear();
+    const size_t *entries = NULL;
+    size_t n_entries = 0, first = 0;
+    if(sweep.advance(index, j1.thick_start, j1.end)) {
+        n_entries = sweep.active().size();
+        if(n_entries)
+            entries = &sweep.active()[0];
+    } else {
+        index.overlap(j1.start, j1.end, first, n_entries);
+        n_entries -= first;
+    }
+    for(size_t k = 0; k < n_entries; k++) {
+        size_t i = entries ? entries[k] : first + k;
+        uint32_t transcript = index.transcript(i);
+        if(!index.overlaps(i, j1.start, j1.end) ||
+           !check_for_overlap(*contig, transcript, j1))
+            continue;
+        uint32_t locus1 = graph.locus(transcript);
+        if(!graph.locus_data(locus1).regular) {
+            if(strand == STRAND_PLUS)
+                overlap_ps(contig->exons(transcript), j1);
+            else
+                overlap_ns(contig->exons(transcript), j1);
+            continue;
         }
-        start_bin >>= _binNextShift;
-        end_bin >>= _binNextShift;
+        if(!in_locus || locus1 != locus) {
+            if(in_locus)
+                graph.count_skipped(locus, locus_transcripts_,
+                                    j1.start, j1.end, counts);
+            locus = locus1;
+            in_locus = true;
+            locus_transcripts_.assign(graph.locus_data(locus).words, 0);
+        }
+        uint32_t bit = graph.bit(transcript);
+        locus_transcripts_[bit / 64] |= (uint64_t) 1 << (bit % 64);
     }
+    if(in_locus)
+        graph.count_skipped(locus, locus_transcripts_,
+                            j1.start, j1.end, counts);
+    //Loci do not overlap, so positions from different loci are distinct
+    sort(irregular_starts_.begin(), irregular_starts_.end());
+    sort(irregular_ends_.begin(), irregular_ends_.end());
+    counts.starts += unique(irregular_starts_.begin(), irregular_starts_.end()) -
+                     irregular_starts_.begin();
+    counts.ends += unique(irregular_ends_.begin(), irregular_ends_.end()) -
+                   irregular_ends_.begin();
+    j1.donors_skipped = counts.starts;
+    j1.acceptors_skipped = counts.ends;
+    j1.exons_skipped = j1.exons_skipped || counts.exon;
+}
+
+//Load the reference index if it is not loaded
+void JunctionsAnnotator::open_reference() {
+    if(fai_ != NULL)
+        return;
+    fai_ = fai_load(ref_.c_str());
+    if(fai_ == NULL)
+        throw runtime_error("Unable to load the FASTA index for " + ref_);
+}
+
+//Find or read the window holding [beg, stop) of chrom, zero
+//based, returns NULL if the range is wider than a window
+const ReferenceWindow *
+JunctionsAnnotator::reference_window(const string & chrom, CHRPOS len,
+                                     CHRPOS beg, CHRPOS stop) {
+    if(stop - beg > ReferenceWindow::kSize)
+        return NULL;
+    for(int i = 0; i < 2; i++) {
+        if(windows_[i].contains(chrom, beg, stop)) {
+            next_window_ = 1 - i;
+            return &windows_[i];
+        }
+    }
+    //Start the window a little before the lookup so that nearby
+    //lookups on either side hit it
+    CHRPOS window_beg = beg > ReferenceWindow::kSize / 4 ?
+                        beg - ReferenceWindow::kSize / 4 : 0;
+    CHRPOS window_stop = min(len, window_beg + ReferenceWindow::kSize);
+    int seq_len;
+    char *s = faidx_fetch_seq(fai_, chrom.c_str(), window_beg,
+                              window_stop - 1, &seq_len);
+    if(s == NULL)
+        throw runtime_error("Unable to extract FASTA sequence "
+                             "for contig " + chrom);
+    ReferenceWindow & window = windows_[next_window_];
+    window.chrom = chrom;
+    window.start = window_beg;
+    window.seq.assign(s, seq_len);
+    free(s);
+    next_window_ = 1 - next_window_;
+    if(!window.contains(chrom, beg, stop))
+        throw runtime_error("Unable to extract FASTA sequence "
+                             "for contig " + chrom);
+    return &window;
+}
+
+//Get the reference bases in [start, end] from the packed copy
+string JunctionsAnnotator::get_packed_sequence(const string & chrom,
+                                               CHRPOS start, CHRPOS end) {
+    if(!packed_reference_.is_open())
+        packed_reference_.open(ref_);
+    if(chrom != packed_chrom_) {
+        if(!packed_reference_.find_contig(chrom, packed_contig_))
+            throw runtime_error("Unable to extract FASTA sequence "
+                                 "for position " +
+                                 common::create_region_string(chrom.c_str(),
+                                                              start, end));
+        packed_chrom_ = chrom;
+    }
+    return packed_reference_.sequence(packed_contig_,
+                                      start > 0 ? start - 1 : 0, end);
+}
+
+//Get the reference bases in [start, end] of chrom, one based.
+//Positions past the end of the contig are clipped like fai_fetch
+string JunctionsAnnotator::get_reference_sequence(const string & chrom,
+                                                  CHRPOS start, CHRPOS end) {
+    if(use_packed_reference_)
+        return get_packed_sequence(chrom, start, end);
+    open_reference();
+    if(!faidx_has_seq(fai_, chrom.c_str()))
+        throw runtime_error("Unable to extract FASTA sequence "
+                             "for position " +
+                             common::create_region_string(chrom.c_str(),
+                                                          start, end));
+    CHRPOS len = faidx_seq_len(fai_, chrom.c_str());
+    //Zero based, half open
+    CHRPOS beg = start > 0 ? start - 1 : 0;
+    beg = min(beg, len);
+    CHRPOS stop = min(end, len);
+    if(beg >= stop)
+        return string();
+    const ReferenceWindow *window = reference_window(chrom, len, beg, stop);
+    if(window)
+        return window->seq.substr(beg - window->start, stop - beg);
+    int seq_len;
+    char *s = faidx_fetch_seq(fai_, chrom.c_str(), beg, stop - 1, &seq_len);
+    if(s == NULL)
+        throw runtime_error("Unable to extract FASTA sequence "
+                             "for position " +
+                             common::create_region_string(chrom.c_str(),
+                                                          start, end));
+    std::string seq(s, seq_len);
+    free(s);
+    return seq;
 }
 
 //Get the reference sequence at a particular coordinate
 string JunctionsAnnotator::get_reference_sequence(string position) {
     int len;
-    faidx_t *fai = fai_load(ref_.c_str());
-    char *s = fai_fetch(fai, position.c_str(), &len);
+    open_reference();
+    char *s = fai_fetch(fai_, position.c_str(), &len);
     if(s == NULL)
         throw runtime_error("Unable to extract FASTA sequence "
                              "for position " + position);
     std::string seq(s);
     free(s);
-    fai_destroy(fai);
     return seq;
 }
 
+//Regions given with -r/-R, empty to annotate all the junctions
+vector<JunctionRegion> JunctionsAnnotator::junction_regions() const {
+    vector<JunctionRegion> regions;
+    if(region_ != "NA")
+        regions.push_back(parse_junction_region(region_));
+    if(regions_file_ != "NA") {
+        regions = read_junction_regions(regions_file_);
+        if(regions.empty())
+            throw runtime_error("No regions in " + regions_file_);
+    }
+    return regions;
+}
+
+//Are the junctions to be extracted from a BAM/CRAM/SAM file
+bool JunctionsAnnotator::junctions_from_alignments() const {
+    static const char *extensions[] = {".bam", ".cram", ".sam"};
+    for(size_t i = 0; i < 3; i++) {
+        size_t length = strlen(extensions[i]);
+        if(junctions_file_.size() > length &&
+           junctions_file_.compare(junctions_file_.size() - length,
+                                   length, extensions[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
 //Get the name of the GTF file
 string JunctionsAnnotator::gtf_file() {
-    return gtf_.gtffile();
+    return gtffile_;
 }
 
 //Parse the options passed to this tool
@@ -332,14 +629,46 @@ int JunctionsAnnotator::parse_options(int argc, char *argv[]) {
     optind = 1; //Reset before parsing again.
     int c;
     stringstream help_ss;
-    while((c = getopt(argc, argv, "Eo:h")) != -1) {
+    while((c = getopt(argc, argv, "Ea:d:i:I:no:pr:R:s:t:h")) != -1) {
         switch(c) {
             case 'E':
                 skip_single_exon_genes_ = false;
                 break;
+            case 'p':
+                use_packed_reference_ = true;
+                break;
+            case 'n':
+                nearest_splice_sites_ = true;
+                break;
+            case 's':
+                splice_models_ = string(optarg);
+                break;
+            case 't':
+                n_threads_ = atoi(optarg);
+                if(n_threads_ < 1)
+                    throw runtime_error("\nNumber of threads must be at least 1.");
+                break;
             case 'o':
                 output_file_ = string(optarg);
                 break;
+            case 'd':
+                output_dir_ = string(optarg);
+                break;
+            case 'a':
+                min_anchor_length_ = atoi(optarg);
+                break;
+            case 'r':
+                region_ = string(optarg);
+                break;
+            case 'R':
+                regions_file_ = string(optarg);
+                break;
+            case 'i':
+                min_intron_length_ = atoi(optarg);
+                break;
+            case 'I':
+                max_intron_length_ = atoi(optarg);
+                break;
             case 'h':
                 usage(help_ss);
                 throw common::cmdline_help_exception(help_ss.str());
@@ -349,24 +678,58 @@ int JunctionsAnnotator::parse_options(int argc, char *argv[]) {
         }
     }
     if(argc - optind >= 3) {
-        junctions_.bedFile = string(argv[optind++]);
+        junctions_file_ = string(argv[optind++]);
         ref_ = string(argv[optind++]);
-        gtf_.set_gtffile(string(argv[optind++]));
+        gtffile_ = string(argv[optind++]);
     }
     if(optind < argc ||
        ref_ == "NA" ||
-       junctions_.bedFile.empty() ||
-       gtf_.gtffile().empty()) {
+       junctions_file_.empty() ||
+       gtffile_.empty()) {
         usage();
         throw runtime_error("\nError parsing inputs!(2)");
     }
+    if(region_ != "NA" && regions_file_ != "NA") {
+        usage();
+        throw runtime_error("\nUse only one of -r and -R.");
+    }
+    if(regions_file_ != "NA" && junctions_from_alignments()) {
+        usage();
+        throw runtime_error("\n-R is not supported for alignments, use -r.");
+    }
+    if(splice_models_ != "NA") {
+        shared_ptr<SpliceSiteScorer> scorer(new SpliceSiteScorer);
+        scorer->load(splice_models_);
+        splice_scorer_ = scorer;
+    }
     cerr << "\nReference: " << ref_;
-    cerr << "\nGTF: " << gtf_.gtffile();
-    cerr << "\nJunctions: " << junctions_.bedFile;
+    cerr << "\nGTF: " << gtffile_;
+    cerr << "\nJunctions: " << junctions_file_;
     if(skip_single_exon_genes_)
         cerr << "\nSkipping single exon genes.";
+    if(n_threads_ > 1)
+        cerr << "\nThreads: " << n_threads_;
+    if(splice_models_ != "NA")
+        cerr << "\nScoring splice sites with the MaxEntScan models in " <<
+                splice_models_;
+    if(nearest_splice_sites_)
+        cerr << "\nReporting the nearest annotated splice sites.";
+    if(use_packed_reference_)
+        cerr << "\nUsing the packed reference " <<
+                PackedReference::packed_file(ref_);
+    if(region_ != "NA")
+        cerr << "\nRegion: " << region_;
+    if(regions_file_ != "NA")
+        cerr << "\nRegions: " << regions_file_;
     if(output_file_ != "NA")
         cerr << "\nOutput file: " << output_file_;
+    if(output_dir_ != "NA")
+        cerr << "\nOutput directory: " << output_dir_;
+    if(junctions_from_alignments()) {
+        cerr << "\nMinimum junction anchor length: " << min_anchor_length_;
+        cerr << "\nMinimum intron length: " << min_intron_length_;
+        cerr << "\nMaximum intron length: " << max_intron_length_;
+    }
     cerr << endl << endl;
     return 0;
 }
@@ -374,8 +737,41 @@ int JunctionsAnnotator::parse_options(int argc, char *argv[]) {
 //Usage statement for this tool
 int JunctionsAnnotator::usage(ostream& out) {
     out << "\nUsage:\t\t" << "regtools junctions annotate [options] junctions.bed ref.fa annotations.gtf";
+    out << "\n\t\t" << "annotations.gtf can also be a comma separated list of name=file.gtf,"
+                       "\n\t\t" << "each source after the first is reported in its own columns.";
+    out << "\n\t\t" << "junctions.bed can also be a comma separated list of name=file.bed,"
+                       "\n\t\t" << "each distinct junction is annotated once and the output has a"
+                       "\n\t\t" << "sample column. The files are read twice, so \"-\" (stdin)"
+                       "\n\t\t" << "can not be one of them.";
+    out << "\n\t\t" << "junctions.bed can also be indexed alignments, .bam/.cram/.sam,"
+                       "\n\t\t" << "the junctions are extracted as by `junctions extract` and"
+                       "\n\t\t" << "annotated one contig at a time.";
     out << "\nOptions:\t" << "-E include single exon genes";
+    out << "\n\t\t" << "-a INT Minimum anchor length of junctions extracted from alignments. [8]";
+    out << "\n\t\t" << "-d DIR Write one output per junctions file, DIR/name.annotated.tsv";
+    out << "\n\t\t" << "-i INT Minimum intron length of junctions extracted from alignments. [70]";
+    out << "\n\t\t" << "-I INT Maximum intron length of junctions extracted from alignments. [500000]";
+    out << "\n\t\t" << "-n Report the distance from the donor and acceptor to the nearest"
+                       "\n\t\t" << "   annotated donor and acceptor on the same strand,"
+                       "\n\t\t" << "   donor_distance and acceptor_distance, positive if downstream.";
     out << "\n\t\t" << "-o Output file";
+    out << "\n\t\t" << "-r STR Only annotate the junctions that overlap the region,"
+                       " \"chr:start-end\" format.";
+    out << "\n\t\t" << "-R FILE Only annotate the junctions that overlap the regions"
+                       " of a BED file.";
+    out << "\n\t\t" << "   With -r/-R the junctions must be a bgzipped BED indexed"
+                       " with tabix.";
+    out << "\n\t\t" << "-p Read the reference from a 2-bit packed copy, ref.fa.packed."
+                       "\n\t\t" << "   It is built on first use and shared by later runs.";
+    out << "\n\t\t" << "-s DIR Report the MaxEntScan scores of the donor and acceptor"
+                       " of each junction,"
+                       "\n\t\t" << "   donor_score and acceptor_score. DIR is the MaxEntScan"
+                       " directory with me2x5"
+                       "\n\t\t" << "   and splicemodels/.";
+    out << "\n\t\t" << "-t INT Number of threads annotating the junctions,"
+                       " the output order is unchanged. [1]"
+                       "\n\t\t" << "   Only used for a single junctions file, not"
+                       " with several files, -d or alignments.";
     out << "\n";
     return 0;
 }
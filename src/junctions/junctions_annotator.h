@@ -25,30 +25,120 @@ DEALINGS IN THE SOFTWARE.  */
 #ifndef JUNCTIONS_ANNOTATOR_H_
 #define JUNCTIONS_ANNOTATOR_H_
 
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <iterator>
 #include "bedFile.h"
 #include "common.h"
 #include "gtf_parser.h"
 #include "junctions_extractor.h"
+#include "junctions_reader.h"
+#include "packed_reference.h"
+#include "splice_site_scorer.h"
+#include "htslib/faidx.h"
 
 using namespace std;
 
+//A list of IDs. The first kInline IDs are held in the object itself,
+//so a list that stays short, or one that is cleared and reused,
+//does not allocate.
+class IdList {
+    private:
+        static const uint32_t kInline = 8;
+        //The IDs while there are at most kInline
+        uint32_t inline_[kInline];
+        //All the IDs once there are more than kInline
+        vector<uint32_t> overflow_;
+        //Number of IDs
+        uint32_t size_;
+    public:
+        //Constructor
+        IdList() : size_(0) {}
+        //Add an ID
+        void push_back(uint32_t id) {
+            if(size_ < kInline) {
+                inline_[size_++] = id;
+                return;
+            }
+            if(size_ == kInline)
+                overflow_.assign(inline_, inline_ + kInline);
+            overflow_.push_back(id);
+            size_++;
+        }
+        //Remove all the IDs, keeps the memory
+        void clear() {
+            size_ = 0;
+            overflow_.clear();
+        }
+        //Number of IDs
+        size_t size() const { return size_; }
+        //Are there no IDs
+        bool empty() const { return size_ == 0; }
+        //The IDs
+        uint32_t * begin() {
+            return size_ > kInline ? &overflow_[0] : inline_;
+        }
+        uint32_t * end() { return begin() + size_; }
+        const uint32_t * begin() const {
+            return size_ > kInline ? &overflow_[0] : inline_;
+        }
+        const uint32_t * end() const { return begin() + size_; }
+};
+
+//Transcripts that a junction overlaps, as IDs in one contig of an
+//annotation. The IDs are kept in the order they were found and the
+//names are only looked up, sorted and deduplicated when printed.
+struct TranscriptOverlap {
+    //Contig of the transcripts, NULL if there are none
+    const ContigTranscripts *contig;
+    //Transcript IDs in contig, may repeat
+    IdList transcripts;
+    //Constructor
+    TranscriptOverlap() : contig(NULL) {}
+    //Add a transcript
+    void add(const ContigTranscripts &contig1, uint32_t transcript) {
+        contig = &contig1;
+        transcripts.push_back(transcript);
+    }
+    //Remove all the transcripts
+    void clear() {
+        contig = NULL;
+        transcripts.clear();
+    }
+    //Print the genes of the transcripts comma separated, sorted and
+    //without repeats, "NA" if there are none
+    void print_genes(ostream &out) const;
+    //Print the transcripts comma separated, sorted and without
+    //repeats, "NA" if there are none
+    void print_transcripts(ostream &out) const;
+};
+
+//Annotation of a junction against an additional annotation source
+struct SourceAnnotation {
+    //splice site annotation (D/DA/NA etc)
+    string anchor;
+    //Is this a known donor
+    bool known_donor;
+    //Is this a known acceptor
+    bool known_acceptor;
+    //Is this a known junction
+    bool known_junction;
+    //transcripts, and their genes, that the junction overlaps
+    TranscriptOverlap overlap;
+};
+
 //Format of an annotated junction.
 struct AnnotatedJunction : BED {
-    //set of transcripts that
-    //the junction overlaps
-    set<string> transcripts_overlap;
-    //set of genes that
+    //transcripts, and their genes, that
     //the junction overlaps
-    set<string> genes_overlap;
-    //set of exons that the junction
-    //overlaps
-    set<string> exons_skipped;
-    //set of acceptor positions junction overlaps
-    set<CHRPOS> acceptors_skipped;
-    //set of donor positions junction overlaps
-    set<CHRPOS> donors_skipped;
+    TranscriptOverlap overlap;
+    //does the junction skip an annotated exon
+    bool exons_skipped;
+    //number of exon ends the junction overlaps
+    uint32_t acceptors_skipped;
+    //number of exon starts the junction overlaps
+    uint32_t donors_skipped;
     //splice site annotation (D/DA/NA etc)
     string anchor;
     //five prime reference seq
@@ -63,8 +153,38 @@ struct AnnotatedJunction : BED {
     string annotation;
     //Variant related to the junction
     string variant_info;
+    //Annotation against each additional annotation source
+    vector<SourceAnnotation> source_annotations;
+    //Are the splice site strengths reported
+    bool splice_scores;
+    //MaxEntScan score of the donor and of the acceptor, NAN if the
+    //context runs off the contig, has bases other than ACGT or the
+    //strand is not known
+    double donor_score;
+    double acceptor_score;
+    //Are the distances to the nearest annotated splice sites reported
+    bool nearest_sites;
+    //Distance from the donor and from the acceptor to the nearest
+    //annotated donor and acceptor on the same strand, along the
+    //transcript i.e positive if downstream of it, 0 if annotated.
+    //kNoDistance if there is none or the strand is not known.
+    int64_t donor_distance;
+    int64_t acceptor_distance;
+    static const int64_t kNoDistance = INT64_MIN;
+    //Start of the junction including the anchor, the BED start.
+    //Sorted junction BEDs are sorted by this.
+    CHRPOS thick_start;
+    //Sizes of the first and last blocks of the BED12 line, the
+    //anchors on either side of the junction
+    CHRPOS block_size1;
+    CHRPOS block_size2;
     //Print the header line
-    static void print_header(ostream& out = std::cout, bool variant_info_exists = false) {
+    //Each additional annotation source gets its own anchor, known flag,
+    //gene and transcript columns, prefixed with the source name
+    static void print_header(ostream& out = std::cout, bool variant_info_exists = false,
+                             const vector<string> &source_names = vector<string>(),
+                             bool splice_scores = false,
+                             bool nearest_sites = false) {
         out << "chrom" << "\t" << "start" <<
                 "\t" << "end" << "\t" << "name" <<
                 "\t" << "score" << "\t" << "strand" <<
@@ -73,6 +193,19 @@ struct AnnotatedJunction : BED {
                 "\t" << "anchor" <<
                 "\t" << "known_donor" << "\t" << "known_acceptor" << "\t" << "known_junction" <<
                 "\t" << "genes" << "\t" << "transcripts";
+        for(size_t i = 0; i < source_names.size(); i++) {
+            const string &name = source_names[i];
+            out << "\t" << name << "_anchor" <<
+                    "\t" << name << "_known_donor" << "\t" << name << "_known_acceptor" <<
+                    "\t" << name << "_known_junction" <<
+                    "\t" << name << "_genes" << "\t" << name << "_transcripts";
+        }
+        if(splice_scores) {
+            out << "\t" << "donor_score" << "\t" << "acceptor_score";
+        }
+        if(nearest_sites) {
+            out << "\t" << "donor_distance" << "\t" << "acceptor_distance";
+        }
         if(variant_info_exists) {
             out << "\t" << "variant_info";
         }
@@ -83,37 +216,59 @@ struct AnnotatedJunction : BED {
         out << chrom << "\t" << start <<
                 "\t" << end << "\t" << name <<
                 "\t" << score << "\t" << strand <<
-                "\t" << splice_site << "\t" << acceptors_skipped.size() <<
-                "\t" << exons_skipped.size() << "\t" << donors_skipped.size() <<
+                "\t" << splice_site << "\t" << acceptors_skipped <<
+                "\t" << exons_skipped << "\t" << donors_skipped <<
                 "\t" << anchor <<
                 "\t" << known_donor << "\t" << known_acceptor << "\t" << known_junction;
-        //See if any genes overlap the junction
-        if(genes_overlap.size()) {
+        //See if any genes and transcripts overlap the junction
+        out << "\t";
+        overlap.print_genes(out);
+        out << "\t";
+        overlap.print_transcripts(out);
+        for(size_t i = 0; i < source_annotations.size(); i++) {
+            const SourceAnnotation &source = source_annotations[i];
+            out << "\t" << source.anchor <<
+                    "\t" << source.known_donor << "\t" << source.known_acceptor <<
+                    "\t" << source.known_junction << "\t";
+            source.overlap.print_genes(out);
             out << "\t";
-            for(set<string>::iterator it = genes_overlap.begin(); it != genes_overlap.end(); ++it) {
-                if(it != genes_overlap.begin())
-                    out << ",";
-                out << *it;
-            }
-        } else {
-            out << "\t" << "NA";
+            source.overlap.print_transcripts(out);
         }
-        //See if any transcripts overlap the junction
-        if(transcripts_overlap.size()) {
+        if(splice_scores) {
             out << "\t";
-            for(set<string>::iterator it = transcripts_overlap.begin(); it != transcripts_overlap.end(); ++it) {
-                if(it != transcripts_overlap.begin())
-                    out << ",";
-                out << *it;
-            }
-        } else {
-            out << "\t" << "NA";
+            print_splice_score(out, donor_score);
+            out << "\t";
+            print_splice_score(out, acceptor_score);
+        }
+        if(nearest_sites) {
+            out << "\t";
+            print_distance(out, donor_distance);
+            out << "\t";
+            print_distance(out, acceptor_distance);
         }
         if(variant_info_exists) {
             out << "\t" << variant_info;
         }
         out << endl;
     }
+    //Print a splice site score with two decimals like MaxEntScan,
+    //NA if it is NAN
+    static void print_splice_score(ostream &out, double score) {
+        if(std::isnan(score)) {
+            out << "NA";
+            return;
+        }
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "%.2f", score);
+        out.write(buf, n);
+    }
+    //Print a distance, NA if it is kNoDistance
+    static void print_distance(ostream &out, int64_t distance) {
+        if(distance == kNoDistance)
+            out << "NA";
+        else
+            out << distance;
+    }
     //Clear the contents of the junction
     void reset() {
         anchor = string("N");
@@ -122,14 +277,23 @@ struct AnnotatedJunction : BED {
         known_donor = false;
         known_acceptor = false;
         known_junction = false;
-        exons_skipped.clear();
-        acceptors_skipped.clear();
-        donors_skipped.clear();
-        transcripts_overlap.clear();
-        genes_overlap.clear();
+        exons_skipped = false;
+        acceptors_skipped = 0;
+        donors_skipped = 0;
+        overlap.clear();
+        source_annotations.clear();
+        splice_scores = false;
+        donor_score = NAN;
+        acceptor_score = NAN;
+        nearest_sites = false;
+        donor_distance = kNoDistance;
+        acceptor_distance = kNoDistance;
     }
     //constructor
     AnnotatedJunction() {
+        thick_start = 0;
+        block_size1 = 0;
+        block_size2 = 0;
         reset();
     }
     //constructor
@@ -139,6 +303,9 @@ struct AnnotatedJunction : BED {
         chrom = chr1;
         start = start1;
         end = end1;
+        thick_start = start1;
+        block_size1 = 0;
+        block_size2 = 0;
         reset();
     }
     //Constructor
@@ -148,6 +315,9 @@ struct AnnotatedJunction : BED {
         //So we don't have to adjust ends!
         start = j1.start;
         end = j1.end + 1;
+        thick_start = j1.thick_start;
+        block_size1 = j1.start - j1.thick_start;
+        block_size2 = j1.thick_end - j1.end;
         name = j1.name;
         score = j1.score;
         strand = j1.strand;
@@ -166,48 +336,177 @@ inline bool operator<(const AnnotatedJunction& lhs, const AnnotatedJunction& rhs
   return false;
 }
 
+//Bases of the reference around a recent lookup. Sorted junctions are
+//sliced from the window instead of being read one by one, without
+//holding a whole contig per annotator.
+struct ReferenceWindow {
+    //Bases read around each lookup that misses the windows
+    static const CHRPOS kSize = 16384;
+    //Contig of the window, empty until the first read
+    string chrom;
+    //Zero based position of the first base in seq
+    CHRPOS start;
+    string seq;
+    ReferenceWindow() : start(0) {}
+    //Whether the window holds [beg, stop) of chrom, zero based
+    bool contains(const string & chrom1, CHRPOS beg, CHRPOS stop) const {
+        return chrom1 == chrom && beg >= start &&
+               stop <= start + seq.size();
+    }
+};
+
 //The class that does all the annotation
 //Uses a GTF parser object to annotate a junction.
 class JunctionsAnnotator {
     private:
         //Junctions file to be annotated
-        BedFile junctions_;
+        string junctions_file_;
+        //Reads junctions_file_
+        JunctionsReader junctions_;
         //Reference FASTA file
         string ref_;
+        //Index of the reference, loaded on first use
+        faidx_t *fai_;
+        //Bases read around the last two lookups, one window tends to
+        //follow the junction starts and the other the junction ends
+        ReferenceWindow windows_[2];
+        //Window replaced by the next lookup that misses both
+        int next_window_;
+        //Read the bases from a 2-bit packed copy of the reference
+        bool use_packed_reference_;
+        //Packed copy of the reference, mapped on first use
+        PackedReference packed_reference_;
+        //Last contig looked up in the packed reference
+        string packed_chrom_;
+        uint32_t packed_contig_;
         //skip single exon genes
         bool skip_single_exon_genes_;
         //output stream to output file
         ofstream ofs_;
-        //GTF file object
-        GtfParser gtf_;
+        //GTF file
+        string gtffile_;
+        //Loaded annotation, shared with other annotators
+        GtfHandle gtf_;
+        //Annotation sources after the first, reported in their own columns
+        AnnotationSources extra_sources_;
+        //Junction used to annotate against the additional sources
+        AnnotatedJunction source_junction_;
         //File to write output to
         string output_file_;
+        //Number of threads annotating the junctions
+        int n_threads_;
+        //Directory for one output file per junctions file
+        string output_dir_;
+        //Region to annotate, in "chr:start-end" format, NA for all
+        string region_;
+        //BED file of the regions to annotate, NA for all
+        string regions_file_;
+        //MaxEntScan directory of -s, NA to not score the splice sites
+        string splice_models_;
+        //Scores the donor and acceptor of each junction, NULL unless
+        //the splice sites are scored. Shared with other annotators.
+        shared_ptr<const SpliceSiteScorer> splice_scorer_;
+        //Report the distance to the nearest annotated donor and acceptor
+        bool nearest_splice_sites_;
+        //Limits used when the junctions are extracted from alignments,
+        //as in `junctions extract`
+        uint32_t min_anchor_length_;
+        uint32_t min_intron_length_;
+        uint32_t max_intron_length_;
+        //Overlapping transcripts of the current locus, one bit each
+        vector<uint64_t> locus_transcripts_;
+        //Sweeps over the transcripts of the annotation sources, the
+        //first source and then the additional sources
+        vector<TranscriptSweep> sweeps_;
+        //Exon starts and ends skipped in loci that are not regular,
+        //see SpliceLocus
+        vector<CHRPOS> irregular_starts_;
+        vector<CHRPOS> irregular_ends_;
         //Check for overlap between a transcript and junctions
-        //See if the junction we saw is a known junction
-        void check_for_overlap(string transcript_id,
+        //Returns true if the transcript counts towards the junction
+        bool check_for_overlap(const ContigTranscripts & contig,
+                               uint32_t transcript,
                                AnnotatedJunction & junction);
-        //Find overlap for transcripts on the positive strand
-        bool overlap_ps(const vector<BED> & exons,
-                              AnnotatedJunction & j1);
-        //Find overlap for transcripts on the positive strand
-        bool overlap_ns(const vector<BED> & exons,
-                              AnnotatedJunction & j1);
+        //Walk the exons of a positive strand transcript
+        //to find the exons skipped by the junction
+        void overlap_ps(const ExonView & exons,
+                        AnnotatedJunction & j1);
+        //Walk the exons of a negative strand transcript
+        //to find the exons skipped by the junction
+        void overlap_ns(const ExonView & exons,
+                        AnnotatedJunction & j1);
         //Annotate the anchor
         void annotate_anchor(AnnotatedJunction & junction);
+        //Look up the known donor/acceptor/junction flags
+        void annotate_splice_sites(const ContigTranscripts & contig,
+                                   AnnotatedJunction & junction);
+        //Annotate a junction against one annotation
+        void annotate_junction_with_source(const GtfParser & gtf,
+                                           TranscriptSweep & sweep,
+                                           AnnotatedJunction & j1);
+        //Find the annotated donor and acceptor nearest to the junction
+        void annotate_nearest_splice_sites(AnnotatedJunction & junction);
+        //Score the donor and acceptor of a junction
+        void score_splice_site_strength(AnnotatedJunction & line);
+        //Load the reference index if it is not loaded
+        void open_reference();
+        //Get the reference bases in [start, end] from the packed copy
+        string get_packed_sequence(const string & chrom,
+                                   CHRPOS start, CHRPOS end);
+        //Find or read the window holding [beg, stop) of chrom, zero
+        //based, returns NULL if the range is wider than a window
+        const ReferenceWindow * reference_window(const string & chrom,
+                                                 CHRPOS len,
+                                                 CHRPOS beg, CHRPOS stop);
+        //The annotator owns fai_, copies are not allowed
+        JunctionsAnnotator(const JunctionsAnnotator &);
+        JunctionsAnnotator & operator=(const JunctionsAnnotator &);
     public:
         //Default constructor
         JunctionsAnnotator()
             : ref_("NA")
+            , fai_(NULL)
+            , next_window_(0)
+            , use_packed_reference_(false)
+            , packed_contig_(0)
             , skip_single_exon_genes_(true)
             , output_file_("NA")
+            , n_threads_(1)
+            , output_dir_("NA")
+            , region_("NA")
+            , regions_file_("NA")
+            , splice_models_("NA")
+            , nearest_splice_sites_(false)
+            , min_anchor_length_(8)
+            , min_intron_length_(70)
+            , max_intron_length_(500000)
         {}
-        //Default constructor
-        JunctionsAnnotator(string ref1, GtfParser gp1)
+        //Constructor, annotate using an already loaded annotation
+        JunctionsAnnotator(string ref1, GtfHandle gp1)
             : ref_(ref1)
+            , fai_(NULL)
+            , next_window_(0)
+            , use_packed_reference_(false)
+            , packed_contig_(0)
             , skip_single_exon_genes_(true)
+            , gtffile_(gp1->gtffile())
             , gtf_(gp1)
             , output_file_("NA")
+            , n_threads_(1)
+            , output_dir_("NA")
+            , region_("NA")
+            , regions_file_("NA")
+            , splice_models_("NA")
+            , nearest_splice_sites_(false)
+            , min_anchor_length_(8)
+            , min_intron_length_(70)
+            , max_intron_length_(500000)
         {}
+        //Destructor
+        ~JunctionsAnnotator() {
+            if(fai_)
+                fai_destroy(fai_);
+        }
         //Get the GTF file
         string gtf_file();
         //Get ostream object to write output to
@@ -220,9 +519,14 @@ class JunctionsAnnotator {
         int usage(ostream& out = cerr);
         //Get the reference bases at a position
         string get_reference_sequence(string position);
+        //Get the reference bases in [start, end] of chrom, one based.
+        //Sliced from one of the reference windows around recent lookups
+        string get_reference_sequence(const string & chrom,
+                                      CHRPOS start, CHRPOS end);
         //Get a single line from the junctions file
-        bool get_single_junction(BED & line);
-        //Get the anchor bases
+        bool get_single_junction(AnnotatedJunction & line);
+        //Get the anchor bases, and the strength of the splice sites
+        //if they are scored
         void get_splice_site(AnnotatedJunction & line);
         //Open junctions file
         void open_junctions();
@@ -230,14 +534,54 @@ class JunctionsAnnotator {
         void close_junctions();
         //Extract gtf info
         bool load_gtf();
+        //Names of the annotation sources after the first
+        vector<string> extra_source_names() const;
+        //Read the bases from a 2-bit packed copy of the reference
+        void set_use_packed_reference(bool use_packed_reference) {
+            use_packed_reference_ = use_packed_reference;
+        }
+        //Number of threads annotating the junctions
+        int n_threads() const { return n_threads_; }
+        //Score the donor and acceptor of each junction with scorer,
+        //NULL to not score them
+        void set_splice_scorer(shared_ptr<const SpliceSiteScorer> scorer) {
+            splice_scorer_ = scorer;
+        }
+        //Are the donor and acceptor of each junction scored
+        bool score_splice_sites() const { return splice_scorer_ != NULL; }
+        //Report the distance to the nearest annotated donor and acceptor
+        bool nearest_splice_sites() const { return nearest_splice_sites_; }
+        //Junctions file, or comma separated list of name=junctions.bed
+        string junctions_file() const { return junctions_file_; }
+        //Directory for one output file per junctions file, NA if unset
+        string output_dir() const { return output_dir_; }
+        //Regions given with -r/-R, empty to annotate all the junctions
+        vector<JunctionRegion> junction_regions() const;
+        //Are the junctions to be extracted from a BAM/CRAM/SAM file
+        bool junctions_from_alignments() const;
+        //Extractor for the junctions of the alignments, with the
+        //anchor and intron length limits given to this tool
+        JunctionsExtractor alignments_extractor() const {
+            return JunctionsExtractor(junctions_file_,
+                                      region_ != "NA" ? region_ : ".",
+                                      min_anchor_length_,
+                                      min_intron_length_,
+                                      max_intron_length_);
+        }
+        //Annotate with the reference, options and loaded annotation of
+        //another annotator. Scratch space and the FASTA handle are not
+        //shared, so the two can annotate on different threads.
+        void share_annotation(const JunctionsAnnotator &other);
         //Set the GTF parser
-        void set_gtf_parser(GtfParser gp1) {
+        void set_gtf_parser(GtfHandle gp1) {
+            gtffile_ = gp1->gtffile();
             gtf_ = gp1;
         }
         //Annotate with gtf
         void annotate_junction_with_gtf(AnnotatedJunction & j1);
         //Adjust the start and end of the junction
-        void adjust_junction_ends(BED & line);
+        //Keeps the BED start in thick_start
+        void adjust_junction_ends(AnnotatedJunction & line);
 };
 
 #endif
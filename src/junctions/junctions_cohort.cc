@@ -0,0 +1,177 @@
+/*  junctions_cohort.cc -- annotate the junctions of many samples at once
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include "junctions_cohort.h"
+#include "lineFileUtilities.h"
+
+using namespace std;
+
+//Parse a single junctions file or a comma separated list of
+//name=junctions.bed. A spec naming an existing file is always a
+//single sample, so paths with ',' or '=' still work.
+vector<JunctionSample> parse_junction_samples(const string &spec) {
+    vector<JunctionSample> samples;
+    vector<string> entries;
+    bool single_file = common::file_exists(spec);
+    if(single_file)
+        entries.push_back(spec);
+    else
+        Tokenize(spec, entries, ',');
+    set<string> names;
+    for(size_t i = 0; i < entries.size(); i++) {
+        JunctionSample sample;
+        sample.bed = entries[i];
+        size_t eq = entries[i].find('=');
+        if(eq != string::npos && !single_file) {
+            sample.name = entries[i].substr(0, eq);
+            sample.bed = entries[i].substr(eq + 1);
+        } else {
+            size_t slash = sample.bed.rfind('/');
+            sample.name = sample.bed.substr(slash == string::npos ? 0 : slash + 1);
+            sample.name = sample.name.substr(0, sample.name.find('.'));
+        }
+        if(sample.name.empty() ||
+           sample.name.find_first_of("\t/") != string::npos ||
+           !names.insert(sample.name).second) {
+            throw runtime_error("Invalid or repeated sample name \"" +
+                                sample.name + "\"");
+        }
+        samples.push_back(sample);
+    }
+    if(samples.empty()) {
+        throw runtime_error("No junctions file given.");
+    }
+    return samples;
+}
+
+//Collect the distinct junctions of a sample
+void JunctionsCohort::collect(const JunctionSample &sample) {
+    JunctionsReader bed;
+    bed.open(sample.bed, annotator_.junction_regions());
+    AnnotatedJunction line;
+    JunctionKey key;
+    while(bed.next(line)) {
+        annotator_.adjust_junction_ends(line);
+        n_lines_++;
+        key.chrom = line.chrom;
+        key.start = line.start;
+        key.end = line.end;
+        key.strand = line.strand;
+        if(keys_.insert(make_pair(key, (uint32_t) annotated_.size())).second) {
+            AnnotatedJunction junction(line.chrom, line.start, line.end);
+            junction.strand = line.strand;
+            annotated_.push_back(junction);
+        }
+    }
+    bed.close();
+}
+
+//Collect and annotate the distinct junctions of every sample.
+//The junctions are annotated in key order, i.e sorted by contig and
+//start, so the contig cache and the transcript sweep stay on.
+void JunctionsCohort::annotate() {
+    //Every file is read again to print its lines, stdin can only
+    //be read once
+    for(size_t i = 0; i < samples_.size(); i++) {
+        if(samples_[i].bed == "-")
+            throw runtime_error("Junctions can not be read from stdin "
+                                "with several junctions files or -d.");
+    }
+    for(size_t i = 0; i < samples_.size(); i++) {
+        collect(samples_[i]);
+    }
+    for(map<JunctionKey, uint32_t>::const_iterator it = keys_.begin();
+        it != keys_.end(); ++it) {
+        AnnotatedJunction &junction = annotated_[it->second];
+        annotator_.get_splice_site(junction);
+        annotator_.annotate_junction_with_gtf(junction);
+    }
+}
+
+//Print the lines of a sample with their annotation
+int JunctionsCohort::print(const JunctionSample &sample, ostream &out,
+                           bool with_sample) {
+    JunctionsReader bed;
+    bed.open(sample.bed, annotator_.junction_regions());
+    AnnotatedJunction line;
+    JunctionKey key;
+    int linec = 0;
+    while(bed.next(line)) {
+        annotator_.adjust_junction_ends(line);
+        key.chrom = line.chrom;
+        key.start = line.start;
+        key.end = line.end;
+        key.strand = line.strand;
+        map<JunctionKey, uint32_t>::const_iterator it = keys_.find(key);
+        if(it == keys_.end()) {
+            throw runtime_error("Junctions file " + sample.bed +
+                                " changed while it was annotated.");
+        }
+        AnnotatedJunction &junction = annotated_[it->second];
+        junction.name = line.name;
+        junction.score = line.score;
+        if(with_sample)
+            out << sample.name << "\t";
+        junction.print(out);
+        linec++;
+    }
+    bed.close();
+    return linec;
+}
+
+//Print one table with a sample column
+int JunctionsCohort::print_table(ostream &out) {
+    int linec = 0;
+    out << "sample" << "\t";
+    AnnotatedJunction::print_header(out, false,
+                                    annotator_.extra_source_names(),
+                                    annotator_.score_splice_sites(),
+                                    annotator_.nearest_splice_sites());
+    for(size_t i = 0; i < samples_.size(); i++) {
+        linec += print(samples_[i], out, true);
+    }
+    return linec;
+}
+
+//Print one file per sample, dir/<sample>.annotated.tsv
+int JunctionsCohort::print_per_sample(const string &dir) {
+    int linec = 0;
+    for(size_t i = 0; i < samples_.size(); i++) {
+        string file = dir + "/" + samples_[i].name + ".annotated.tsv";
+        ofstream out(file.c_str());
+        if(!out.is_open()) {
+            throw runtime_error("Unable to open " + file);
+        }
+        AnnotatedJunction::print_header(out, false,
+                                        annotator_.extra_source_names(),
+                                        annotator_.score_splice_sites(),
+                                        annotator_.nearest_splice_sites());
+        linec += print(samples_[i], out, false);
+        out.close();
+    }
+    return linec;
+}
@@ -0,0 +1,114 @@
+/*  junctions_cohort.h -- annotate the junctions of many samples at once
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef JUNCTIONS_COHORT_H_
+#define JUNCTIONS_COHORT_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "junctions_annotator.h"
+
+using namespace std;
+
+//A junctions file of one sample
+struct JunctionSample {
+    //Name of the sample, reported in the sample column
+    string name;
+    //BED12 file with the junctions
+    string bed;
+};
+
+//Parse a single junctions file or a comma separated list of
+//name=junctions.bed. Unnamed files are named after the file name up
+//to the first '.'
+vector<JunctionSample> parse_junction_samples(const string &spec);
+
+//What identifies a junction for annotation, the annotation of a
+//junction depends on nothing else
+struct JunctionKey {
+    string chrom;
+    CHRPOS start;
+    CHRPOS end;
+    string strand;
+    //Order by chrom and then start so the distinct junctions are
+    //annotated like a sorted BED
+    bool operator<(const JunctionKey &other) const {
+        if(chrom != other.chrom)
+            return chrom < other.chrom;
+        if(start != other.start)
+            return start < other.start;
+        if(end != other.end)
+            return end < other.end;
+        return strand < other.strand;
+    }
+};
+
+//Annotate the junctions of many samples.
+//The files are read once to collect the distinct junctions, each
+//distinct junction is annotated once, and the files are read again
+//to print every line with the annotation of its junction. The
+//annotation work grows with the number of distinct junctions and
+//not with the number of lines.
+class JunctionsCohort {
+    private:
+        //Annotates the distinct junctions
+        JunctionsAnnotator &annotator_;
+        //The samples, in the order given
+        vector<JunctionSample> samples_;
+        //Distinct junctions to their position in annotated_
+        map<JunctionKey, uint32_t> keys_;
+        //Annotated distinct junctions
+        vector<AnnotatedJunction> annotated_;
+        //Number of lines read from all the files
+        uint64_t n_lines_;
+        //Collect the distinct junctions of a sample
+        void collect(const JunctionSample &sample);
+        //Print the lines of a sample with their annotation, with the
+        //sample name as the first column if with_sample is set
+        int print(const JunctionSample &sample, ostream &out,
+                  bool with_sample);
+    public:
+        //Constructor, annotator has parsed its options and loaded the GTF
+        JunctionsCohort(JunctionsAnnotator &annotator,
+                        const vector<JunctionSample> &samples)
+            : annotator_(annotator)
+            , samples_(samples)
+            , n_lines_(0)
+        {}
+        //Collect and annotate the distinct junctions of every sample
+        void annotate();
+        //Print one table with a sample column, returns the number of
+        //lines printed
+        int print_table(ostream &out);
+        //Print one file per sample, dir/<sample>.annotated.tsv,
+        //returns the number of lines printed
+        int print_per_sample(const string &dir);
+        //Number of distinct junctions
+        size_t n_distinct() const { return annotated_.size(); }
+        //Number of lines read while collecting the junctions
+        uint64_t n_lines() const { return n_lines_; }
+};
+
+#endif
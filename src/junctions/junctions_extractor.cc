@@ -101,10 +101,28 @@ string JunctionsExtractor::get_bam() {
     return bam_;
 }
 
+//Names of the contigs in the header of the alignments, in header order
+vector<string> JunctionsExtractor::contig_names() const {
+    samFile *in = sam_open(bam_.c_str(), "r");
+    if(in == NULL) {
+        throw runtime_error("Unable to open BAM/SAM file.");
+    }
+    bam_hdr_t *header = sam_hdr_read(in);
+    if(header == NULL) {
+        sam_close(in);
+        throw runtime_error("Unable to read the BAM/SAM header.");
+    }
+    vector<string> names(header->target_name,
+                         header->target_name + header->n_targets);
+    bam_hdr_destroy(header);
+    sam_close(in);
+    return names;
+}
+
 //Name the junction based on the number of junctions
 // in the map.
 string JunctionsExtractor::get_new_junction_name() {
-    int index = junctions_.size() + 1;
+    int index = n_named_ + junctions_.size() + 1;
     stringstream name_ss;
     name_ss << "JUNC" << setfill('0') << setw(8) << index;
     return name_ss.str();
@@ -326,6 +344,26 @@ int JunctionsExtractor::parse_alignment_into_junctions(bam_hdr_t *header, bam1_t
 
 //The workhorse - identifies junctions from BAM
 int JunctionsExtractor::identify_junctions_from_BAM() {
+    return identify_junctions_by_contig(ContigJunctionsCallback());
+}
+
+//Pass the sorted junctions of the contig read so far on and clear them
+void JunctionsExtractor::flush_contig(const ContigJunctionsCallback &each_contig) {
+    if(junctions_.empty())
+        return;
+    junctions_vector_.clear();
+    create_junctions_vector();
+    sort_junctions(junctions_vector_);
+    each_contig(junctions_vector_);
+    n_named_ += junctions_.size();
+    junctions_.clear();
+    junctions_vector_.clear();
+}
+
+//Identify the junctions one contig at a time, all at once if
+//each_contig is empty
+int JunctionsExtractor::identify_junctions_by_contig(
+        const ContigJunctionsCallback &each_contig) {
     if(!bam_.empty()) {
         //open BAM for reading
         samFile *in = sam_open(bam_.c_str(), "r");
@@ -350,9 +388,16 @@ int JunctionsExtractor::identify_junctions_from_BAM() {
         }
         //Initiate the alignment record
         bam1_t *aln = bam_init1();
+        int tid = -1;
         while(sam_itr_next(in, iter, aln) >= 0) {
+            if(each_contig && aln->core.tid != tid) {
+                flush_contig(each_contig);
+                tid = aln->core.tid;
+            }
             parse_alignment_into_junctions(header, aln);
         }
+        if(each_contig)
+            flush_contig(each_contig);
         hts_itr_destroy(iter);
         hts_idx_destroy(idx);
         bam_destroy1(aln);
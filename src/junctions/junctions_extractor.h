@@ -26,6 +26,7 @@ DEALINGS IN THE SOFTWARE.  */
 #define JUNCTIONS_EXTRACTOR_H
 
 #include <algorithm>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include "bedFile.h"
@@ -115,11 +116,16 @@ static inline bool compare_junctions(const Junction &j1,
 }
 
 //Sort a vector of junctions
+//Stable, so junctions at the same position stay in the order of the
+//junctions map whether they are sorted per contig or all at once
 template <class CollectionType>
 inline void sort_junctions(CollectionType &junctions) {
-    sort(junctions.begin(), junctions.end(), compare_junctions);
+    stable_sort(junctions.begin(), junctions.end(), compare_junctions);
 }
 
+//Called with the sorted junctions of a contig
+typedef function<void(const vector<Junction> &)> ContigJunctionsCallback;
+
 //The class that deals with creating the junctions
 class JunctionsExtractor {
     private:
@@ -145,6 +151,12 @@ class JunctionsExtractor {
         string output_file_;
         //Region to identify junctions, in "chr:start-end" format
         string region_;
+        //Number of junctions named on contigs that have been passed on
+        //and cleared, the names of later junctions continue from there
+        uint32_t n_named_;
+        //Pass the sorted junctions of the contig read so far on and
+        //clear them
+        void flush_contig(const ContigJunctionsCallback &each_contig);
     public:
         //Default constructor
         JunctionsExtractor() {
@@ -155,6 +167,7 @@ class JunctionsExtractor {
             bam_ = "NA";
             output_file_ = "NA";
             region_ = ".";
+            n_named_ = 0;
         }
         //Default constructor
         JunctionsExtractor(string bam1, string region1) : bam_(bam1), region_(region1) {
@@ -163,6 +176,20 @@ class JunctionsExtractor {
             max_intron_length_ = 500000;
             junctions_sorted_ = false;
             output_file_ = "NA";
+            n_named_ = 0;
+        }
+        //Constructor with the anchor and intron length limits
+        JunctionsExtractor(string bam1, string region1,
+                           uint32_t min_anchor_length,
+                           uint32_t min_intron_length,
+                           uint32_t max_intron_length)
+            : bam_(bam1), region_(region1) {
+            min_anchor_length_ = min_anchor_length;
+            min_intron_length_ = min_intron_length;
+            max_intron_length_ = max_intron_length;
+            junctions_sorted_ = false;
+            output_file_ = "NA";
+            n_named_ = 0;
         }
         //Name the junction based on the number of junctions
         // in the map.
@@ -173,12 +200,21 @@ class JunctionsExtractor {
         int usage(ostream& out = cerr);
         //Identify exon-exon junctions
         int identify_junctions_from_BAM();
+        //Identify exon-exon junctions one contig at a time. Once the
+        //alignments move past a contig, its junctions are sorted,
+        //passed to each_contig and cleared, so only one contig is held
+        //in memory. Junctions are named as in a single pass.
+        int identify_junctions_by_contig(
+                const ContigJunctionsCallback &each_contig);
         //Print all the junctions
         void print_all_junctions(ostream& out = cout);
         //Get a vector of all the junctions
         vector<Junction> get_all_junctions();
         //Get the BAM filename
         string get_bam();
+        //Names of the contigs in the header of the alignments,
+        //in header order
+        vector<string> contig_names() const;
         //Parse the alignment into the junctions map
         int parse_alignment_into_junctions(bam_hdr_t *header, bam1_t *aln);
         //Check if junction satisfies qc
@@ -23,12 +23,16 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.  */
 
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <getopt.h>
 #include <stdexcept>
 #include "common.h"
 #include "gtf_parser.h"
 #include "junctions_annotator.h"
+#include "junctions_cohort.h"
 #include "junctions_extractor.h"
+#include "junctions_pipeline.h"
 
 using namespace std;
 
@@ -60,6 +64,78 @@ int junctions_extract(int argc, char *argv[]) {
     return 0;
 }
 
+//Annotate several junctions files, each distinct junction once
+int junctions_annotate_cohort(JunctionsAnnotator &anno,
+                              const vector<JunctionSample> &samples) {
+    JunctionsCohort cohort(anno, samples);
+    cohort.annotate();
+    int linec;
+    if(anno.output_dir() != "NA") {
+        linec = cohort.print_per_sample(anno.output_dir());
+    } else {
+        ofstream out;
+        anno.set_ofstream_object(out);
+        linec = cohort.print_table(out);
+        anno.close_ofstream();
+    }
+    cerr << endl << "Annotated " << cohort.n_distinct() <<
+            " distinct junctions from " << cohort.n_lines() <<
+            " lines in " << samples.size() << " files.";
+    cerr << endl << "Annotated " << linec << " lines.";
+    return 0;
+}
+
+//Annotate the junctions of alignments as they are extracted,
+//one contig at a time, without writing them out as BED.
+//`junctions extract` prints the contigs sorted by name while the
+//alignments come in header order, so the lines of a contig are held
+//back until no contig further on in the header sorts before it.
+int junctions_annotate_alignments(JunctionsAnnotator &anno, ostream &out) {
+    int linec = 0;
+    JunctionsExtractor extract = anno.alignments_extractor();
+    vector<string> contigs = extract.contig_names();
+    //Smallest name of the contigs from i on in the header
+    vector<string> min_from(contigs.size());
+    for(size_t i = contigs.size(); i-- > 0; ) {
+        min_from[i] = contigs[i];
+        if(i + 1 < contigs.size() && min_from[i + 1] < min_from[i])
+            min_from[i] = min_from[i + 1];
+    }
+    //Annotated lines of the contigs not printed yet, by contig name
+    map<string, string> held;
+    //Header index of the first contig not seen yet
+    size_t next = 0;
+    extract.identify_junctions_by_contig(
+        [&](const vector<Junction> &junctions) {
+            const string &chrom = junctions[0].chrom;
+            ostringstream lines;
+            AnnotatedJunction line;
+            for(size_t i = 0; i < junctions.size(); i++) {
+                const Junction &j1 = junctions[i];
+                //Junctions `junctions extract` would not print
+                if(!j1.has_left_min_anchor || !j1.has_right_min_anchor)
+                    continue;
+                line = AnnotatedJunction(j1);
+                anno.get_splice_site(line);
+                anno.annotate_junction_with_gtf(line);
+                line.print(lines);
+                linec++;
+            }
+            held[chrom] = lines.str();
+            while(next < contigs.size() && contigs[next] != chrom)
+                next++;
+            next++;
+            while(!held.empty() && (next >= contigs.size() ||
+                                    held.begin()->first < min_from[next])) {
+                out << held.begin()->second;
+                held.erase(held.begin());
+            }
+        });
+    for(map<string, string>::iterator it = held.begin(); it != held.end(); it++)
+        out << it->second;
+    return linec;
+}
+
 //Run 'junctions annotate' subcommand
 int junctions_annotate(int argc, char *argv[]) {
     JunctionsAnnotator anno;
@@ -69,17 +145,46 @@ int junctions_annotate(int argc, char *argv[]) {
     ofstream out;
     try {
         anno.parse_options(argc, argv);
+        vector<JunctionSample> samples =
+            parse_junction_samples(anno.junctions_file());
         anno.load_gtf();
+        bool cohort = samples.size() > 1 || anno.output_dir() != "NA";
+        //Only a single junctions file is annotated on several threads
+        if(anno.n_threads() > 1 &&
+           (cohort || anno.junctions_from_alignments())) {
+            cerr << endl << "Warning: -t is only used when annotating a "
+                    "single junctions file, annotating on one thread.";
+        }
+        if(cohort) {
+            return junctions_annotate_cohort(anno, samples);
+        }
+        if(anno.junctions_from_alignments()) {
+            anno.set_ofstream_object(out);
+            line.print_header(out, false, anno.extra_source_names(),
+                              anno.score_splice_sites(),
+                              anno.nearest_splice_sites());
+            linec = junctions_annotate_alignments(anno, out);
+            anno.close_ofstream();
+            cerr << endl << "Annotated " << linec << " lines.";
+            return 0;
+        }
         anno.open_junctions();
         anno.set_ofstream_object(out);
-        line.print_header(out);
-        while(anno.get_single_junction(line)) {
-            anno.adjust_junction_ends(line);
-            anno.get_splice_site(line);
-            anno.annotate_junction_with_gtf(line);
-            line.print(out);
-            line.reset();
-            linec++;
+        line.print_header(out, false, anno.extra_source_names(),
+                              anno.score_splice_sites(),
+                              anno.nearest_splice_sites());
+        if(anno.n_threads() > 1) {
+            JunctionsPipeline pipeline(anno, anno.n_threads());
+            linec = pipeline.run(out);
+        } else {
+            while(anno.get_single_junction(line)) {
+                anno.adjust_junction_ends(line);
+                anno.get_splice_site(line);
+                anno.annotate_junction_with_gtf(line);
+                line.print(out);
+                line.reset();
+                linec++;
+            }
         }
         anno.close_ofstream();
         cerr << endl << "Annotated " << linec << " lines.";
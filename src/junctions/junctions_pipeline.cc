@@ -0,0 +1,176 @@
+/*  junctions_pipeline.cc -- annotate junctions on several threads
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <stdexcept>
+#include <thread>
+#include "junctions_pipeline.h"
+
+using namespace std;
+
+//Constructor, reader has parsed its options and loaded the GTF
+JunctionsPipeline::JunctionsPipeline(JunctionsAnnotator &reader,
+                                     int n_threads, size_t batch_size)
+    : reader_(reader)
+    , batch_size_(batch_size)
+    , n_read_(0)
+    , n_printed_(0)
+    , read_done_(false)
+    , failed_(false) {
+    if(n_threads < 1)
+        n_threads = 1;
+    for(int i = 0; i < n_threads; i++) {
+        workers_.push_back(unique_ptr<JunctionsAnnotator>(
+                               new JunctionsAnnotator()));
+        workers_.back()->share_annotation(reader_);
+    }
+    //Enough batches in flight to keep every worker busy while
+    //the next batch to print is still being annotated
+    max_batches_ = 4 * n_threads;
+}
+
+//Record the first failure and wake every thread
+void JunctionsPipeline::fail(exception_ptr error) {
+    lock_guard<mutex> lock(mutex_);
+    if(!failed_) {
+        failed_ = true;
+        error_ = error;
+    }
+    read_cv_.notify_all();
+    annotated_cv_.notify_all();
+    printed_cv_.notify_all();
+}
+
+//Read the junctions into batches
+void JunctionsPipeline::read() {
+    try {
+        bool more = true;
+        while(more) {
+            unique_ptr<JunctionBatch> batch(new JunctionBatch);
+            batch->junctions.reserve(batch_size_);
+            AnnotatedJunction line;
+            while(batch->junctions.size() < batch_size_) {
+                line.reset();
+                if(!reader_.get_single_junction(line)) {
+                    more = false;
+                    break;
+                }
+                reader_.adjust_junction_ends(line);
+                reader_.get_splice_site(line);
+                batch->junctions.push_back(line);
+            }
+            unique_lock<mutex> lock(mutex_);
+            printed_cv_.wait(lock, [this] {
+                return failed_ || n_read_ - n_printed_ < max_batches_;
+            });
+            if(failed_)
+                return;
+            if(!batch->junctions.empty()) {
+                batch->index = n_read_++;
+                pending_.push_back(move(batch));
+            }
+            if(!more)
+                read_done_ = true;
+            read_cv_.notify_all();
+            annotated_cv_.notify_all();
+        }
+    } catch(...) {
+        fail(current_exception());
+    }
+}
+
+//Annotate batches with one of the workers
+void JunctionsPipeline::annotate(JunctionsAnnotator &worker) {
+    try {
+        while(true) {
+            unique_ptr<JunctionBatch> batch;
+            {
+                unique_lock<mutex> lock(mutex_);
+                read_cv_.wait(lock, [this] {
+                    return failed_ || read_done_ || !pending_.empty();
+                });
+                if(failed_ || pending_.empty())
+                    return;
+                batch = move(pending_.front());
+                pending_.pop_front();
+            }
+            for(size_t i = 0; i < batch->junctions.size(); i++) {
+                worker.annotate_junction_with_gtf(batch->junctions[i]);
+            }
+            lock_guard<mutex> lock(mutex_);
+            uint64_t index = batch->index;
+            annotated_[index] = move(batch);
+            annotated_cv_.notify_all();
+        }
+    } catch(...) {
+        fail(current_exception());
+    }
+}
+
+//Annotate and print every junction, returns the number of
+//junctions annotated. Rethrows the exception of the first
+//thread that fails.
+int JunctionsPipeline::run(ostream &out) {
+    int linec = 0;
+    vector<thread> threads;
+    //Starting a thread or printing can fail too, the threads that
+    //are running are stopped and joined before the error is passed on
+    try {
+        threads.push_back(thread(&JunctionsPipeline::read, this));
+        for(size_t i = 0; i < workers_.size(); i++) {
+            threads.push_back(thread(&JunctionsPipeline::annotate, this,
+                                     ref(*workers_[i])));
+        }
+        while(true) {
+            unique_ptr<JunctionBatch> batch;
+            {
+                unique_lock<mutex> lock(mutex_);
+                annotated_cv_.wait(lock, [this] {
+                    return failed_ || annotated_.count(n_printed_) ||
+                           (read_done_ && n_printed_ == n_read_);
+                });
+                if(failed_ || !annotated_.count(n_printed_))
+                    break;
+                map<uint64_t, unique_ptr<JunctionBatch> >::iterator it =
+                    annotated_.find(n_printed_);
+                batch = move(it->second);
+                annotated_.erase(it);
+            }
+            for(size_t i = 0; i < batch->junctions.size(); i++) {
+                batch->junctions[i].print(out);
+                linec++;
+            }
+            lock_guard<mutex> lock(mutex_);
+            n_printed_++;
+            printed_cv_.notify_all();
+        }
+    } catch(...) {
+        fail(current_exception());
+    }
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    if(failed_)
+        rethrow_exception(error_);
+    return linec;
+}
@@ -0,0 +1,102 @@
+/*  junctions_pipeline.h -- annotate junctions on several threads
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef JUNCTIONS_PIPELINE_H_
+#define JUNCTIONS_PIPELINE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "junctions_annotator.h"
+
+using namespace std;
+
+//Consecutive junctions of the input, annotated together
+struct JunctionBatch {
+    //Position of the batch in the input
+    uint64_t index;
+    //The junctions, in input order
+    vector<AnnotatedJunction> junctions;
+};
+
+//Annotate the junctions file of an annotator on several threads.
+//A reader thread reads the junctions, adjusts their ends and looks up
+//the splice sites, so the reference is only read from one thread.
+//Worker threads annotate batches of junctions against the shared,
+//read-only annotation, each with its own JunctionsAnnotator for
+//scratch space. The calling thread prints the batches in input
+//order, so the output is the same as a serial run.
+class JunctionsPipeline {
+    private:
+        //Reads the junctions and the reference
+        JunctionsAnnotator &reader_;
+        //One annotator per worker, sharing the annotation of reader_
+        vector<unique_ptr<JunctionsAnnotator> > workers_;
+        //Number of junctions per batch
+        size_t batch_size_;
+        //Maximum number of batches read but not printed
+        size_t max_batches_;
+        //Protects everything below
+        mutex mutex_;
+        //Signalled when a batch is read or reading stops
+        condition_variable read_cv_;
+        //Signalled when a batch is annotated or a thread fails
+        condition_variable annotated_cv_;
+        //Signalled when a batch is printed
+        condition_variable printed_cv_;
+        //Batches waiting for a worker
+        deque<unique_ptr<JunctionBatch> > pending_;
+        //Annotated batches waiting to be printed, by index
+        map<uint64_t, unique_ptr<JunctionBatch> > annotated_;
+        //Number of batches read so far
+        uint64_t n_read_;
+        //Number of batches printed so far
+        uint64_t n_printed_;
+        //Has the reader reached the end of the input
+        bool read_done_;
+        //Set when a thread fails, stops every thread
+        bool failed_;
+        //Exception of the first failure, rethrown by run()
+        exception_ptr error_;
+        //Read the junctions into batches
+        void read();
+        //Annotate batches with one of the workers
+        void annotate(JunctionsAnnotator &worker);
+        //Record the first failure and wake every thread
+        void fail(exception_ptr error);
+    public:
+        //Constructor, reader has parsed its options and loaded the GTF
+        JunctionsPipeline(JunctionsAnnotator &reader, int n_threads,
+                          size_t batch_size = 4096);
+        //Annotate and print every junction, returns the number of
+        //junctions annotated. Rethrows the exception of the first
+        //thread that fails.
+        int run(ostream &out);
+};
+
+#endif
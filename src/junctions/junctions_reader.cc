@@ -0,0 +1,375 @@
+/*  junctions_reader.cc -- read BED12 junctions without tokenizing
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "junctions_annotator.h"
+#include "junctions_reader.h"
+#include "lineFileUtilities.h"
+
+using namespace std;
+
+//Size of the read buffer, grows if a line is longer
+static const size_t kBufferSize = 1 << 20;
+
+//Parse an unsigned integer that fills [s, s + length)
+static bool parse_uint(const char *s, size_t length, CHRPOS &value) {
+    if(length == 0)
+        return false;
+    value = 0;
+    for(size_t i = 0; i < length; i++) {
+        unsigned digit = (unsigned char) s[i] - '0';
+        if(digit > 9 || value > (CHRPOS(-1) - digit) / 10)
+            return false;
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
+//Is the line a header or comment line
+static bool is_header(const char *line, size_t length) {
+    return line[0] == '#' ||
+           (length >= 7 && memcmp(line, "browser", 7) == 0) ||
+           (length >= 5 && memcmp(line, "track", 5) == 0);
+}
+
+//Parse a region in "chr", "chr:start" or "chr:start-end" format
+//Like hts_parse_reg, but the coordinates are not cut to an int
+JunctionRegion parse_junction_region(const string &region) {
+    JunctionRegion region1;
+    region1.start = 0;
+    region1.end = INT64_MAX;
+    size_t colon = region.rfind(':');
+    if(colon != string::npos) {
+        char *hyphen;
+        region1.start = max(hts_parse_decimal(region.c_str() + colon + 1,
+                                              &hyphen,
+                                              HTS_PARSE_THOUSANDS_SEP) - 1,
+                            0LL);
+        if(*hyphen == '-')
+            region1.end = hts_parse_decimal(hyphen + 1, NULL,
+                                            HTS_PARSE_THOUSANDS_SEP);
+        else if(*hyphen != '\0')
+            throw runtime_error("Invalid region " + region);
+    }
+    region1.chrom = region.substr(0, colon);
+    if(region1.chrom.empty() || region1.start >= region1.end) {
+        throw runtime_error("Invalid region " + region);
+    }
+    return region1;
+}
+
+//Read the regions of a BED file
+vector<JunctionRegion> read_junction_regions(const string &bed) {
+    ifstream in(bed.c_str());
+    if(!in.is_open()) {
+        throw runtime_error("Unable to open regions file " + bed);
+    }
+    vector<JunctionRegion> regions;
+    string line;
+    vector<string> fields;
+    while(getline(in, line)) {
+        if(line.empty() || is_header(line.c_str(), line.size()))
+            continue;
+        fields.clear();
+        Tokenize(line, fields);
+        if(fields.size() < 3) {
+            throw runtime_error("Regions file " + bed +
+                                " is not BED, line: " + line);
+        }
+        JunctionRegion region;
+        region.chrom = fields[0];
+        region.start = strtoll(fields[1].c_str(), NULL, 10);
+        region.end = strtoll(fields[2].c_str(), NULL, 10);
+        if(region.start < 0 || region.start > region.end) {
+            throw runtime_error("Invalid region in " + bed +
+                                ", line: " + line);
+        }
+        regions.push_back(region);
+    }
+    return regions;
+}
+
+//Open the index of the file and look up the regions
+void JunctionsReader::open_regions(const vector<JunctionRegion> &regions) {
+    tbx_fp_ = hts_open(file_.c_str(), "r");
+    if(tbx_fp_ == NULL) {
+        throw runtime_error("Unable to open junctions file " + file_);
+    }
+    tbx_ = tbx_index_load(file_.c_str());
+    if(tbx_ == NULL) {
+        throw runtime_error("Unable to open the index of " + file_ +
+                            ". Reading regions needs a bgzipped BED"
+                            " indexed with tabix(.tbi/.csi).");
+    }
+    //Sort the regions by contig, in the order of the index, and
+    //merge the overlapping ones, so each contig is read once
+    queries_.clear();
+    for(size_t i = 0; i < regions.size(); i++) {
+        RegionQuery query;
+        query.tid = tbx_name2id(tbx_, regions[i].chrom.c_str());
+        //No junctions on this contig
+        if(query.tid < 0)
+            continue;
+        query.start = regions[i].start;
+        query.end = regions[i].end;
+        queries_.push_back(query);
+    }
+    sort(queries_.begin(), queries_.end());
+    size_t n_merged = 0;
+    for(size_t i = 0; i < queries_.size(); i++) {
+        if(n_merged > 0 &&
+           queries_[n_merged - 1].tid == queries_[i].tid &&
+           queries_[n_merged - 1].end >= queries_[i].start) {
+            queries_[n_merged - 1].end = max(queries_[n_merged - 1].end,
+                                             queries_[i].end);
+        } else {
+            queries_[n_merged++] = queries_[i];
+        }
+    }
+    queries_.resize(n_merged);
+    next_query_ = 0;
+}
+
+//Find the next line that overlaps the regions and does not overlap
+//the region before, so lines are read once
+bool JunctionsReader::next_region_line(const char *&line, size_t &length) {
+    while(true) {
+        if(itr_ == NULL) {
+            if(next_query_ == queries_.size())
+                return false;
+            const RegionQuery &query = queries_[next_query_++];
+            //The index is queried with int coordinates, which
+            //already cover every position a tabix line can hold
+            itr_ = tbx_itr_queryi(tbx_, query.tid,
+                                  (int) min(query.start, (int64_t) INT_MAX),
+                                  (int) min(query.end, (int64_t) INT_MAX));
+            if(itr_ == NULL)
+                continue;
+        }
+        if(tbx_itr_next(tbx_fp_, tbx_, itr_, &tbx_line_) < 0) {
+            tbx_itr_destroy(itr_);
+            itr_ = NULL;
+            continue;
+        }
+        line_num_++;
+        //Read with the region before if it overlaps that too, the
+        //regions are merged so only the one before can overlap
+        size_t query = next_query_ - 1;
+        if(query > 0 && queries_[query - 1].tid == queries_[query].tid &&
+           itr_->curr_beg < queries_[query - 1].end)
+            continue;
+        line = tbx_line_.s;
+        length = tbx_line_.l;
+        return true;
+    }
+}
+
+//Open a junctions file
+void JunctionsReader::open(const string &file,
+                           const vector<JunctionRegion> &regions) {
+    close();
+    file_ = file;
+    line_num_ = 0;
+    if(!regions.empty()) {
+        open_regions(regions);
+        return;
+    }
+    if(file == "-")
+        fp_ = gzdopen(fileno(stdin), "r");
+    else
+        fp_ = gzopen(file.c_str(), "r");
+    if(fp_ == NULL) {
+        throw runtime_error("Unable to open junctions file " + file);
+    }
+    buffer_.resize(kBufferSize);
+    begin_ = 0;
+    end_ = 0;
+    eof_ = false;
+    line_num_ = 0;
+}
+
+//Close the file
+void JunctionsReader::close() {
+    if(fp_ != NULL) {
+        gzclose(fp_);
+        fp_ = NULL;
+    }
+    if(itr_ != NULL) {
+        tbx_itr_destroy(itr_);
+        itr_ = NULL;
+    }
+    if(tbx_ != NULL) {
+        tbx_destroy(tbx_);
+        tbx_ = NULL;
+    }
+    if(tbx_fp_ != NULL) {
+        hts_close(tbx_fp_);
+        tbx_fp_ = NULL;
+    }
+}
+
+//Move the unparsed data to the start of the buffer and read more,
+//returns false at the end of the file
+bool JunctionsReader::fill() {
+    if(begin_ > 0) {
+        memmove(&buffer_[0], &buffer_[begin_], end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    //A line longer than the buffer
+    if(end_ == buffer_.size()) {
+        buffer_.resize(2 * buffer_.size());
+    }
+    int n = gzread(fp_, &buffer_[end_], buffer_.size() - end_);
+    if(n < 0) {
+        throw runtime_error("Unable to read junctions file " + file_);
+    }
+    if(n == 0) {
+        eof_ = true;
+        return false;
+    }
+    end_ += n;
+    return true;
+}
+
+//Find the next line, sets line and length without the newline.
+//Returns false at the end of the file.
+bool JunctionsReader::next_line(const char *&line, size_t &length) {
+    size_t scanned = begin_;
+    while(true) {
+        const char *newline = (const char *) memchr(&buffer_[0] + scanned, '\n',
+                                                    end_ - scanned);
+        if(newline != NULL) {
+            line = &buffer_[begin_];
+            length = newline - line;
+            begin_ += length + 1;
+            break;
+        }
+        if(!eof_) {
+            //fill() moves the unparsed data to the start
+            scanned = end_ - begin_;
+            if(fill())
+                continue;
+        }
+        //Last line without a newline
+        if(begin_ == end_)
+            return false;
+        line = &buffer_[begin_];
+        length = end_ - begin_;
+        begin_ = end_;
+        break;
+    }
+    line_num_++;
+    //ditch \r for Windows
+    if(length > 0 && line[length - 1] == '\r')
+        length--;
+    return true;
+}
+
+//Throw an error about the current line
+void JunctionsReader::error(const string &message) const {
+    stringstream line;
+    line << line_num_;
+    throw runtime_error(message + " Line " + line.str() + " of " + file_);
+}
+
+//Parse a line into junction, false for header, comment and blank lines
+bool JunctionsReader::parse(const char *line, size_t length,
+                            AnnotatedJunction &junction) const {
+    if(length == 0 || is_header(line, length))
+        return false;
+    //Split into the twelve columns
+    const char *fields[12];
+    size_t lengths[12];
+    const char *end = line + length;
+    const char *field = line;
+    int n_fields = 0;
+    while(true) {
+        const char *tab = (const char *) memchr(field, '\t', end - field);
+        const char *field_end = tab != NULL ? tab : end;
+        if(n_fields < 12) {
+            fields[n_fields] = field;
+            lengths[n_fields] = field_end - field;
+        }
+        n_fields++;
+        if(tab == NULL)
+            break;
+        field = tab + 1;
+    }
+    if(n_fields != 12) {
+        error("BED line not in BED12 format.");
+    }
+    if(!parse_uint(fields[1], lengths[1], junction.start) ||
+       !parse_uint(fields[2], lengths[2], junction.end)) {
+        error("Invalid start or end in BED line.");
+    }
+    if(junction.start > junction.end) {
+        error("Start was greater than end in BED line.");
+    }
+    //The first two block sizes, "size1,size2[,]"
+    const char *sizes = fields[10];
+    const char *sizes_end = sizes + lengths[10];
+    const char *comma = (const char *) memchr(sizes, ',', lengths[10]);
+    if(comma == NULL ||
+       !parse_uint(sizes, comma - sizes, junction.block_size1)) {
+        error("BED line not in BED12 format.");
+    }
+    sizes = comma + 1;
+    comma = (const char *) memchr(sizes, ',', sizes_end - sizes);
+    if(!parse_uint(sizes, (comma != NULL ? comma : sizes_end) - sizes,
+                   junction.block_size2)) {
+        error("BED line not in BED12 format.");
+    }
+    junction.chrom.assign(fields[0], lengths[0]);
+    junction.name.assign(fields[3], lengths[3]);
+    junction.score.assign(fields[4], lengths[4]);
+    junction.strand.assign(fields[5], lengths[5]);
+    return true;
+}
+
+//Read the next junction, returns false at the end of the file
+bool JunctionsReader::next(AnnotatedJunction &junction) {
+    const char *line;
+    size_t length;
+    if(tbx_ != NULL) {
+        while(next_region_line(line, length)) {
+            if(parse(line, length, junction))
+                return true;
+        }
+        return false;
+    }
+    while(next_line(line, length)) {
+        if(parse(line, length, junction))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,159 @@
+/*  junctions_reader.h -- read BED12 junctions without tokenizing
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+
+#ifndef JUNCTIONS_READER_H_
+#define JUNCTIONS_READER_H_
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <zlib.h>
+#include "htslib/hts.h"
+#include "htslib/tbx.h"
+
+using namespace std;
+
+struct AnnotatedJunction;
+
+//A region of a contig, zero based and half open
+struct JunctionRegion {
+    string chrom;
+    int64_t start;
+    int64_t end;
+};
+
+//Parse a region in "chr", "chr:start" or "chr:start-end" format,
+//one based and closed like samtools and tabix
+JunctionRegion parse_junction_region(const string &region);
+
+//Read the regions of a BED file
+vector<JunctionRegion> read_junction_regions(const string &bed);
+
+//Read the junctions of a BED12 file.
+//Only the columns the annotation uses are parsed - chrom, start, end,
+//name, score, strand and the first two block sizes - straight out of
+//a large read buffer, without splitting the line into strings. The
+//strings of the junction are assigned in place, so reading into the
+//same junction again does not allocate once it has grown to the
+//longest names. The file is read through zlib, so it may be plain
+//text, gzipped or bgzipped, "-" reads stdin.
+//When regions are given the file must be bgzipped and tabix indexed,
+//and only the lines that overlap the regions are read.
+class JunctionsReader {
+    private:
+        //File being read
+        string file_;
+        //Open file, NULL if none
+        gzFile fp_;
+        //Read buffer
+        vector<char> buffer_;
+        //Start of the unparsed part of the buffer
+        size_t begin_;
+        //End of the data in the buffer
+        size_t end_;
+        //Has the whole file been read into the buffer
+        bool eof_;
+        //Number of lines read
+        uint64_t line_num_;
+        //Tabix indexed file when reading regions, NULL if none
+        htsFile *tbx_fp_;
+        //Tabix index of tbx_fp_
+        tbx_t *tbx_;
+        //Iterator over the current region, NULL between regions
+        hts_itr_t *itr_;
+        //A region to read, by contig ID in the index
+        struct RegionQuery {
+            int tid;
+            int64_t start;
+            int64_t end;
+            bool operator<(const RegionQuery &other) const {
+                if(tid != other.tid)
+                    return tid < other.tid;
+                return start < other.start;
+            }
+        };
+        //Regions to read, sorted and merged
+        vector<RegionQuery> queries_;
+        //Next region to read
+        size_t next_query_;
+        //Line read from the tabix indexed file
+        kstring_t tbx_line_;
+        //Open the index of file and look up the regions
+        void open_regions(const vector<JunctionRegion> &regions);
+        //Find the next line that overlaps the regions and does not
+        //overlap the region before, so lines are read once
+        bool next_region_line(const char *&line, size_t &length);
+        //Move the unparsed data to the start of the buffer and read
+        //more, returns false at the end of the file
+        bool fill();
+        //Find the next line, sets line and length without the newline.
+        //Returns false at the end of the file.
+        bool next_line(const char *&line, size_t &length);
+        //Parse a line into junction, false for header, comment and
+        //blank lines
+        bool parse(const char *line, size_t length,
+                   AnnotatedJunction &junction) const;
+        //Throw an error about the current line
+        void error(const string &message) const;
+        //Copies are not allowed, the object owns the file
+        JunctionsReader(const JunctionsReader &);
+        JunctionsReader & operator=(const JunctionsReader &);
+    public:
+        //Constructor
+        JunctionsReader()
+            : fp_(NULL)
+            , begin_(0)
+            , end_(0)
+            , eof_(false)
+            , line_num_(0)
+            , tbx_fp_(NULL)
+            , tbx_(NULL)
+            , itr_(NULL)
+            , next_query_(0) {
+            tbx_line_.l = tbx_line_.m = 0;
+            tbx_line_.s = NULL;
+        }
+        //Destructor, closes the file
+        ~JunctionsReader() {
+            close();
+            free(tbx_line_.s);
+        }
+        //Open a junctions file, all of it or only the lines that
+        //overlap regions
+        void open(const string &file,
+                  const vector<JunctionRegion> &regions =
+                      vector<JunctionRegion>());
+        //Close the file
+        void close();
+        //Read the next junction, returns false at the end of the file.
+        //Header, comment and blank lines are skipped. Throws
+        //runtime_error if a line is not BED12.
+        bool next(AnnotatedJunction &junction);
+        //Number of lines read so far
+        uint64_t line_num() const { return line_num_; }
+};
+
+#endif
@@ -0,0 +1,335 @@
+/*  packed_reference.cc -- 2-bit packed copy of a reference FASTA
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "common.h"
+#include "packed_reference.h"
+#include "htslib/faidx.h"
+
+using namespace std;
+
+//Magic number at the start of a packed file, bump the
+//version when the layout changes
+static const char PACKED_MAGIC[8] = {'R', 'G', 'T', 'P', 'A', 'C', 'K', '1'};
+
+//Size of the file header, the magic and the number of contigs
+static const uint64_t PACKED_HEADER_SIZE = 16;
+
+//Write size bytes at offset and pad the file to a multiple of 8
+static void write_block(FILE *fp, const void *data, uint64_t size,
+                        uint64_t &offset) {
+    static const char padding[8] = {0};
+    if(size && fwrite(data, 1, size, fp) != size)
+        throw runtime_error("Unable to write the packed reference.");
+    offset += size;
+    uint64_t pad = (8 - offset % 8) % 8;
+    if(pad && fwrite(padding, 1, pad, fp) != pad)
+        throw runtime_error("Unable to write the packed reference.");
+    offset += pad;
+}
+
+//Close the run that is open at pos
+static void close_run(vector<CHRPOS> &ends, bool &open, CHRPOS pos) {
+    if(open) {
+        ends.push_back(pos);
+        open = false;
+    }
+}
+
+//Write runs, the starts followed by the ends
+static uint64_t write_runs(FILE *fp, const vector<CHRPOS> &starts,
+                           const vector<CHRPOS> &ends, uint64_t &offset) {
+    uint64_t runs_offset = offset;
+    uint64_t size = starts.size() * sizeof(CHRPOS);
+    if(size && fwrite(&starts[0], 1, size, fp) != size)
+        throw runtime_error("Unable to write the packed reference.");
+    offset += size;
+    write_block(fp, ends.empty() ? NULL : &ends[0], size, offset);
+    return runs_offset;
+}
+
+//Path of the packed copy of a FASTA
+string PackedReference::packed_file(const string &fasta) {
+    return fasta + ".packed";
+}
+
+//Pack every contig of a FASTA into a file.
+//The file is written under a temporary name and renamed, so another
+//process never maps a half written file.
+void PackedReference::build(const string &fasta, const string &packed) {
+    faidx_t *fai = fai_load(fasta.c_str());
+    if(fai == NULL)
+        throw runtime_error("Unable to load the FASTA index for " + fasta);
+    uint32_t n_contigs = faidx_nseq(fai);
+    vector<PackedContigHeader> headers(n_contigs);
+    string tmp = packed + ".tmp." + common::num_to_str(getpid());
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    if(fp == NULL) {
+        fai_destroy(fai);
+        throw runtime_error("Unable to open " + tmp + " for writing.");
+    }
+    try {
+        uint64_t offset = 0;
+        uint32_t file_header[2] = {n_contigs, 0};
+        if(fwrite(PACKED_MAGIC, 1, sizeof(PACKED_MAGIC), fp) !=
+           sizeof(PACKED_MAGIC))
+            throw runtime_error("Unable to write the packed reference.");
+        offset += sizeof(PACKED_MAGIC);
+        write_block(fp, file_header, sizeof(file_header), offset);
+        //The headers are written again once the offsets are known
+        write_block(fp, headers.empty() ? NULL : &headers[0],
+                    n_contigs * sizeof(PackedContigHeader), offset);
+        for(uint32_t i = 0; i < n_contigs; i++) {
+            const char *name = faidx_iseq(fai, i);
+            int len = 0;
+            char *seq = faidx_fetch_seq(fai, name, 0,
+                                        faidx_seq_len(fai, name) - 1, &len);
+            if(seq == NULL)
+                throw runtime_error("Unable to extract FASTA sequence "
+                                    "for contig " + string(name));
+            if(len < 0)
+                len = 0;
+            vector<unsigned char> bases((len + 3) / 4, 0);
+            vector<CHRPOS> n_starts, n_ends, mask_starts, mask_ends;
+            bool in_n = false, in_mask = false;
+            for(CHRPOS pos = 0; pos < (CHRPOS) len; pos++) {
+                char c = seq[pos];
+                unsigned code = 0;
+                bool is_n = false;
+                switch(toupper(c)) {
+                    case 'A':
+                        code = 0;
+                        break;
+                    case 'C':
+                        code = 1;
+                        break;
+                    case 'G':
+                        code = 2;
+                        break;
+                    case 'T':
+                        code = 3;
+                        break;
+                    default:
+                        is_n = true;
+                        break;
+                }
+                bases[pos >> 2] |= code << (6 - 2 * (pos & 3));
+                if(is_n && !in_n) {
+                    n_starts.push_back(pos);
+                    in_n = true;
+                } else if(!is_n) {
+                    close_run(n_ends, in_n, pos);
+                }
+                bool is_lower = islower(c);
+                if(is_lower && !in_mask) {
+                    mask_starts.push_back(pos);
+                    in_mask = true;
+                } else if(!is_lower) {
+                    close_run(mask_ends, in_mask, pos);
+                }
+            }
+            close_run(n_ends, in_n, len);
+            close_run(mask_ends, in_mask, len);
+            free(seq);
+            PackedContigHeader &header = headers[i];
+            header.name_length = strlen(name);
+            header.length = len;
+            header.n_n_runs = n_starts.size();
+            header.n_mask_runs = mask_starts.size();
+            header.name_offset = offset;
+            write_block(fp, name, header.name_length, offset);
+            header.bases_offset = offset;
+            write_block(fp, bases.empty() ? NULL : &bases[0],
+                        bases.size(), offset);
+            header.n_runs_offset = write_runs(fp, n_starts, n_ends, offset);
+            header.mask_runs_offset = write_runs(fp, mask_starts,
+                                                 mask_ends, offset);
+        }
+        if(fseek(fp, PACKED_HEADER_SIZE, SEEK_SET) != 0 ||
+           (n_contigs && fwrite(&headers[0], sizeof(PackedContigHeader),
+                                n_contigs, fp) != n_contigs))
+            throw runtime_error("Unable to write the packed reference.");
+    } catch(const runtime_error &) {
+        fclose(fp);
+        remove(tmp.c_str());
+        fai_destroy(fai);
+        throw;
+    }
+    fai_destroy(fai);
+    if(fclose(fp) != 0 || rename(tmp.c_str(), packed.c_str()) != 0) {
+        remove(tmp.c_str());
+        throw runtime_error("Unable to write the packed reference " + packed);
+    }
+}
+
+//Map the packed copy of a FASTA, building it first if it is
+//missing or older than the FASTA
+void PackedReference::open(const string &fasta) {
+    string packed = packed_file(fasta);
+    struct stat fasta_stat, packed_stat;
+    if(stat(fasta.c_str(), &fasta_stat) != 0)
+        throw runtime_error("Unable to open " + fasta);
+    if(stat(packed.c_str(), &packed_stat) != 0 ||
+       packed_stat.st_mtime < fasta_stat.st_mtime) {
+        cerr << "\nPacking the reference into " << packed;
+        build(fasta, packed);
+    }
+    open_packed(packed);
+}
+
+//Map a packed file
+void PackedReference::open_packed(const string &packed) {
+    close();
+    int fd = ::open(packed.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw runtime_error("Unable to open " + packed);
+    struct stat packed_stat;
+    if(fstat(fd, &packed_stat) != 0 ||
+       (uint64_t) packed_stat.st_size < PACKED_HEADER_SIZE) {
+        ::close(fd);
+        throw runtime_error("Packed reference " + packed + " is truncated.");
+    }
+    size_t size = packed_stat.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED)
+        throw runtime_error("Unable to map " + packed);
+    data_ = (const char *) data;
+    size_ = size;
+    n_contigs_ = *(const uint32_t *) (data_ + sizeof(PACKED_MAGIC));
+    contigs_ = (const PackedContigHeader *) (data_ + PACKED_HEADER_SIZE);
+    if(memcmp(data_, PACKED_MAGIC, sizeof(PACKED_MAGIC)) != 0 ||
+       PACKED_HEADER_SIZE + (uint64_t) n_contigs_ *
+           sizeof(PackedContigHeader) > size_) {
+        close();
+        throw runtime_error(packed + " is not a packed reference.");
+    }
+    for(uint32_t i = 0; i < n_contigs_; i++) {
+        const PackedContigHeader &header = contigs_[i];
+        uint64_t runs_end = max(
+            header.n_runs_offset + 2 * sizeof(CHRPOS) * header.n_n_runs,
+            header.mask_runs_offset +
+                2 * sizeof(CHRPOS) * header.n_mask_runs);
+        if(header.name_offset + header.name_length > size_ ||
+           header.bases_offset + (header.length + 3) / 4 > size_ ||
+           runs_end > size_) {
+            close();
+            throw runtime_error("Packed reference " + packed +
+                                " is truncated.");
+        }
+        contig_ids_[string(data_ + header.name_offset,
+                           header.name_length)] = i;
+    }
+}
+
+//Unmap the file
+void PackedReference::close() {
+    if(data_ != NULL)
+        munmap((void *) data_, size_);
+    data_ = NULL;
+    size_ = 0;
+    contigs_ = NULL;
+    n_contigs_ = 0;
+    contig_ids_.clear();
+}
+
+//Look up a contig, returns false if it is not in the reference
+bool PackedReference::find_contig(const string &chrom,
+                                  uint32_t &contig) const {
+    map<string, uint32_t>::const_iterator it = contig_ids_.find(chrom);
+    if(it == contig_ids_.end())
+        return false;
+    contig = it->second;
+    return true;
+}
+
+//Is pos inside one of the runs at offset.
+//Runs are sorted and disjoint so the ends are sorted too.
+bool PackedReference::in_runs(uint64_t offset, uint32_t n_runs,
+                              CHRPOS pos) const {
+    const CHRPOS *starts = (const CHRPOS *) (data_ + offset);
+    const CHRPOS *ends = starts + n_runs;
+    const CHRPOS *run = upper_bound(ends, ends + n_runs, pos);
+    return run != ends + n_runs && starts[run - ends] <= pos;
+}
+
+//Overwrite the bases of seq, which starts at start, that are
+//inside one of the runs at offset
+void PackedReference::apply_runs(uint64_t offset, uint32_t n_runs,
+                                 CHRPOS start, string &seq,
+                                 bool lowercase) const {
+    const CHRPOS *starts = (const CHRPOS *) (data_ + offset);
+    const CHRPOS *ends = starts + n_runs;
+    CHRPOS end = start + seq.size();
+    for(uint32_t i = upper_bound(ends, ends + n_runs, start) - ends;
+        i < n_runs && starts[i] < end; i++) {
+        CHRPOS first = max(starts[i], start);
+        CHRPOS last = min(ends[i], end);
+        for(CHRPOS pos = first; pos < last; pos++) {
+            if(lowercase)
+                seq[pos - start] = tolower(seq[pos - start]);
+            else
+                seq[pos - start] = 'N';
+        }
+    }
+}
+
+//Is the base at pos an N
+bool PackedReference::is_n(uint32_t contig, CHRPOS pos) const {
+    const PackedContigHeader &header = contigs_[contig];
+    return in_runs(header.n_runs_offset, header.n_n_runs, pos);
+}
+
+//Is the base at pos soft-masked
+bool PackedReference::is_masked(uint32_t contig, CHRPOS pos) const {
+    const PackedContigHeader &header = contigs_[contig];
+    return in_runs(header.mask_runs_offset, header.n_mask_runs, pos);
+}
+
+//Bases [start, end) of a contig, zero based.
+//Positions past the end of the contig are clipped.
+string PackedReference::sequence(uint32_t contig,
+                                 CHRPOS start, CHRPOS end) const {
+    static const char bases[] = "ACGT";
+    const PackedContigHeader &header = contigs_[contig];
+    end = min(end, (CHRPOS) header.length);
+    if(start >= end)
+        return string();
+    string seq(end - start, 'N');
+    for(CHRPOS pos = start; pos < end; pos++)
+        seq[pos - start] = bases[code(contig, pos)];
+    apply_runs(header.n_runs_offset, header.n_n_runs, start, seq, false);
+    apply_runs(header.mask_runs_offset, header.n_mask_runs, start,
+               seq, true);
+    return seq;
+}
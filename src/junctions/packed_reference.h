@@ -0,0 +1,131 @@
+/*  packed_reference.h -- 2-bit packed copy of a reference FASTA
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef PACKED_REFERENCE_H_
+#define PACKED_REFERENCE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "bedFile.h"
+
+using namespace std;
+
+//Header of one contig in the packed file, offsets are from the
+//start of the file
+struct PackedContigHeader {
+    //Offset of the contig name
+    uint64_t name_offset;
+    //Offset of the bases, four per byte
+    uint64_t bases_offset;
+    //Offset of the N runs, the starts followed by the ends
+    uint64_t n_runs_offset;
+    //Offset of the lowercase runs, the starts followed by the ends
+    uint64_t mask_runs_offset;
+    //Length of the contig name
+    uint32_t name_length;
+    //Number of bases
+    uint32_t length;
+    //Number of N runs
+    uint32_t n_n_runs;
+    //Number of lowercase runs
+    uint32_t n_mask_runs;
+};
+
+//A 2-bit packed copy of a reference FASTA.
+//Each base is stored as A=0, C=1, G=2, T=3 so the complement of a
+//code is code ^ 3. Anything other than ACGT is stored as a run of Ns
+//and soft-masked bases as a run of lowercase, like the UCSC 2bit
+//format. The copy is built once next to the FASTA as <ref>.packed
+//and memory-mapped read only, so processes annotating against the
+//same reference share one copy of the pages. The file is in native
+//byte order.
+class PackedReference {
+    private:
+        //Start of the mapped file
+        const char *data_;
+        //Size of the mapped file
+        size_t size_;
+        //Contig headers, in the mapped file
+        const PackedContigHeader *contigs_;
+        //Number of contigs
+        uint32_t n_contigs_;
+        //Contig name to index in contigs_
+        map<string, uint32_t> contig_ids_;
+        //Is pos inside one of the runs at offset
+        bool in_runs(uint64_t offset, uint32_t n_runs, CHRPOS pos) const;
+        //Overwrite the bases of seq, which starts at start, that are
+        //inside one of the runs at offset
+        void apply_runs(uint64_t offset, uint32_t n_runs, CHRPOS start,
+                        string &seq, bool lowercase) const;
+        //Copies are not allowed, the object owns the mapping
+        PackedReference(const PackedReference &);
+        PackedReference & operator=(const PackedReference &);
+    public:
+        //Constructor
+        PackedReference()
+            : data_(NULL)
+            , size_(0)
+            , contigs_(NULL)
+            , n_contigs_(0)
+        {}
+        //Destructor, unmaps the file
+        ~PackedReference() {
+            close();
+        }
+        //Path of the packed copy of a FASTA
+        static string packed_file(const string &fasta);
+        //Pack every contig of a FASTA into a file
+        static void build(const string &fasta, const string &packed);
+        //Map the packed copy of a FASTA, building it first if it is
+        //missing or older than the FASTA
+        void open(const string &fasta);
+        //Map a packed file
+        void open_packed(const string &packed);
+        //Unmap the file
+        void close();
+        //Is a file mapped
+        bool is_open() const { return data_ != NULL; }
+        //Look up a contig, returns false if it is not in the reference
+        bool find_contig(const string &chrom, uint32_t &contig) const;
+        //Number of bases in a contig
+        CHRPOS length(uint32_t contig) const {
+            return contigs_[contig].length;
+        }
+        //2-bit code of the base at pos, zero based
+        unsigned code(uint32_t contig, CHRPOS pos) const {
+            const unsigned char *bases = (const unsigned char *)
+                (data_ + contigs_[contig].bases_offset);
+            return (bases[pos >> 2] >> (6 - 2 * (pos & 3))) & 3;
+        }
+        //Is the base at pos an N
+        bool is_n(uint32_t contig, CHRPOS pos) const;
+        //Is the base at pos soft-masked
+        bool is_masked(uint32_t contig, CHRPOS pos) const;
+        //Bases [start, end) of a contig, zero based.
+        //Positions past the end of the contig are clipped.
+        string sequence(uint32_t contig, CHRPOS start, CHRPOS end) const;
+};
+
+#endif
@@ -0,0 +1,195 @@
+/*  splice_site_scorer.cc -- score the strength of splice sites
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <stdint.h>
+#include "common.h"
+#include "splice_site_scorer.h"
+
+using namespace std;
+
+//Background and consensus base frequencies of score5.pl and
+//score3.pl, columns are A,C,G,T
+static const double kBackground[4] = {0.27, 0.23, 0.23, 0.27};
+//The G and the T of the donor GT
+static const double kDonorConsensus1[4] = {0.004, 0.0032, 0.9896, 0.0032};
+static const double kDonorConsensus2[4] = {0.0034, 0.0039, 0.0042, 0.9884};
+//The A and the G of the acceptor AG
+static const double kAcceptorConsensus1[4] = {0.9903, 0.0032, 0.0034, 0.0030};
+static const double kAcceptorConsensus2[4] = {0.0027, 0.0037, 0.9905, 0.0030};
+
+//Bases of the acceptor without the AG, scored by the table at the
+//same index: the first base in the 21 bases and the number of bases
+static const int kAcceptorChunks[9][2] = {
+    {0, 7}, {7, 7}, {14, 7}, {4, 7}, {11, 7},
+    {4, 3}, {7, 4}, {11, 3}, {14, 4}
+};
+
+//2-bit code of a base, -1 if it is not ACGT
+static inline int base_code(char base) {
+    switch(base) {
+        case 'A': case 'a': return 0;
+        case 'C': case 'c': return 1;
+        case 'G': case 'g': return 2;
+        case 'T': case 't': return 3;
+        default: return -1;
+    }
+}
+
+//Encode n bases as 2 bits each, the first base in the highest bits.
+//This is hashseq of score3.pl. Returns false if a base is not ACGT.
+static inline bool encode(const char *seq, int n, uint32_t &code) {
+    code = 0;
+    for(int i = 0; i < n; i++) {
+        int base = base_code(seq[i]);
+        if(base < 0)
+            return false;
+        code = (code << 2) | base;
+    }
+    return true;
+}
+
+//log2 as score5.pl and score3.pl compute it
+static inline double log2_perl(double value) {
+    return log(value) / log(2.0);
+}
+
+//Read the lines of a MaxEntScan file
+static vector<string> read_lines(const string &file) {
+    ifstream in(file.c_str());
+    if(!in.is_open()) {
+        throw runtime_error("Unable to open " + file);
+    }
+    vector<string> lines;
+    string line;
+    while(getline(in, line)) {
+        if(!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        lines.push_back(line);
+    }
+    while(!lines.empty() && lines.back().empty())
+        lines.pop_back();
+    return lines;
+}
+
+//Read the first n values of a MaxEntScan table, one per line
+static vector<double> read_table(const string &file, size_t n) {
+    vector<string> lines = read_lines(file);
+    if(lines.size() < n) {
+        throw runtime_error(file + " has fewer than " +
+                            common::num_to_str(n) + " values.");
+    }
+    vector<double> values(n);
+    for(size_t i = 0; i < n; i++) {
+        const char *s = lines[i].c_str();
+        char *end;
+        values[i] = strtod(s, &end);
+        while(*end == ' ' || *end == '\t')
+            end++;
+        if(end == s || *end != '\0') {
+            throw runtime_error("Invalid value \"" + lines[i] +
+                                "\" in " + file);
+        }
+    }
+    return values;
+}
+
+//Load the models from a MaxEntScan directory
+//score5.pl maps the 7 bases to a line of splice5sequences and takes
+//the value on that line of me2x5, the two are joined into one table
+//here. score3.pl indexes its tables by the code of the bases.
+void SpliceSiteScorer::load(const string &dir) {
+    const size_t n_donor = 1 << 14;
+    string sequences_file = dir + "/splicemodels/splice5sequences";
+    vector<string> sequences = read_lines(sequences_file);
+    vector<double> values = read_table(dir + "/me2x5", sequences.size());
+    donor_.assign(n_donor, NAN);
+    for(size_t i = 0; i < sequences.size(); i++) {
+        uint32_t code;
+        if(sequences[i].size() != 7 ||
+           !encode(sequences[i].c_str(), 7, code) ||
+           !std::isnan(donor_[code])) {
+            throw runtime_error("Invalid or repeated sequence \"" +
+                                sequences[i] + "\" in " + sequences_file);
+        }
+        donor_[code] = values[i];
+    }
+    if(sequences.size() != n_donor) {
+        throw runtime_error(sequences_file + " does not list every "
+                            "7 base sequence.");
+    }
+    for(int i = 0; i < 9; i++) {
+        acceptor_[i] = read_table(dir + "/splicemodels/me2x3acc" +
+                                  common::num_to_str(i + 1),
+                                  1 << (2 * kAcceptorChunks[i][1]));
+    }
+}
+
+//Score a donor, exon first
+bool SpliceSiteScorer::score_donor(const char *seq, double &score) const {
+    int g = base_code(seq[kDonorExon]);
+    int t = base_code(seq[kDonorExon + 1]);
+    //The 3 exon bases and the 4 intron bases after the GT
+    uint32_t exon, intron;
+    if(g < 0 || t < 0 ||
+       !encode(seq, kDonorExon, exon) ||
+       !encode(seq + kDonorExon + 2, kDonorIntron - 2, intron))
+        return false;
+    double consensus = kDonorConsensus1[g] * kDonorConsensus2[t] /
+                       (kBackground[g] * kBackground[t]);
+    score = log2_perl(consensus *
+                      donor_[exon << (2 * (kDonorIntron - 2)) | intron]);
+    return true;
+}
+
+//Score an acceptor, intron first
+bool SpliceSiteScorer::score_acceptor(const char *seq, double &score) const {
+    int a = base_code(seq[kAcceptorIntron - 2]);
+    int g = base_code(seq[kAcceptorIntron - 1]);
+    if(a < 0 || g < 0)
+        return false;
+    //The acceptor without the AG
+    char rest[kAcceptorLength - 2];
+    copy(seq, seq + kAcceptorIntron - 2, rest);
+    copy(seq + kAcceptorIntron, seq + kAcceptorLength,
+         rest + kAcceptorIntron - 2);
+    double sc[9];
+    for(int i = 0; i < 9; i++) {
+        uint32_t code;
+        if(!encode(rest + kAcceptorChunks[i][0], kAcceptorChunks[i][1], code))
+            return false;
+        sc[i] = acceptor_[i][code];
+    }
+    double consensus = kAcceptorConsensus1[a] * kAcceptorConsensus2[g] /
+                       (kBackground[a] * kBackground[g]);
+    double maxent = sc[0] * sc[1] * sc[2] * sc[3] * sc[4] /
+                    (sc[5] * sc[6] * sc[7] * sc[8]);
+    score = log2_perl(consensus * maxent);
+    return true;
+}
@@ -0,0 +1,70 @@
+/*  splice_site_scorer.h -- score the strength of splice sites
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+
+#ifndef SPLICE_SITE_SCORER_H_
+#define SPLICE_SITE_SCORER_H_
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//Score the strength of donor(5') and acceptor(3') splice sites with
+//the maximum entropy models of MaxEntScan (Yeo and Burge, 2004).
+//The model tables are read from a MaxEntScan directory and scoring
+//follows score5.pl and score3.pl: the donor is 3 exon and 6 intron
+//bases, the acceptor 20 intron and 3 exon bases, and the score is the
+//log2 of the consensus term times the maximum entropy term, so the
+//same sites get the same scores as the Perl scripts.
+class SpliceSiteScorer {
+    private:
+        //me2x5 value of the 7 donor bases around the GT, by the code
+        //of the 7 bases. score5.pl looks them up through the line
+        //of the 7 bases in splicemodels/splice5sequences.
+        vector<double> donor_;
+        //splicemodels/me2x3acc1-9, indexed by the code of the bases
+        vector<double> acceptor_[9];
+    public:
+        //Bases of exon and of intron in the donor context
+        static const int kDonorExon = 3;
+        static const int kDonorIntron = 6;
+        static const int kDonorLength = kDonorExon + kDonorIntron;
+        //Bases of intron and of exon in the acceptor context
+        static const int kAcceptorIntron = 20;
+        static const int kAcceptorExon = 3;
+        static const int kAcceptorLength = kAcceptorIntron + kAcceptorExon;
+        //Load the models from a MaxEntScan directory, the one with
+        //score5.pl, me2x5 and splicemodels/.
+        //Throws runtime_error if a file is missing or malformed.
+        void load(const string &dir);
+        //Score a donor, kDonorLength bases of its strand, exon first.
+        //Returns false if a base is not ACGT.
+        bool score_donor(const char *seq, double &score) const;
+        //Score an acceptor, kAcceptorLength bases of its strand,
+        //intron first. Returns false if a base is not ACGT.
+        bool score_acceptor(const char *seq, double &score) const;
+};
+
+#endif
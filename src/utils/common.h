@@ -55,30 +55,25 @@ namespace common {
             return num_uint;
     }
 
-    //Reverse complement short DNA seqs
-    inline string rev_comp(string s1) {
-        string rc;
-        for(int i = s1.length() - 1; i >= 0; i--) {
-            char rc_char;
-            switch(s1[i]) {
-                case 'A':
-                    rc_char = 'T';
-                    break;
-                case 'C':
-                    rc_char = 'G';
-                    break;
-                case 'G':
-                    rc_char = 'C';
-                    break;
-                case 'T':
-                    rc_char = 'A';
-                    break;
-                default:
-                    rc_char = 'N';
-                    break;
-            }
-            rc.insert(rc.end(), rc_char);
+    //Complement of every byte, anything other than ACGT is N
+    struct ComplementTable {
+        char bases[256];
+        ComplementTable() {
+            for(int i = 0; i < 256; i++)
+                bases[i] = 'N';
+            bases['A'] = 'T';
+            bases['C'] = 'G';
+            bases['G'] = 'C';
+            bases['T'] = 'A';
         }
+    };
+
+    //Reverse complement short DNA seqs
+    inline string rev_comp(const string &s1) {
+        static const ComplementTable complement;
+        string rc(s1.rbegin(), s1.rend());
+        for(size_t i = 0; i < rc.size(); i++)
+            rc[i] = complement.bases[(unsigned char) rc[i]];
         return rc;
     }
 
@@ -125,13 +120,15 @@ namespace common {
     //Create a region string using chr, start, end
     //this is of the form chr:start-end
     inline std::string create_region_string(const char* chr,
-                                        int start, int end) {
+                                        int64_t start, int64_t end) {
         stringstream ss1;
         ss1 << chr << ":" << start << "-" << end;
         return ss1.str();
     }
 
     //Check if tabix index exists
+    //Either a .tbi or a .csi index is accepted, CSI indexes are
+    //needed for contigs longer than 512Mb
     //Throws runtime_error if index does not exist
     inline bool check_tabix_index(string file) {
         htsFile *fp = hts_open(file.c_str(), "rb");
@@ -139,14 +136,15 @@ namespace common {
             std::cerr << "Unable to open " << file;
             throw runtime_error("Unable to open file.");
         }
-        tbx_t *idx = tbx_index_load(fp->fn);
+        hts_idx_t *idx = hts_idx_load(fp->fn, HTS_FMT_TBI);
         if(!idx) {
             stringstream ss;
-            ss << "Unable to open tabix index for " << file << endl;
+            ss << "Unable to open tabix(.tbi/.csi) index for " << file << endl;
+            hts_close(fp);
             throw runtime_error(ss.str());
         }
         hts_close(fp);
-        tbx_destroy(idx);
+        hts_idx_destroy(idx);
         return true;
     }
 }
@@ -0,0 +1,283 @@
+/*  splice_regions.cc -- index of the splice relevant windows of transcripts
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include "splice_regions.h"
+
+using namespace std;
+
+namespace {
+
+//Positions [start, end] decided by one check of the per exon loop
+//VariantsAnnotator used before the index, now PerExonCheck in
+//tests/lib/variants/test_splice_regions.cc. A check that returns
+//non_splice_region has no region. The bounds are wide enough to hold
+//empty ranges, end < start, at either end of the CHRPOS range.
+struct RegionRule {
+    int64_t start;
+    int64_t end;
+    bool has_region;
+    SpliceRegion region;
+};
+
+//Helper to collect the rules of a transcript in loop order
+class RegionRules {
+    private:
+        uint32_t transcript_;
+        CHRPOS cis_effect_start_;
+        CHRPOS cis_effect_end_;
+    public:
+        vector<RegionRule> rules;
+        RegionRules(uint32_t transcript)
+            : transcript_(transcript)
+            , cis_effect_start_(0)
+            , cis_effect_end_(0)
+        {}
+        //Cis effect limits of the rules added next
+        void set_cis_effect(CHRPOS start, CHRPOS end) {
+            cis_effect_start_ = start;
+            cis_effect_end_ = end;
+        }
+        //Positions that are not in a splice region
+        void add_stop(int64_t start, int64_t end) {
+            RegionRule r1;
+            r1.start = start;
+            r1.end = end;
+            r1.has_region = false;
+            rules.push_back(r1);
+        }
+        //Positions in a splice region
+        void add(int64_t start, int64_t end, SpliceRegionType type,
+                 CHRPOS left, CHRPOS right) {
+            RegionRule r1;
+            r1.start = start;
+            r1.end = end;
+            r1.has_region = true;
+            r1.region.transcript = transcript_;
+            r1.region.type = type;
+            r1.region.left = left;
+            r1.region.right = right;
+            r1.region.cis_effect_start = cis_effect_start_;
+            r1.region.cis_effect_end = cis_effect_end_;
+            rules.push_back(r1);
+        }
+};
+
+const int64_t kMaxPos = numeric_limits<CHRPOS>::max();
+
+//Order transcripts by the start of their first exon in genome
+//order, then by transcript ID
+struct StartOrder {
+    const ContigTranscripts &transcripts;
+    const vector<CHRPOS> &starts;
+    StartOrder(const ContigTranscripts &transcripts1,
+               const vector<CHRPOS> &starts1)
+        : transcripts(transcripts1), starts(starts1) {}
+    bool operator() (uint32_t a, uint32_t b) const {
+        if(starts[a] != starts[b])
+            return starts[a] < starts[b];
+        return transcripts.transcript_name(a) <
+               transcripts.transcript_name(b);
+    }
+};
+
+}
+
+//Add the splice regions of a transcript.
+//The rules follow the checks of the per exon loop, PerExonCheck in
+//the unit tests, one for one, including the
+//CHRPOS arithmetic, and a position belongs to the first rule that
+//covers it, like a variant is decided by the first check it passes.
+void ContigSpliceRegions::add_transcript(uint32_t transcript,
+                                         const SpliceRegionOptions &options) {
+    ExonView exons = transcripts_.exons(transcript);
+    if(exons.size() == 0 ||
+       (options.skip_single_exon_genes && exons.size() == 1)) {
+        return;
+    }
+    size_t last = exons.size() - 1;
+    const CHRPOS emd = options.exonic_min_distance;
+    const CHRPOS imd = options.intronic_min_distance;
+    bool plus = exons.strand() == STRAND_PLUS;
+    RegionRules rules(transcript);
+    //A variant has to be inside the transcript, both in the index
+    //and in the check at the top of the per exon loop
+    int64_t start = max(exons[plus ? 0 : last].start,
+                        min(exons[0].start, exons[last].start));
+    int64_t end = min(exons[plus ? last : 0].end,
+                      max(exons[0].end, exons[last].end));
+    rules.add_stop(0, start - 1);
+    rules.add_stop(end + 1, kMaxPos);
+    for(size_t i = 0; i < exons.size(); i++) {
+        CHRPOS s = exons[i].start, e = exons[i].end;
+        if(plus) {
+            rules.set_cis_effect(exons[i != 0 ? i - 1 : 0].start,
+                                 exons[i != last ? i + 1 : last].end);
+            if(options.all_exonic_space)
+                rules.add(s, e, SPLICE_REGION_EXONIC, s, e);
+            if(options.all_intronic_space && i != last)
+                rules.add((int64_t) e + 1, (int64_t) exons[i + 1].start - 1,
+                          SPLICE_REGION_INTRONIC, e, exons[i + 1].start);
+            //the rest of the exons are outside the junction
+            rules.add_stop(0, (int64_t) (CHRPOS) (s - imd) - 1);
+            if(i != 0) {
+                rules.add(s, min(e, (CHRPOS) (s + emd)),
+                          SPLICE_REGION_SPLICING_EXONIC, s, e);
+                rules.add(max((int64_t) (CHRPOS) (s - imd),
+                              (int64_t) exons[i - 1].end + 1),
+                          (int64_t) s - 1,
+                          SPLICE_REGION_SPLICING_INTRONIC, exons[i - 1].end, s);
+            }
+            if(i != last) {
+                rules.add(max(s, (CHRPOS) (e - emd)), e,
+                          SPLICE_REGION_SPLICING_EXONIC, s, e);
+                rules.add((int64_t) e + 1,
+                          min((int64_t) (CHRPOS) (e + imd),
+                              (int64_t) exons[i + 1].start - 1),
+                          SPLICE_REGION_SPLICING_INTRONIC, e, exons[i + 1].start);
+            }
+        } else {
+            rules.set_cis_effect(exons[i != last ? i + 1 : last].start,
+                                 exons[i != 0 ? i - 1 : 0].end);
+            if(options.all_exonic_space)
+                rules.add(s, e, SPLICE_REGION_EXONIC, s, e);
+            if(options.all_intronic_space && i != last)
+                rules.add((int64_t) exons[i + 1].end + 1, (int64_t) s - 1,
+                          SPLICE_REGION_INTRONIC, exons[i + 1].end, s);
+            //the rest of the exons are outside the junction
+            rules.add_stop((int64_t) (CHRPOS) (e + imd) + 1, kMaxPos);
+            if(i != last) {
+                rules.add(s, min(e, (CHRPOS) (s + emd)),
+                          SPLICE_REGION_SPLICING_EXONIC, s, e);
+                rules.add(max((int64_t) (CHRPOS) (s - imd),
+                              (int64_t) exons[i + 1].end + 1),
+                          (int64_t) s - 1,
+                          SPLICE_REGION_SPLICING_INTRONIC, exons[i + 1].end, s);
+            }
+            if(i != 0) {
+                rules.add(max(s, (CHRPOS) (e - emd)), e,
+                          SPLICE_REGION_SPLICING_EXONIC, s, e);
+                rules.add((int64_t) e + 1,
+                          min((int64_t) (CHRPOS) (e + imd),
+                              (int64_t) exons[i - 1].start - 1),
+                          SPLICE_REGION_SPLICING_INTRONIC, e, exons[i - 1].start);
+            }
+        }
+    }
+    //Positions taken by earlier rules, start to end, merged
+    map<int64_t, int64_t> taken;
+    for(size_t r = 0; r < rules.rules.size(); r++) {
+        const RegionRule &rule = rules.rules[r];
+        if(rule.end < rule.start)
+            continue;
+        //Give the rule the gaps between the positions already taken
+        map<int64_t, int64_t>::iterator it = taken.upper_bound(rule.start);
+        int64_t pos = rule.start;
+        if(it != taken.begin()) {
+            map<int64_t, int64_t>::iterator prev = it;
+            --prev;
+            pos = max(pos, prev->second + 1);
+        }
+        while(pos <= rule.end) {
+            int64_t gap_end = rule.end;
+            if(it != taken.end() && it->first <= rule.end)
+                gap_end = it->first - 1;
+            if(rule.has_region && pos <= gap_end) {
+                index_.add(pos, gap_end, regions_.size());
+                regions_.push_back(rule.region);
+            }
+            if(it == taken.end() || it->first > rule.end)
+                break;
+            pos = it->second + 1;
+            ++it;
+        }
+        //Take the positions of the rule
+        int64_t start = rule.start, end = rule.end;
+        it = taken.upper_bound(start);
+        if(it != taken.begin()) {
+            map<int64_t, int64_t>::iterator prev = it;
+            --prev;
+            if(prev->second + 1 >= start) {
+                start = prev->first;
+                it = prev;
+            }
+        }
+        while(it != taken.end() && it->first <= end + 1) {
+            end = max(end, it->second);
+            taken.erase(it++);
+        }
+        taken[start] = end;
+    }
+}
+
+//Constructor, find the splice regions of every transcript
+ContigSpliceRegions::ContigSpliceRegions(const ContigTranscripts &transcripts,
+                                         const SpliceRegionOptions &options)
+    : transcripts_(transcripts) {
+    vector<CHRPOS> starts(transcripts_.n_transcripts(), 0);
+    vector<uint32_t> order(transcripts_.n_transcripts());
+    for(uint32_t t = 0; t < transcripts_.n_transcripts(); t++) {
+        add_transcript(t, options);
+        ExonView exons = transcripts_.exons(t);
+        if(exons.size() != 0)
+            starts[t] = min(exons[0].start, exons[exons.size() - 1].start);
+        order[t] = t;
+    }
+    index_.build();
+    sort(order.begin(), order.end(), StartOrder(transcripts_, starts));
+    output_rank_.resize(order.size());
+    for(uint32_t i = 0; i < order.size(); i++) {
+        output_rank_[order[i]] = i;
+    }
+}
+
+//Constructor
+SpliceRegionIndex::SpliceRegionIndex(GtfHandle gtf,
+                                     const SpliceRegionOptions &options)
+    : gtf_(gtf)
+    , options_(options)
+    , contigs_(gtf->n_contigs())
+    , contig_built_(new once_flag[gtf->n_contigs()])
+{}
+
+//Index the splice regions of a contig
+void SpliceRegionIndex::build_contig(uint32_t contig) const {
+    const ContigTranscripts *transcripts = gtf_->contig_transcripts(contig);
+    if(transcripts != NULL) {
+        contigs_[contig].reset(new ContigSpliceRegions(*transcripts, options_));
+    }
+}
+
+//Splice regions of a chromosome, NULL if it has no transcripts
+//Concurrent queries of the same contig wait for a single build
+const ContigSpliceRegions * SpliceRegionIndex::contig_regions(const string &chr) const {
+    uint32_t contig;
+    if(!gtf_->find_contig(chr, contig))
+        return NULL;
+    call_once(contig_built_[contig], &SpliceRegionIndex::build_contig,
+              this, contig);
+    return contigs_[contig].get();
+}
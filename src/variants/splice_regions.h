@@ -0,0 +1,170 @@
+/*  splice_regions.h -- index of the splice relevant windows of transcripts
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef SPLICE_REGIONS_H_
+#define SPLICE_REGIONS_H_
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "gtf_parser.h"
+#include "transcript_index.h"
+#include "transcript_store.h"
+
+using namespace std;
+
+//How a variant in a splice region is annotated
+enum SpliceRegionType {
+    //Anywhere in an exon, with -E
+    SPLICE_REGION_EXONIC,
+    //Anywhere in an intron, with -I
+    SPLICE_REGION_INTRONIC,
+    //Within -e of the end of an exon
+    SPLICE_REGION_SPLICING_EXONIC,
+    //Within -i of the end of an exon
+    SPLICE_REGION_SPLICING_INTRONIC
+};
+
+//Annotation string of a SpliceRegionType
+inline const char* splice_region_type_to_str(SpliceRegionType type) {
+    switch(type) {
+        case SPLICE_REGION_EXONIC:
+            return "exonic";
+        case SPLICE_REGION_INTRONIC:
+            return "intronic";
+        case SPLICE_REGION_SPLICING_EXONIC:
+            return "splicing_exonic";
+        default:
+            return "splicing_intronic";
+    }
+}
+
+//The options of `variants annotate` that decide the splice regions
+struct SpliceRegionOptions {
+    //-e, distance from the edge of an exon, exonic side
+    uint32_t exonic_min_distance;
+    //-i, distance from the edge of an exon, intronic side
+    uint32_t intronic_min_distance;
+    //-E
+    bool all_exonic_space;
+    //-I
+    bool all_intronic_space;
+    //Skip single exon transcripts, unless -S
+    bool skip_single_exon_genes;
+};
+
+//Positions of a transcript where a variant gets the same annotation.
+//The distance of a variant at pos is min(pos - left, right - pos),
+//left and right are the exon or intron edges the distance is
+//measured from.
+struct SpliceRegion {
+    //Transcript ID in the contig
+    uint32_t transcript;
+    //Annotation of a variant in the region
+    SpliceRegionType type;
+    //Edges the distance is measured from, one based
+    CHRPOS left;
+    CHRPOS right;
+    //Limits of the cis effect, only for the splicing_ types
+    CHRPOS cis_effect_start;
+    CHRPOS cis_effect_end;
+    //Distance of a variant at pos, one based, in the region
+    CHRPOS distance(CHRPOS pos) const {
+        return min(pos - left, right - pos);
+    }
+    //Does a variant in the region set the cis effect limits
+    bool has_cis_effect() const {
+        return type == SPLICE_REGION_SPLICING_EXONIC ||
+               type == SPLICE_REGION_SPLICING_INTRONIC;
+    }
+};
+
+//The splice regions of the transcripts of one contig.
+//The regions of one transcript do not overlap, so a variant is in
+//at most one region per transcript. The regions are held in an
+//interval index with the region IDs in place of transcript IDs.
+class ContigSpliceRegions {
+    private:
+        //Transcripts of the contig
+        const ContigTranscripts &transcripts_;
+        //Regions, indexed by region ID
+        vector<SpliceRegion> regions_;
+        //Interval index over the regions
+        TranscriptIndex index_;
+        //Place of each transcript in the output order
+        vector<uint32_t> output_rank_;
+        //Add the splice regions of a transcript
+        void add_transcript(uint32_t transcript,
+                            const SpliceRegionOptions &options);
+    public:
+        //Constructor, find the splice regions of every transcript
+        ContigSpliceRegions(const ContigTranscripts &transcripts,
+                            const SpliceRegionOptions &options);
+        //Transcripts of the contig
+        const ContigTranscripts & transcripts() const { return transcripts_; }
+        //Interval index over the regions, the entries are region IDs
+        const TranscriptIndex & index() const { return index_; }
+        //Region with ID i
+        const SpliceRegion & region(uint32_t i) const { return regions_[i]; }
+        //Number of regions
+        size_t size() const { return regions_.size(); }
+        //Place of a transcript in the output order. The transcripts
+        //at a variant print by the start of the transcript, then by
+        //transcript ID.
+        uint32_t output_rank(uint32_t transcript) const {
+            return output_rank_[transcript];
+        }
+};
+
+//The splice regions of every contig of an annotation, for one set
+//of options. A contig is indexed when it is first queried, and
+//concurrent queries of the same contig wait for a single build, so
+//annotators on several threads can share the index.
+class SpliceRegionIndex {
+    private:
+        //The annotation
+        GtfHandle gtf_;
+        //Options the regions are built for
+        SpliceRegionOptions options_;
+        //Regions of each contig, indexed by contig ID
+        mutable vector<unique_ptr<ContigSpliceRegions> > contigs_;
+        //One flag per contig, set once the contig is indexed
+        unique_ptr<once_flag[]> contig_built_;
+        //Index the splice regions of a contig
+        void build_contig(uint32_t contig) const;
+        //Not copyable - share the index through a SpliceRegionHandle
+        SpliceRegionIndex(const SpliceRegionIndex &other);
+        SpliceRegionIndex& operator= (const SpliceRegionIndex &other);
+    public:
+        //Constructor
+        SpliceRegionIndex(GtfHandle gtf, const SpliceRegionOptions &options);
+        //Splice regions of a chromosome, NULL if it has no transcripts
+        const ContigSpliceRegions * contig_regions(const string &chr) const;
+};
+
+//Shared handle to a splice region index
+typedef shared_ptr<const SpliceRegionIndex> SpliceRegionHandle;
+
+#endif
@@ -24,15 +24,23 @@ DEALINGS IN THE SOFTWARE.  */
 
 #include "bedFile.h"
 #include "common.h"
+#include "bgzf.h"
+#include "hfile.h"
 #include "hts.h"
+#include "kseq.h"
 #include "variants_annotator.h"
+#include "variants_pipeline.h"
+#include "variants_shards.h"
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <stdexcept>
 
 //Usage statement for this tool
 int VariantsAnnotator::usage(ostream& out) {
     out << "\nUsage:\t\t" << "regtools variants annotate [options] variants.vcf annotations.gtf";
+    out << "\n\t\t" << "annotations.gtf can also be a comma separated list of name=file.gtf,"
+                       "\n\t\t" << "each source after the first is written to INFO tags suffixed with its name.";
     out << "\n\t\t" << "-e INT\tMaximum distance from the start/end of an exon "
                        "\n\t\t\tto annotate a variant as relevant to splicing, the variant "
                        "\n\t\t\tis in exonic space, i.e a coding variant. [3]";
@@ -41,8 +49,13 @@ int VariantsAnnotator::usage(ostream& out) {
                        "\n\t\t\tis in intronic space. [2]";
     out << "\n\t\t" << "-I\tAnnotate variants in intronic space within a transcript(not to be used with -i).";
     out << "\n\t\t" << "-E\tAnnotate variants in exonic space within a transcript(not to be used with -e).";
-    out << "\n\t\t" << "-o\tFile to write output to. [STDOUT]";
+    out << "\n\t\t" << "-o\tFile to write output to, a name ending in .bcf is written as"
+                       "\n\t\t\tBCF and one ending in .gz as bgzipped VCF. [STDOUT]";
     out << "\n\t\t" << "-S\tDon't skip single exon transcripts.";
+    out << "\n\t\t" << "-t INT\tNumber of threads annotating the variants,"
+                       " the output order is unchanged. [1]"
+                       "\n\t\t\tAn indexed(.tbi/.csi) input written to a .gz/.bcf"
+                       "\n\t\t\tfile is annotated in regions that are joined at the end.";
     out << "\n";
     return 0;
 }
@@ -52,7 +65,7 @@ int VariantsAnnotator::parse_options(int argc, char *argv[]) {
     optind = 1; //Reset before parsing again.
     int16_t c;
     stringstream help_ss;
-    while((c = getopt(argc, argv, "e:Ehi:Io:S")) != -1) {
+    while((c = getopt(argc, argv, "e:Ehi:Io:St:")) != -1) {
         switch(c) {
             case 'i':
                 intronic_min_distance_ = atoi(optarg);
@@ -72,6 +85,11 @@ int VariantsAnnotator::parse_options(int argc, char *argv[]) {
             case 'S':
                 skip_single_exon_genes_ = false;
                 break;
+            case 't':
+                n_threads_ = atoi(optarg);
+                if(n_threads_ < 1)
+                    throw runtime_error("\nNumber of threads must be at least 1.\n");
+                break;
             case 'h':
                 usage(help_ss);
                 throw common::cmdline_help_exception(help_ss.str());
@@ -83,7 +101,6 @@ int VariantsAnnotator::parse_options(int argc, char *argv[]) {
     if(argc - optind >= 2) {
         vcf_ = string(argv[optind++]);
         gtffile_ = string(argv[optind++]);
-        gtf_.set_gtffile(gtffile_);
     }
     if(optind < argc ||
        vcf_ == "NA" ||
@@ -102,6 +119,8 @@ int VariantsAnnotator::parse_options(int argc, char *argv[]) {
     }
     if(!skip_single_exon_genes_)
         cerr << "\nNot skipping single exon genes.";
+    if(n_threads_ > 1)
+        cerr << "\nThreads: " << n_threads_;
     if(vcf_out_ != "NA")
         cerr << "\nOutput file: " << vcf_out_;
     cerr << endl;
@@ -110,7 +129,55 @@ int VariantsAnnotator::parse_options(int argc, char *argv[]) {
 
 //Read gtf info into gtf_
 void VariantsAnnotator::load_gtf() {
-    gtf_.load();
+    if(!gtf_) {
+        AnnotationSources sources = load_annotation_sources(gtffile_);
+        gtf_ = sources[0].gtf;
+        extra_sources_.assign(sources.begin() + 1, sources.end());
+    }
+}
+
+//Options that decide the splice regions
+SpliceRegionOptions VariantsAnnotator::splice_region_options() const {
+    SpliceRegionOptions options;
+    options.exonic_min_distance = exonic_min_distance_;
+    options.intronic_min_distance = intronic_min_distance_;
+    options.all_exonic_space = all_exonic_space_;
+    options.all_intronic_space = all_intronic_space_;
+    options.skip_single_exon_genes = skip_single_exon_genes_;
+    return options;
+}
+
+//Set up the splice region index of each annotation source
+//The contigs are indexed when they are first annotated
+void VariantsAnnotator::load_splice_regions() {
+    if(!splice_regions_.empty())
+        return;
+    SpliceRegionOptions options = splice_region_options();
+    splice_regions_.push_back(SpliceRegionHandle(
+                                  new SpliceRegionIndex(gtf_, options)));
+    for(size_t i = 0; i < extra_sources_.size(); i++) {
+        splice_regions_.push_back(SpliceRegionHandle(
+                    new SpliceRegionIndex(extra_sources_[i].gtf, options)));
+        const string &name = extra_sources_[i].name;
+        source_info_tags_.push_back("genes_" + name);
+        source_info_tags_.push_back("transcripts_" + name);
+        source_info_tags_.push_back("distances_" + name);
+        source_info_tags_.push_back("annotations_" + name);
+    }
+}
+
+//Annotate with the options and loaded annotation of another annotator
+void VariantsAnnotator::share_annotation(const VariantsAnnotator &other) {
+    gtffile_ = other.gtffile_;
+    gtf_ = other.gtf_;
+    extra_sources_ = other.extra_sources_;
+    splice_regions_ = other.splice_regions_;
+    source_info_tags_ = other.source_info_tags_;
+    all_intronic_space_ = other.all_intronic_space_;
+    all_exonic_space_ = other.all_exonic_space_;
+    intronic_min_distance_ = other.intronic_min_distance_;
+    exonic_min_distance_ = other.exonic_min_distance_;
+    skip_single_exon_genes_ = other.skip_single_exon_genes_;
 }
 
 //Open input VCF file
@@ -125,13 +192,33 @@ void VariantsAnnotator::open_vcf_in() {
     }
 }
 
+//htslib mode to open the output VCF with. Outputs ending in .bcf
+//are written as BCF and outputs ending in .gz as bgzipped VCF
+const char * VariantsAnnotator::vcf_out_mode() const {
+    size_t dot = vcf_out_.rfind('.');
+    string extension = dot == string::npos ? "" : vcf_out_.substr(dot);
+    if(extension == ".bcf")
+        return "wb";
+    if(extension == ".gz")
+        return "wz";
+    return "w";
+}
+
 //Open output VCF file
 void VariantsAnnotator::open_vcf_out() {
     vcf_fh_out_ =  hts_open(vcf_out_ == "NA" ? "-" : vcf_out_.c_str(),
-                            "w");
+                            vcf_out_mode());
     if(vcf_fh_out_ == NULL) {
         throw runtime_error("Unable to open output VCF file");
     }
+    create_header_out();
+    bcf_hdr_write(vcf_fh_out_, vcf_header_out_);
+}
+
+//Create the header of the output VCF
+void VariantsAnnotator::create_header_out() {
+    if(vcf_header_out_)
+        return;
     vcf_header_out_ = bcf_hdr_dup(vcf_header_in_);
     bcf_hdr_append(vcf_header_out_,
                    "##INFO=<ID=genes,Number=1,Type=String,"
@@ -148,8 +235,34 @@ void VariantsAnnotator::open_vcf_out() {
                    "##INFO=<ID=annotations,Number=1,Type=String,"
                    "Description=\"Does the variant fall in exonic/intronic splicing "
                    "related space in the transcript.\"");
+    for(size_t i = 0; i < extra_sources_.size(); i++) {
+        const string &name = extra_sources_[i].name;
+        string info_lines[] = {
+            "##INFO=<ID=genes_" + name + ",Number=1,Type=String,"
+            "Description=\"The Variant falls in the splice region of "
+            "these " + name + " genes\">",
+            "##INFO=<ID=transcripts_" + name + ",Number=1,Type=String,"
+            "Description=\"The Variant falls in the splice region of "
+            "these " + name + " transcripts\">",
+            "##INFO=<ID=distances_" + name + ",Number=1,Type=String,"
+            "Description=\"Vector of Min(Distance from start/end of exon "
+            "in the " + name + " transcript.)\">",
+            "##INFO=<ID=annotations_" + name + ",Number=1,Type=String,"
+            "Description=\"Does the variant fall in exonic/intronic splicing "
+            "related space in the " + name + " transcript.\">"
+        };
+        for(size_t j = 0; j < 4; j++) {
+            bcf_hdr_append(vcf_header_out_, info_lines[j].c_str());
+        }
+    }
     bcf_hdr_sync(vcf_header_out_);
-    bcf_hdr_write(vcf_fh_out_, vcf_header_out_);
+    //The annotation only touches INFO, so the FORMAT and sample
+    //columns of a VCF written as text are copied from the input line.
+    //BCF output needs them encoded, and BCF input passes them
+    //through without decoding them already.
+    copy_samples_ = vcf_fh_in_->format.format == ::vcf &&
+                    string(vcf_out_mode()) != "wb" &&
+                    bcf_hdr_nsamples(vcf_header_in_) > 0;
 }
 
 //Free relevant pointers
@@ -166,362 +279,317 @@ void VariantsAnnotator::cleanup() {
         bcf_destroy(vcf_record_);
 }
 
-//Set limits on + strand
-inline
-void VariantsAnnotator::set_variant_cis_effect_limits_ps(const vector<BED>& exons,
-                                                      AnnotatedVariant& variant,
-                                                      uint32_t i) {
-    //Check if the cis effect limits have increased.
-    if(i != 0) {
-        if(exons[i-1].start < variant.cis_effect_start) {
-            variant.cis_effect_start = exons[i-1].start;
-        }
-    } else {
-        if(exons[0].start < variant.cis_effect_start) {
-            variant.cis_effect_start = exons[0].start;
-        }
-    }
-    if(i != exons.size() - 1) {
-        if(exons[i+1].end > variant.cis_effect_end) {
-            variant.cis_effect_end = exons[i+1].end;
-        }
-    } else {
-        if(exons[exons.size() - 1].end > variant.cis_effect_end) {
-            variant.cis_effect_end = exons[exons.size() - 1].end;
-        }
+//Order splice regions by the output rank of their transcript
+struct RegionOutputOrder {
+    const ContigSpliceRegions &contig;
+    RegionOutputOrder(const ContigSpliceRegions &contig1) : contig(contig1) {}
+    bool operator() (uint32_t a, uint32_t b) const {
+        return contig.output_rank(contig.region(a).transcript) <
+               contig.output_rank(contig.region(b).transcript);
     }
-    return;
+};
+
+//Append n in decimal, common::num_to_str goes through a stringstream
+static void append_number(string &out, uint64_t n) {
+    char digits[20];
+    int n_digits = 0;
+    do {
+        digits[n_digits++] = '0' + n % 10;
+        n /= 10;
+    } while(n);
+    while(n_digits)
+        out += digits[--n_digits];
 }
 
-//Set limits on - strand
-inline
-void VariantsAnnotator::set_variant_cis_effect_limits_ns(const vector<BED>& exons,
-                                                      AnnotatedVariant& variant,
-                                                      uint32_t i) {
-    if(i != 0) {
-        //Check if the cis effect limits have increased.
-        if(exons[i-1].end > variant.cis_effect_end) {
-            variant.cis_effect_end = exons[i-1].end;
-        }
-    } else {
-        if(exons[0].end > variant.cis_effect_end) {
-            variant.cis_effect_end = exons[0].end;
-        }
+//Write the hits as the comma separated values of the INFO tags,
+//"NA" when there are none. A gene is listed once, at its first
+//transcript. The strings are assigned in place so they keep their
+//buffers from the previous variant.
+static void format_hits(const ContigSpliceRegions *contig,
+                        const vector<SpliceRegionHit> &hits,
+                        string &genes, string &transcript_ids,
+                        string &distances, string &annotations) {
+    if(hits.empty()) {
+        genes = non_splice_region_annotation_string;
+        transcript_ids = non_splice_region_annotation_string;
+        distances = non_splice_region_annotation_string;
+        annotations = non_splice_region_annotation_string;
+        return;
     }
-    if(i != exons.size() -1) {
-        if(exons[i+1].start < variant.cis_effect_start) {
-            variant.cis_effect_start = exons[i+1].start;
+    const ContigTranscripts &transcripts = contig->transcripts();
+    genes.clear();
+    transcript_ids.clear();
+    distances.clear();
+    annotations.clear();
+    for(size_t i = 0; i < hits.size(); i++) {
+        const SpliceRegionHit &hit = hits[i];
+        if(i) {
+            transcript_ids += ',';
+            distances += ',';
+            annotations += ',';
         }
-    } else {
-        if(exons[exons.size() - 1].start < variant.cis_effect_start) {
-            variant.cis_effect_start = exons[exons.size() - 1].start;
+        transcript_ids += transcripts.transcript_name(hit.transcript);
+        append_number(distances, hit.distance);
+        annotations += splice_region_type_to_str(hit.type);
+        //A variant hits a handful of transcripts, a scan of the
+        //earlier hits is cheaper than a set of the genes
+        size_t k = 0;
+        while(k < i && hits[k].gene != hit.gene)
+            k++;
+        if(k == i) {
+            if(i)
+                genes += ',';
+            genes += transcripts.gene_name_by_id(hit.gene);
         }
     }
-    return;
 }
 
-//Get the coordinates which limit the effect of this variant.
-//The cis-splice-effects command uses these fields to pull out
-//junctions which might be related to the presence of this variant.
-//This is set to the nearest acceptor and donor of the neigboring
-//exons. The calculation will vary according to the strand of this
-//transcript.
-inline
-void VariantsAnnotator::set_variant_cis_effect_limits(const vector<BED>& exons,
-                                                      AnnotatedVariant& variant,
-                                                      uint32_t i) {
-    string transcript_strand = exons[0].strand;
-    if(transcript_strand == "+") {
-        set_variant_cis_effect_limits_ps(exons, variant, i);
-        return;
-    }
-    if(transcript_strand == "-") {
-        set_variant_cis_effect_limits_ns(exons, variant, i);
-        return;
-    }
+//Annotate one line of a VCF
+//The line to be annotated is in vcf_record_
+//The primary annotation fills in the variant, each additional
+//source is annotated separately into its own SourceVariantAnnotation
+AnnotatedVariant VariantsAnnotator::annotate_record_with_transcripts() {
+    return annotate_position(record_chrom(vcf_record_), vcf_record_->pos);
 }
 
-//Overlap splice region in the negative strand
-void VariantsAnnotator::get_variant_overlaps_spliceregion_ns(const vector<BED>& exons,
-                                                      AnnotatedVariant& variant) {
-    variant.score = "-1";
-    variant.annotation = "non_splice_region";
-    //check if variant inside transcript coords for negative strand
-    if(exons[exons.size() - 1].start > variant.end ||
-       exons[0].end < variant.end) {
-        return;
-    }
-    for(uint32_t i = 0; i < exons.size(); i++) {
-        if(all_exonic_space_) {
-            //The exon start and end are in 1-based
-            if(variant.end >= exons[i].start && variant.end <= exons[i].end) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
-                                                        exons[i].end - variant.end));
-                variant.annotation = "exonic";
-                return;
-            }
-        }
-        if(all_intronic_space_) {
-            //The exon start and end are in 1-based
-            if(i != exons.size() - 1 && variant.end < exons[i].start && variant.end > exons[i+1].end) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i+1].end,
-                                                        exons[i].start - variant.end));
-                variant.annotation = "intronic";
-                return;
-            }
-        }
-        {
-            //the rest of the exons are outside the junction - ns
-            if(exons[i].end + intronic_min_distance_ < variant.end) {
-                return;
-            }
-            //exonic near start and not last exon
-            if(i != exons.size() - 1 && variant.end >= exons[i].start &&
-               variant.end <= exons[i].end &&
-               variant.end <= exons[i].start + exonic_min_distance_) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
-                                                        exons[i].end - variant.end));
-                variant.annotation = "splicing_exonic";
-                set_variant_cis_effect_limits(exons, variant, i);
-                return;
-            }
-            //intronic near start (make sure not first/last exon.)
-            //make sure this isn't exonic in next exon
-            if(variant.end < exons[i].start &&
-            variant.end >= exons[i].start - intronic_min_distance_ &&
-            i != exons.size() - 1 && variant.end > exons[i+1].end) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i+1].end,
-                                                        exons[i].start - variant.end));
-                variant.annotation = "splicing_intronic";
-                set_variant_cis_effect_limits(exons, variant, i);
-                return;
-            }
-            //exonic near end and not first exon
-            if(i != 0 &&
-               variant.end <= exons[i].end &&
-               variant.end >= exons[i].start &&
-               variant.end >= exons[i].end - exonic_min_distance_) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
-                                                        exons[i].end - variant.end));
-                variant.annotation = "splicing_exonic";
-                set_variant_cis_effect_limits(exons, variant, i);
-                return;
-            }
-            //intronic near end (make sure not first/last exon.)
-            //make sure this isn't exonic in prev exon
-            if(variant.end > exons[i].end &&
-            variant.end <= exons[i].end + intronic_min_distance_ &&
-            i != 0 && variant.end < exons[i-1].start) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].end,
-                                                        exons[i-1].start - variant.end));
-                variant.annotation = "splicing_intronic";
-                set_variant_cis_effect_limits(exons, variant, i);
-                return;
-            }
-        }
-    }
-    return;
+//Annotate the line in vcf_record_ into variant
+void VariantsAnnotator::annotate_record_with_transcripts(AnnotatedVariant &variant) {
+    annotate_position(record_chrom(vcf_record_), vcf_record_->pos, variant);
 }
 
-//Overlap splice region in the positive strand
-void VariantsAnnotator::get_variant_overlaps_spliceregion_ps(const vector<BED>& exons,
-                                                             AnnotatedVariant& variant) {
+//Annotate a variant at pos, zero based, of chrom
+AnnotatedVariant VariantsAnnotator::annotate_position(const string &chrom,
+                                                      CHRPOS pos) {
+    AnnotatedVariant variant;
+    annotate_position(chrom, pos, variant);
+    return variant;
+}
+
+//Annotate a variant at pos, zero based, of chrom into variant
+void VariantsAnnotator::annotate_position(const string &chrom, CHRPOS pos,
+                                          AnnotatedVariant &variant) {
+    variant.chrom = chrom;
+    variant.start = pos;
+    variant.end = pos + 1;
     variant.score = "-1";
-    variant.annotation = "non_splice_region";
-    //check if variant inside transcript coords for positive strand
-    if(exons[0].start > variant.end ||
-       exons[exons.size() - 1].end < variant.end) {
-        return;
-    }
-    for(uint32_t i = 0; i < exons.size(); i++) {
-        if(all_exonic_space_) {
-            //The exon start and end are in 1-based
-            if(variant.end >= exons[i].start &&
-               variant.end <= exons[i].end) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
-                                                        exons[i].end - variant.end));
-                variant.annotation = "exonic";
-                return;
-            }
-        }
-        if(all_intronic_space_) {
-            //The exon start and end are in 1-based
-            if(i != exons.size() - 1 &&
-               variant.end > exons[i].end && variant.end < exons[i+1].start) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].end,
-                                                        exons[i+1].start - variant.end));
-                variant.annotation = "intronic";
-                return;
-            }
-        }
-        {
-            //the rest of the exons are outside the junction - ps
-            if(exons[i].start - intronic_min_distance_ > variant.end) {
-                return;
-            }
-            //exonic near start and not first exon
-            if(i != 0 &&
-               variant.end >= exons[i].start &&
-               variant.end <= exons[i].end &&
-               variant.end <= exons[i].start + exonic_min_distance_) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
-                                                        exons[i].end - variant.end));
-                variant.annotation = "splicing_exonic";
-                set_variant_cis_effect_limits(exons, variant, i);
-                return;
-            }
-            //intronic near start (make sure not first/last exon.)
-            //make sure this isn't exonic in prev exon
-            if(variant.end < exons[i].start &&
-            variant.end >= exons[i].start - intronic_min_distance_ &&
-            i != 0 && variant.end > exons[i-1].end) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i-1].end,
-                                                        exons[i].start - variant.end));
-                variant.annotation = "splicing_intronic";
-                set_variant_cis_effect_limits(exons, variant, i);
-                return;
-            }
-            //exonic near end
-            if(i != exons.size() - 1 &&
-               variant.end <= exons[i].end &&
-               variant.end >= exons[i].start &&
-               variant.end >= exons[i].end - exonic_min_distance_) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
-                                                        exons[i].end - variant.end));
-                variant.annotation = "splicing_exonic";
-                set_variant_cis_effect_limits(exons, variant, i);
-                return;
-            }
-            //intronic near end (make sure not first/last exon.)
-            //make sure this isn't exonic in next exon
-            if(variant.end > exons[i].end &&
-            variant.end <= exons[i].end + intronic_min_distance_ &&
-            i != exons.size() - 1 && variant.end < exons[i+1].start) {
-                variant.score =  common::num_to_str(min(variant.end - exons[i].end,
-                                                        exons[i+1].start - variant.end));
-                variant.annotation = "splicing_intronic";
-                set_variant_cis_effect_limits(exons, variant, i);
-                return;
-            }
-        }
+    variant.cis_effect_start = std::numeric_limits<unsigned int>::max();
+    variant.cis_effect_end = 0;
+    load_splice_regions();
+    sweeps_.resize(splice_regions_.size());
+    annotate_record_with_source(*splice_regions_[0], sweeps_[0], variant);
+    variant.source_annotations.resize(extra_sources_.size());
+    for(size_t i = 0; i < extra_sources_.size(); i++) {
+        SourceVariantAnnotation &source = variant.source_annotations[i];
+        const ContigSpliceRegions *contig =
+            collect_hits(*splice_regions_[i + 1], sweeps_[i + 1],
+                         variant.chrom, variant.end);
+        format_hits(contig, hits_, source.overlapping_genes,
+                    source.overlapping_transcripts,
+                    source.overlapping_distances, source.annotation);
     }
-    return;
 }
 
-//Given a transcript ID and variant position,
-//check if the variant is in a splice relevant region
-//relevance depends on the user params
-//intronic_min_distance_ and exonic_min_distance_
-//The zero-based arithmetic is always fun.
-//The variant object is one-based.
-//GTF i.e the exon is one based
-void VariantsAnnotator::get_variant_overlaps_spliceregion(const vector<BED>& exons,
-                                                      AnnotatedVariant& variant) {
-    string transcript_strand = exons[0].strand;
-    if(transcript_strand == "+") {
-        get_variant_overlaps_spliceregion_ps(exons, variant);
-    } else if (transcript_strand == "-") {
-        get_variant_overlaps_spliceregion_ns(exons, variant);
+//Collect the splice regions of one annotation at pos into hits_.
+//The regions at the variant come from the sweep while the variants
+//are sorted, and from the index lookup otherwise
+const ContigSpliceRegions * VariantsAnnotator::collect_hits(const SpliceRegionIndex &regions,
+                                                            TranscriptSweep &sweep,
+                                                            const string &chrom,
+                                                            CHRPOS pos) {
+    hits_.clear();
+    const ContigSpliceRegions * contig = regions.contig_regions(chrom);
+    if(contig == NULL)
+        return NULL;
+    //A transcript has at most one region at the variant
+    vector<uint32_t> &candidates = candidates_;
+    candidates.clear();
+    const TranscriptIndex & index = contig->index();
+    if(sweep.advance(index, pos, pos)) {
+        const vector<size_t> & active = sweep.active();
+        for(size_t k = 0; k < active.size(); k++) {
+            if(index.overlaps(active[k], pos, pos))
+                candidates.push_back(index.transcript(active[k]));
+        }
     } else {
-        throw runtime_error("Unknown strand " + transcript_strand);
+        size_t first, last;
+        index.overlap(pos, pos, first, last);
+        for(size_t i = first; i < last; i++) {
+            if(index.overlaps(i, pos, pos))
+                candidates.push_back(index.transcript(i));
+        }
     }
-    return;
+    //Report the transcripts by start, then by transcript ID
+    sort(candidates.begin(), candidates.end(), RegionOutputOrder(*contig));
+    const ContigTranscripts &transcripts = contig->transcripts();
+    for(size_t c = 0; c < candidates.size(); c++) {
+        const SpliceRegion &region = contig->region(candidates[c]);
+        SpliceRegionHit hit;
+        hit.transcript = region.transcript;
+        hit.gene = transcripts.gene(region.transcript);
+        hit.distance = region.distance(pos);
+        hit.type = region.type;
+        hits_.push_back(hit);
+    }
+    return contig;
 }
 
-//Annotate one line of a VCF
-//The line to be annotated is in vcf_record_
-AnnotatedVariant VariantsAnnotator::annotate_record_with_transcripts() {
-    string overlapping_genes = "NA",
-           overlapping_transcripts = "NA",
-           overlapping_distances = "NA",
-           annotations = "NA";
-    set<string> unique_genes;
-    string chr = std::string(bcf_hdr_id2name(vcf_header_in_, vcf_record_->rid));
-    AnnotatedVariant variant(chr, vcf_record_->pos, (vcf_record_->pos) + 1);
-    //While calculating BINs, incorporate intronic_distance since transcripts
-    //which lie within that distance will be relevant.
-    BIN start_bin = ((vcf_record_->pos - intronic_min_distance_) >> _binFirstShift);
-    BIN end_bin = ((vcf_record_->pos + intronic_min_distance_ ) >> _binFirstShift);
-    //Iterate over all BINs this variant could fall under
-    for (BINLEVEL i = 0; i < _binLevels; ++i) {
-        BIN offset = _binOffsetsExtended[i];
-        for (BIN b = (start_bin + offset); b <= (end_bin + offset); ++b) {
-            vector<string> transcripts = gtf_.transcripts_from_bin(chr.c_str(), b);
-            for(std::size_t i = 0; i < transcripts.size(); i++) {
-                const vector<BED> & exons =
-                    gtf_.get_exons_from_transcript(transcripts[i]);
-                if(!exons.size()) {
-                    throw runtime_error("Unexpected error. No exons for transcript "
-                            + transcripts[i]);
-                }
-                //Skip single exon genes
-                if(skip_single_exon_genes_ && exons.size() == 1) {
-                    continue;
-                }
-                //Use a AnnotatedVariant object to hold the result
-                get_variant_overlaps_spliceregion(exons, variant);
-                if(variant.annotation != "non_splice_region") {
-                    string gene_id = gtf_.get_gene_from_transcript(transcripts[i]);
-                    //Use sign to encode intronic/exonic
-                    string annotation = variant.annotation;
-                    string dist_str = variant.score;
-                    //Add gene only once for multiple transcripts of the same gene.
-                    if(overlapping_transcripts != "NA") {
-                        //Check if this gene is new
-                        if(unique_genes.find(gene_id) == unique_genes.end()) {
-                            overlapping_genes += "," + gene_id;
-                            unique_genes.insert(gene_id);
-                        }
-                        overlapping_distances += "," + dist_str;
-                        overlapping_transcripts += "," + transcripts[i];
-                        annotations += "," + annotation;
-                    } else {
-                        overlapping_genes = gene_id;
-                        overlapping_distances = dist_str;
-                        overlapping_transcripts = transcripts[i];
-                        unique_genes.insert(gene_id);
-                        annotations = annotation;
-                    }
-                }
-            }
+//Annotate the current VCF record against the splice regions of one
+//annotation
+void VariantsAnnotator::annotate_record_with_source(const SpliceRegionIndex &regions,
+                                                    TranscriptSweep &sweep,
+                                                    AnnotatedVariant &variant) {
+    const ContigSpliceRegions * contig = collect_hits(regions, sweep,
+                                                      variant.chrom,
+                                                      variant.end);
+    //hits_ holds the regions of candidates_, in the same order
+    for(size_t i = 0; i < hits_.size(); i++) {
+        const SpliceRegion &region = contig->region(candidates_[i]);
+        if(region.has_cis_effect()) {
+            variant.cis_effect_start = min(variant.cis_effect_start,
+                                           region.cis_effect_start);
+            variant.cis_effect_end = max(variant.cis_effect_end,
+                                         region.cis_effect_end);
         }
-        start_bin >>= _binNextShift;
-        end_bin >>= _binNextShift;
     }
-    variant.annotation = annotations;
-    variant.overlapping_genes = overlapping_genes;
-    variant.overlapping_transcripts = overlapping_transcripts;
-    variant.overlapping_distances = overlapping_distances;
-    return variant;
+    //The score holds the distance of the last transcript listed,
+    //-1 if none is listed
+    if(!hits_.empty()) {
+        variant.score.clear();
+        append_number(variant.score, hits_.back().distance);
+    }
+    format_hits(contig, hits_, variant.overlapping_genes,
+                variant.overlapping_transcripts,
+                variant.overlapping_distances, variant.annotation);
 }
 
-//Write annotation output
-void VariantsAnnotator::write_annotation_output(const AnnotatedVariant &v1) {
-    if(bcf_update_info_string(vcf_header_out_, vcf_record_,
+//Set the annotation INFO tags of a record
+void VariantsAnnotator::set_annotation_info(const bcf_hdr_t *header,
+                                            bcf1_t *record,
+                                            const AnnotatedVariant &v1) const {
+    if(bcf_update_info_string(header, record,
                               "genes", v1.overlapping_genes.c_str()) < 0 ||
-       bcf_update_info_string(vcf_header_out_, vcf_record_,
+       bcf_update_info_string(header, record,
                               "transcripts", v1.overlapping_transcripts.c_str()) < 0 ||
-       bcf_update_info_string(vcf_header_out_, vcf_record_,
+       bcf_update_info_string(header, record,
                               "distances", v1.overlapping_distances.c_str()) < 0 ||
-       bcf_update_info_string(vcf_header_out_, vcf_record_,
+       bcf_update_info_string(header, record,
                               "annotations", v1.annotation.c_str()) < 0) {
         throw runtime_error("Unable to update info string");
     }
-    bcf_write(vcf_fh_out_, vcf_header_out_, vcf_record_);
+    for(size_t i = 0; i < v1.source_annotations.size(); i++) {
+        const SourceVariantAnnotation &source = v1.source_annotations[i];
+        const string *tags = &source_info_tags_[4 * i];
+        if(bcf_update_info_string(header, record,
+                                  tags[0].c_str(),
+                                  source.overlapping_genes.c_str()) < 0 ||
+           bcf_update_info_string(header, record,
+                                  tags[1].c_str(),
+                                  source.overlapping_transcripts.c_str()) < 0 ||
+           bcf_update_info_string(header, record,
+                                  tags[2].c_str(),
+                                  source.overlapping_distances.c_str()) < 0 ||
+           bcf_update_info_string(header, record,
+                                  tags[3].c_str(),
+                                  source.annotation.c_str()) < 0) {
+            throw runtime_error("Unable to update info string");
+        }
+    }
+}
+
+//Write a record to the output VCF
+void VariantsAnnotator::write_record(bcf1_t *record, const string &samples) {
+    write_record(vcf_fh_out_, vcf_header_out_, record, samples);
+}
+
+//Write a record to fp, with the copied sample columns
+int VariantsAnnotator::write_record(htsFile *fp, const bcf_hdr_t *header,
+                                    bcf1_t *record,
+                                    const string &samples) const {
+    if(!copy_samples_)
+        return bcf_write(fp, const_cast<bcf_hdr_t *>(header), record);
+    //Like vcf_write, with the sample columns appended to the
+    //columns up to INFO
+    fp->line.l = 0;
+    if(vcf_format(header, record, &fp->line) < 0)
+        return -1;
+    if(!samples.empty()) {
+        fp->line.s[fp->line.l - 1] = '\t';
+        kputsn(samples.data(), samples.size(), &fp->line);
+        kputc('\n', &fp->line);
+    }
+    ssize_t written = fp->format.compression != no_compression ?
+        bgzf_write(fp->fp.bgzf, fp->line.s, fp->line.l) :
+        hwrite(fp->fp.hfile, fp->line.s, fp->line.l);
+    return written == (ssize_t) fp->line.l ? 0 : -1;
+}
+
+//Write annotation output
+void VariantsAnnotator::write_annotation_output(const AnnotatedVariant &v1) {
+    set_annotation_info(vcf_header_out_, vcf_record_, v1);
+    write_record(vcf_record_, samples_);
 }
 
 //Read in next record
 bool VariantsAnnotator::read_next_record() {
-    return (bcf_read(vcf_fh_in_, vcf_header_in_, vcf_record_) == 0);
+    return read_record(vcf_record_, samples_);
+}
+
+//Read the next record of the VCF into record
+bool VariantsAnnotator::read_record(bcf1_t *record, string &samples) {
+    if(!copy_samples_)
+        return (bcf_read(vcf_fh_in_, vcf_header_in_, record) == 0);
+    //Like vcf_read, with the sample columns left as text
+    if(hts_getline(vcf_fh_in_, KS_SEP_LINE, &vcf_fh_in_->line) < 0)
+        return false;
+    return (parse_vcf_line(&vcf_fh_in_->line, vcf_header_in_,
+                           record, samples) == 0);
+}
+
+//Parse a line of the input VCF into record
+int VariantsAnnotator::parse_vcf_line(kstring_t *line,
+                                      const bcf_hdr_t *header,
+                                      bcf1_t *record,
+                                      string &samples) const {
+    record->max_unpack = 0;
+    if(copy_samples_) {
+        //FORMAT is the ninth column
+        const char *p = line->s, *end = line->s + line->l;
+        for(int column = 1; p && column < 9; column++) {
+            p = (const char *) memchr(p, '\t', end - p);
+            if(p)
+                p++;
+        }
+        if(p)
+            samples.assign(p, end - p);
+        else
+            samples.clear();
+        //vcf_parse stops after INFO
+        record->max_unpack = BCF_UN_INFO;
+    }
+    return vcf_parse(line, header, record);
 }
 
 //Heavylifting happens here.
 void VariantsAnnotator::annotate_vcf() {
     load_gtf();
+    load_splice_regions();
     open_vcf_in();
+    if(n_threads_ > 1) {
+        VariantsShards shards(*this, n_threads_);
+        if(shards.usable()) {
+            shards.run();
+            return;
+        }
+    }
     open_vcf_out();
+    if(n_threads_ > 1) {
+        VariantsPipeline pipeline(*this, n_threads_);
+        pipeline.run();
+        return;
+    }
+    AnnotatedVariant v1;
     while(read_next_record()) {
-        AnnotatedVariant v1 = annotate_record_with_transcripts();
+        annotate_record_with_transcripts(v1);
         write_annotation_output(v1);
     }
     //The close happens in the destructor - see cleanup()
@@ -31,15 +31,27 @@ DEALINGS IN THE SOFTWARE.  */
 #include "bedFile.h"
 #include "common.h"
 #include "gtf_parser.h"
+#include "transcript_index.h"
 #include "htslib/hts.h"
 #include "junctions_annotator.h"
+#include "splice_regions.h"
 #include "htslib/vcf.h"
 
 using namespace std;
 
 const string non_splice_region_annotation_string = "NA";
 
+//Annotation of a variant against an additional annotation source
+struct SourceVariantAnnotation {
+    string overlapping_genes;
+    string overlapping_transcripts;
+    string overlapping_distances;
+    string annotation;
+};
+
 //Hold annotations
+//The score, from BED, is the distance of the last transcript listed
+//in overlapping_transcripts, -1 if no transcript is listed
 struct AnnotatedVariant : public BED {
     string overlapping_genes;
     string overlapping_transcripts;
@@ -47,6 +59,8 @@ struct AnnotatedVariant : public BED {
     string annotation;
     CHRPOS cis_effect_start;
     CHRPOS cis_effect_end;
+    //Annotation against each additional annotation source
+    vector<SourceVariantAnnotation> source_annotations;
     AnnotatedVariant() : overlapping_genes("NA"),
                          overlapping_transcripts("NA"),
                          overlapping_distances("NA"),
@@ -61,6 +75,16 @@ struct AnnotatedVariant : public BED {
                          cis_effect_end(0) {}
 };
 
+//A splice region of an annotation at a variant
+struct SpliceRegionHit {
+    //Transcript and gene IDs in the pools of the contig
+    uint32_t transcript;
+    uint32_t gene;
+    //Distance of the variant from the edges of the region
+    CHRPOS distance;
+    SpliceRegionType type;
+};
+
 inline bool operator<(const AnnotatedVariant& lhs, const AnnotatedVariant& rhs) {
   if(lhs.chrom < rhs.chrom )
       return true;
@@ -78,8 +102,11 @@ class VariantsAnnotator {
         string vcf_;
         //Gene annotations file
         string gtffile_;
-        //GTF parser object - holds the GTF in memory
-        GtfParser gtf_;
+        //Loaded annotation, shared with other annotators
+        GtfHandle gtf_;
+        //Annotation sources after the first, written to their own
+        //INFO tags suffixed with the source name
+        AnnotationSources extra_sources_;
         //Output VCF file
         string vcf_out_;
         //Flag set by the -I option
@@ -96,6 +123,8 @@ class VariantsAnnotator {
         uint32_t exonic_min_distance_;
         //Option to skip single exon genes
         bool skip_single_exon_genes_;
+        //Number of threads annotating the variants
+        int n_threads_;
         //VCF file handle
         htsFile *vcf_fh_in_;
         //Header of VCF file
@@ -106,6 +135,26 @@ class VariantsAnnotator {
         bcf_hdr_t *vcf_header_out_;
         //Each VCF record
         bcf1_t *vcf_record_;
+        //Copy the FORMAT and sample columns of VCF lines to the output
+        //as they were read, without parsing them, see read_record
+        bool copy_samples_;
+        //FORMAT and sample columns of vcf_record_ when they are copied
+        string samples_;
+        //Splice regions of the annotation sources for the options,
+        //the first source and then the additional sources
+        vector<SpliceRegionHandle> splice_regions_;
+        //Sweeps over the splice regions of the annotation sources.
+        //VCFs are sorted, so each sweep walks the regions of a
+        //contig once.
+        vector<TranscriptSweep> sweeps_;
+        //Splice regions overlapping the current variant
+        vector<uint32_t> candidates_;
+        //Splice regions of one annotation at the current variant,
+        //reused so annotating a variant does not allocate
+        vector<SpliceRegionHit> hits_;
+        //genes_, transcripts_, distances_ and annotations_ INFO tags
+        //of each additional annotation source
+        vector<string> source_info_tags_;
     public:
         //Default constructor
         VariantsAnnotator() : vcf_("NA"), gtffile_("NA"),
@@ -115,13 +164,16 @@ class VariantsAnnotator {
                               intronic_min_distance_(2),
                               exonic_min_distance_(3),
                               skip_single_exon_genes_(true),
+                              n_threads_(1),
                               vcf_fh_in_(NULL), vcf_header_in_(NULL),
                               vcf_fh_out_(NULL), vcf_header_out_(NULL),
-                              vcf_record_(NULL) {
+                              vcf_record_(NULL),
+                              copy_samples_(false) {
             vcf_record_ = bcf_init();
         }
         //constructor
-        VariantsAnnotator(string vcf_f, GtfParser gp1, string vcf_out) : vcf_(vcf_f),
+        VariantsAnnotator(string vcf_f, GtfHandle gp1, string vcf_out) : vcf_(vcf_f),
+                              gtffile_(gp1->gtffile()),
                               gtf_(gp1),
                               vcf_out_(vcf_out),
                               all_intronic_space_(false),
@@ -129,22 +181,27 @@ class VariantsAnnotator {
                               intronic_min_distance_(2),
                               exonic_min_distance_(3),
                               skip_single_exon_genes_(true),
+                              n_threads_(1),
                               vcf_fh_in_(NULL), vcf_header_in_(NULL),
                               vcf_fh_out_(NULL), vcf_header_out_(NULL),
-                              vcf_record_(NULL) {
+                              vcf_record_(NULL),
+                              copy_samples_(false) {
             vcf_record_ = bcf_init();
         }
         //constructor
-        VariantsAnnotator(string vcf_f, GtfParser gp1,
+        VariantsAnnotator(string vcf_f, GtfHandle gp1,
                           bool all_exonic, bool all_intronic) : vcf_(vcf_f),
+                              gtffile_(gp1->gtffile()),
                               gtf_(gp1),
                               vcf_out_("NA"),
                               intronic_min_distance_(2),
                               exonic_min_distance_(3),
                               skip_single_exon_genes_(true),
+                              n_threads_(1),
                               vcf_fh_in_(NULL), vcf_header_in_(NULL),
                               vcf_fh_out_(NULL), vcf_header_out_(NULL),
-                              vcf_record_(NULL) {
+                              vcf_record_(NULL),
+                              copy_samples_(false) {
             vcf_record_ = bcf_init();
             all_exonic_space_ = all_exonic;
             all_intronic_space_ = all_intronic;
@@ -159,49 +216,92 @@ class VariantsAnnotator {
         int usage(ostream& out);
         //Annotate VCF file
         void annotate_vcf();
-        //Read in GTF file
+        //Read in GTF file, unless an annotation was passed in
         void load_gtf();
+        //Options that decide the splice regions
+        SpliceRegionOptions splice_region_options() const;
+        //Set up the splice region index of each annotation source
+        //for the options, unless it is shared from another annotator
+        void load_splice_regions();
         //Open input VCF file
         void open_vcf_in();
         //Open output VCF file
         void open_vcf_out();
+        //Create the header of the output VCF, the input header with
+        //the annotation INFO tags
+        void create_header_out();
+        //htslib mode to open the output VCF with
+        const char * vcf_out_mode() const;
         //Cleanup VCF file data structures
         void cleanup();
         //Return GTF parser
-        GtfParser gtf() {
+        GtfHandle gtf() const {
             return gtf_;
         }
+        //Number of threads annotating the variants
+        int n_threads() const { return n_threads_; }
+        //Input VCF file
+        const string & vcf() const { return vcf_; }
+        //Output VCF file, "NA" for stdout
+        const string & vcf_out() const { return vcf_out_; }
+        //Input VCF file handle, NULL until it is opened
+        const htsFile * vcf_fh_in() const { return vcf_fh_in_; }
+        //Header of the input VCF, NULL until it is opened
+        bcf_hdr_t * header_in() { return vcf_header_in_; }
+        //Annotate with the options and loaded annotation of another
+        //annotator. The VCF files are not shared, so the two can
+        //annotate on different threads.
+        void share_annotation(const VariantsAnnotator &other);
         //Annotate one line of a VCF
         AnnotatedVariant annotate_record_with_transcripts();
-        //Given a transcript ID and variant position,
-        //check if the variant is in a splice relevant region
-        //relevance depends on the user params
-        //intronic_min_distance_ and exonic_min_distance_
-        //stores result in the AnnotatedVariant object
-        void get_variant_overlaps_spliceregion(const vector<BED> &exons,
-                                           AnnotatedVariant  &variant);
-        //Same as above for positive strand
-        void get_variant_overlaps_spliceregion_ps(const vector<BED> &exons,
-                                           AnnotatedVariant  &variant);
-        //Same as above for negative strand
-        void get_variant_overlaps_spliceregion_ns(const vector<BED> &exons,
-                                           AnnotatedVariant  &variant);
+        //Same as above, annotating into variant. The strings of a
+        //variant reused across records keep their buffers.
+        void annotate_record_with_transcripts(AnnotatedVariant &variant);
+        //Annotate a variant at pos, zero based, of chrom
+        AnnotatedVariant annotate_position(const string &chrom, CHRPOS pos);
+        //Same as above, annotating into variant
+        void annotate_position(const string &chrom, CHRPOS pos,
+                               AnnotatedVariant &variant);
+        //Collect the splice regions of one annotation at pos of chrom
+        //into hits_, in output order. Returns the regions
+        //of the contig, NULL if the annotation has none.
+        const ContigSpliceRegions * collect_hits(const SpliceRegionIndex &regions,
+                                                 TranscriptSweep &sweep,
+                                                 const string &chrom,
+                                                 CHRPOS pos);
+        //Annotate the current VCF record against the splice regions
+        //of one annotation
+        void annotate_record_with_source(const SpliceRegionIndex &regions,
+                                         TranscriptSweep &sweep,
+                                         AnnotatedVariant &variant);
         //Read next record of VCF.
         bool read_next_record();
+        //Read the next record of the VCF into record, with its
+        //FORMAT and sample columns in samples when they are copied
+        bool read_record(bcf1_t *record, string &samples);
+        //Parse a line of the input VCF into record. When the sample
+        //columns are copied only the columns up to INFO are parsed,
+        //the rest of the line goes to samples.
+        int parse_vcf_line(kstring_t *line, const bcf_hdr_t *header,
+                           bcf1_t *record, string &samples) const;
+        //Contig of a record read from the input VCF
+        const char * record_chrom(const bcf1_t *record) const {
+            return bcf_hdr_id2name(vcf_header_in_, record->rid);
+        }
+        //Header of the output VCF, NULL until it is opened
+        const bcf_hdr_t * header_out() const { return vcf_header_out_; }
+        //Set the annotation INFO tags of a record, header is the
+        //header of the output VCF
+        void set_annotation_info(const bcf_hdr_t *header, bcf1_t *record,
+                                 const AnnotatedVariant &v1) const;
+        //Write a record to the output VCF, samples as from read_record
+        void write_record(bcf1_t *record, const string &samples);
+        //Write a record to fp, with the sample columns in samples
+        //when they are copied. Returns a negative value on error.
+        int write_record(htsFile *fp, const bcf_hdr_t *header,
+                         bcf1_t *record, const string &samples) const;
         //Write annotation output
         void write_annotation_output(const AnnotatedVariant &v1);
-        //Get the coordinate limits for the 'cis effect' of this variant
-        void set_variant_cis_effect_limits(const vector<BED>& exons,
-                                           AnnotatedVariant& variant1,
-                                           uint32_t i);
-        //Cis limits negative strand
-        void set_variant_cis_effect_limits_ns(const vector<BED>& exons,
-                                              AnnotatedVariant& variant1,
-                                              uint32_t i);
-        //Cis limits positive strand
-        void set_variant_cis_effect_limits_ps(const vector<BED>& exons,
-                                              AnnotatedVariant& variant1,
-                                              uint32_t i);
 };
 
 inline string variant_set_to_string(const set<AnnotatedVariant> &av1) {
@@ -0,0 +1,191 @@
+/*  variants_pipeline.cc -- annotate variants on several threads
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <stdexcept>
+#include <thread>
+#include "variants_pipeline.h"
+
+using namespace std;
+
+//Constructor, reader has loaded the GTF and opened the VCFs
+VariantsPipeline::VariantsPipeline(VariantsAnnotator &reader,
+                                   int n_threads, size_t batch_size)
+    : reader_(reader)
+    , batch_size_(batch_size)
+    , n_read_(0)
+    , n_written_(0)
+    , read_done_(false)
+    , failed_(false) {
+    if(n_threads < 1)
+        n_threads = 1;
+    for(int i = 0; i < n_threads; i++) {
+        workers_.push_back(unique_ptr<VariantsAnnotator>(
+                               new VariantsAnnotator()));
+        workers_.back()->share_annotation(reader_);
+    }
+    //Enough batches in flight to keep every worker busy while
+    //the next batch to write is still being annotated
+    max_batches_ = 4 * n_threads;
+}
+
+//Record the first failure and wake every thread
+void VariantsPipeline::fail(const string &error) {
+    lock_guard<mutex> lock(mutex_);
+    if(!failed_) {
+        failed_ = true;
+        error_ = error;
+    }
+    read_cv_.notify_all();
+    annotated_cv_.notify_all();
+    written_cv_.notify_all();
+}
+
+//Read the records into batches, reusing the written ones
+void VariantsPipeline::read() {
+    try {
+        bool more = true;
+        while(more) {
+            unique_ptr<VariantBatch> batch;
+            {
+                unique_lock<mutex> lock(mutex_);
+                written_cv_.wait(lock, [this] {
+                    return failed_ || n_read_ - n_written_ < max_batches_;
+                });
+                if(failed_)
+                    return;
+                if(!free_.empty()) {
+                    batch = move(free_.back());
+                    free_.pop_back();
+                }
+            }
+            if(!batch) {
+                batch.reset(new VariantBatch);
+                batch->records.reserve(batch_size_);
+                batch->chroms.resize(batch_size_);
+                batch->samples.resize(batch_size_);
+            }
+            batch->size = 0;
+            while(batch->size < batch_size_) {
+                if(batch->size == batch->records.size())
+                    batch->records.push_back(bcf_init());
+                bcf1_t *record = batch->records[batch->size];
+                if(!reader_.read_record(record,
+                                        batch->samples[batch->size])) {
+                    more = false;
+                    break;
+                }
+                batch->chroms[batch->size] = reader_.record_chrom(record);
+                batch->size++;
+            }
+            lock_guard<mutex> lock(mutex_);
+            if(batch->size) {
+                batch->index = n_read_++;
+                pending_.push_back(move(batch));
+            }
+            if(!more)
+                read_done_ = true;
+            read_cv_.notify_all();
+            annotated_cv_.notify_all();
+        }
+    } catch(const runtime_error &e) {
+        fail(e.what());
+    }
+}
+
+//Annotate batches with one of the workers
+void VariantsPipeline::annotate(VariantsAnnotator &worker) {
+    try {
+        const bcf_hdr_t *header = reader_.header_out();
+        //Reused for every record, so annotating does not allocate
+        string chrom;
+        AnnotatedVariant v1;
+        while(true) {
+            unique_ptr<VariantBatch> batch;
+            {
+                unique_lock<mutex> lock(mutex_);
+                read_cv_.wait(lock, [this] {
+                    return failed_ || read_done_ || !pending_.empty();
+                });
+                if(failed_ || pending_.empty())
+                    return;
+                batch = move(pending_.front());
+                pending_.pop_front();
+            }
+            for(size_t i = 0; i < batch->size; i++) {
+                bcf1_t *record = batch->records[i];
+                chrom = batch->chroms[i];
+                worker.annotate_position(chrom, record->pos, v1);
+                worker.set_annotation_info(header, record, v1);
+            }
+            lock_guard<mutex> lock(mutex_);
+            uint64_t index = batch->index;
+            annotated_[index] = move(batch);
+            annotated_cv_.notify_all();
+        }
+    } catch(const runtime_error &e) {
+        fail(e.what());
+    }
+}
+
+//Annotate and write every record, returns the number of records
+//written. Throws runtime_error if a thread fails.
+uint64_t VariantsPipeline::run() {
+    uint64_t n_records = 0;
+    vector<thread> threads;
+    threads.push_back(thread(&VariantsPipeline::read, this));
+    for(size_t i = 0; i < workers_.size(); i++) {
+        threads.push_back(thread(&VariantsPipeline::annotate, this,
+                                 ref(*workers_[i])));
+    }
+    while(true) {
+        unique_ptr<VariantBatch> batch;
+        {
+            unique_lock<mutex> lock(mutex_);
+            annotated_cv_.wait(lock, [this] {
+                return failed_ || annotated_.count(n_written_) ||
+                       (read_done_ && n_written_ == n_read_);
+            });
+            if(failed_ || !annotated_.count(n_written_))
+                break;
+            map<uint64_t, unique_ptr<VariantBatch> >::iterator it =
+                annotated_.find(n_written_);
+            batch = move(it->second);
+            annotated_.erase(it);
+        }
+        for(size_t i = 0; i < batch->size; i++) {
+            reader_.write_record(batch->records[i], batch->samples[i]);
+            n_records++;
+        }
+        lock_guard<mutex> lock(mutex_);
+        n_written_++;
+        free_.push_back(move(batch));
+        written_cv_.notify_all();
+    }
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    if(failed_)
+        throw runtime_error(error_);
+    return n_records;
+}
@@ -0,0 +1,119 @@
+/*  variants_pipeline.h -- annotate variants on several threads
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef VARIANTS_PIPELINE_H_
+#define VARIANTS_PIPELINE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "variants_annotator.h"
+
+using namespace std;
+
+//Consecutive records of the input VCF, annotated together.
+//Batches are recycled once they are written, so the records and
+//their buffers are allocated once per run and not once per record.
+struct VariantBatch {
+    //Position of the batch in the input
+    uint64_t index;
+    //Number of records read into the batch
+    size_t size;
+    //The records, in input order, only the first size are in use
+    vector<bcf1_t *> records;
+    //Contig of each record, looked up by the reader
+    vector<const char *> chroms;
+    //FORMAT and sample columns of each record when they are copied
+    vector<string> samples;
+    //Constructor
+    VariantBatch() : index(0), size(0) {}
+    //Destructor
+    ~VariantBatch() {
+        for(size_t i = 0; i < records.size(); i++) {
+            bcf_destroy(records[i]);
+        }
+    }
+};
+
+//Annotate the VCF of an annotator on several threads.
+//A reader thread reads the records into batches, so the input is
+//only read from one thread. Worker threads annotate batches against
+//the shared, read-only annotation and set the INFO tags of the
+//records, each with its own VariantsAnnotator for scratch space. The
+//calling thread writes the batches in input order, so the output is
+//the same as a serial run.
+class VariantsPipeline {
+    private:
+        //Reads and writes the VCF
+        VariantsAnnotator &reader_;
+        //One annotator per worker, sharing the annotation of reader_
+        vector<unique_ptr<VariantsAnnotator> > workers_;
+        //Number of records per batch
+        size_t batch_size_;
+        //Maximum number of batches read but not written
+        size_t max_batches_;
+        //Protects everything below
+        mutex mutex_;
+        //Signalled when a batch is read or reading stops
+        condition_variable read_cv_;
+        //Signalled when a batch is annotated or a thread fails
+        condition_variable annotated_cv_;
+        //Signalled when a batch is written
+        condition_variable written_cv_;
+        //Written batches, ready to be read into again
+        vector<unique_ptr<VariantBatch> > free_;
+        //Batches waiting for a worker
+        deque<unique_ptr<VariantBatch> > pending_;
+        //Annotated batches waiting to be written, by index
+        map<uint64_t, unique_ptr<VariantBatch> > annotated_;
+        //Number of batches read so far
+        uint64_t n_read_;
+        //Number of batches written so far
+        uint64_t n_written_;
+        //Has the reader reached the end of the input
+        bool read_done_;
+        //Set when a thread fails, stops every thread
+        bool failed_;
+        //Error message of the first failure
+        string error_;
+        //Read the records into batches
+        void read();
+        //Annotate batches with one of the workers
+        void annotate(VariantsAnnotator &worker);
+        //Record the first failure and wake every thread
+        void fail(const string &error);
+    public:
+        //Constructor, reader has loaded the GTF and opened the input
+        //and output VCFs
+        VariantsPipeline(VariantsAnnotator &reader, int n_threads,
+                         size_t batch_size = 1024);
+        //Annotate and write every record, returns the number of
+        //records written. Throws runtime_error if a thread fails.
+        uint64_t run();
+};
+
+#endif
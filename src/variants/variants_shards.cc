@@ -0,0 +1,378 @@
+/*  variants_shards.cc -- annotate regions of an indexed VCF on several threads
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include "common.h"
+#include "variants_shards.h"
+
+using namespace std;
+
+//Length of the regions a contig is split into
+static const int64_t kShardLength = 10000000;
+
+//A position as the index queries of htslib take it. This htslib
+//has no hts_pos_t and the positions of records fit in an int, so
+//anything past INT_MAX is clamped.
+static int query_pos(int64_t pos) {
+    return pos < INT_MAX ? (int) pos : INT_MAX;
+}
+
+//The empty block that ends a BGZF file
+static const unsigned char kBgzfEof[28] = {
+    0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+    0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+//Copy the blocks of a BGZF file to out, without the end of file block
+static void append_bgzf_blocks(const string &file, FILE *out) {
+    FILE *in = fopen(file.c_str(), "rb");
+    if(in == NULL) {
+        throw runtime_error("Unable to open " + file);
+    }
+    unsigned char eof[sizeof(kBgzfEof)];
+    long size = -1;
+    if(fseek(in, 0, SEEK_END) == 0)
+        size = ftell(in);
+    if(size < (long) sizeof(kBgzfEof) ||
+       fseek(in, size - sizeof(kBgzfEof), SEEK_SET) != 0 ||
+       fread(eof, 1, sizeof(eof), in) != sizeof(eof) ||
+       memcmp(eof, kBgzfEof, sizeof(eof)) != 0) {
+        fclose(in);
+        throw runtime_error(file + " is not a complete BGZF file.");
+    }
+    rewind(in);
+    long remaining = size - sizeof(kBgzfEof);
+    vector<char> buffer(1 << 20);
+    while(remaining > 0) {
+        size_t n = fread(&buffer[0], 1, min((long) buffer.size(), remaining), in);
+        if(n == 0 || fwrite(&buffer[0], 1, n, out) != n) {
+            fclose(in);
+            throw runtime_error("Unable to copy " + file);
+        }
+        remaining -= n;
+    }
+    fclose(in);
+}
+
+//Join BGZF files into output by copying their compressed blocks
+//BGZF blocks are independent gzip members, so the blocks of several
+//files can follow each other once their end of file blocks are
+//dropped, and one end of file block ends the output
+void join_bgzf_files(const vector<string> &files, const string &output) {
+    FILE *out = fopen(output.c_str(), "wb");
+    if(out == NULL) {
+        throw runtime_error("Unable to open " + output);
+    }
+    try {
+        for(size_t i = 0; i < files.size(); i++) {
+            append_bgzf_blocks(files[i], out);
+        }
+    } catch(const runtime_error &) {
+        fclose(out);
+        throw;
+    }
+    if(fwrite(kBgzfEof, 1, sizeof(kBgzfEof), out) != sizeof(kBgzfEof) ||
+       fclose(out) != 0) {
+        throw runtime_error("Unable to write " + output);
+    }
+}
+
+//Constructor, loads the index of the input if there is one
+//Regions are only used for a bgzipped VCF or a BCF that is written to
+//a bgzipped VCF or BCF file
+VariantsShards::VariantsShards(VariantsAnnotator &reader, int n_threads)
+    : reader_(reader)
+    , n_threads_(n_threads)
+    , bcf_(false)
+    , idx_(NULL)
+    , tbx_(NULL)
+    , header_in_(NULL)
+    , header_out_(NULL)
+    , next_shard_(0)
+    , n_records_(0)
+    , failed_(false) {
+    const htsFile *in = reader_.vcf_fh_in();
+    if(reader_.vcf_out() == "NA" ||
+       string(reader_.vcf_out_mode()) == "w" ||
+       in == NULL || in->format.compression != bgzf) {
+        return;
+    }
+    if(in->format.format == bcf) {
+        bcf_ = true;
+        idx_ = bcf_index_load(reader_.vcf().c_str());
+    } else if(in->format.format == vcf) {
+        tbx_ = tbx_index_load(reader_.vcf().c_str());
+    }
+}
+
+//Destructor
+VariantsShards::~VariantsShards() {
+    if(idx_)
+        hts_idx_destroy(idx_);
+    if(tbx_)
+        tbx_destroy(tbx_);
+    if(header_in_)
+        bcf_hdr_destroy(header_in_);
+    if(header_out_)
+        bcf_hdr_destroy(header_out_);
+}
+
+//Split the contigs of the index into regions
+//The contigs are ordered by their first record in the file, so the
+//regions follow the order of the input even if the contigs are not in
+//the order of the header
+void VariantsShards::plan() {
+    bcf_hdr_t *header = reader_.header_in();
+    int n_names = 0;
+    const char **names = bcf_ ?
+        bcf_index_seqnames(idx_, header, &n_names) :
+        tbx_seqnames(tbx_, &n_names);
+    //Offset of the first record and ID of each contig
+    vector<pair<uint64_t, int> > contigs;
+    for(int i = 0; i < n_names; i++) {
+        int tid = bcf_ ? bcf_hdr_name2id(header, names[i]) :
+                         tbx_name2id(tbx_, names[i]);
+        hts_itr_t *itr = bcf_ ? bcf_itr_queryi(idx_, tid, 0, INT_MAX) :
+                                tbx_itr_queryi(tbx_, tid, 0, INT_MAX);
+        if(itr == NULL)
+            continue;
+        if(itr->n_off > 0) {
+            uint64_t first = itr->off[0].u;
+            for(int j = 1; j < itr->n_off; j++)
+                first = min(first, itr->off[j].u);
+            contigs.push_back(make_pair(first, tid));
+        }
+        hts_itr_destroy(itr);
+        //Records of a bgzipped VCF may be on contigs that are not in
+        //the header
+        if(!bcf_ && bcf_hdr_name2id(header, names[i]) < 0) {
+            extra_contigs_.push_back(string("##contig=<ID=") +
+                                     names[i] + ">");
+        }
+    }
+    free(names);
+    header_in_ = bcf_hdr_dup(header);
+    for(size_t i = 0; i < extra_contigs_.size(); i++)
+        bcf_hdr_append(header_in_, extra_contigs_[i].c_str());
+    bcf_hdr_sync(header_in_);
+    sort(contigs.begin(), contigs.end());
+    //Split each contig until the index has no records past the start
+    for(size_t i = 0; i < contigs.size(); i++) {
+        int tid = contigs[i].second;
+        for(int64_t start = 0; start < INT_MAX; start += kShardLength) {
+            hts_itr_t *itr = bcf_ ?
+                bcf_itr_queryi(idx_, tid, query_pos(start), INT_MAX) :
+                tbx_itr_queryi(tbx_, tid, query_pos(start), INT_MAX);
+            bool more = itr != NULL && itr->n_off > 0;
+            if(itr)
+                hts_itr_destroy(itr);
+            if(!more)
+                break;
+            VariantShard shard;
+            shard.tid = tid;
+            shard.start = start;
+            shard.end = start + kShardLength;
+            shard.written = false;
+            shard.file = reader_.vcf_out() + ".shard" +
+                         common::num_to_str(shards_.size());
+            shards_.push_back(shard);
+        }
+    }
+}
+
+//Record the first failure
+void VariantsShards::fail(const string &error) {
+    lock_guard<mutex> lock(mutex_);
+    if(!failed_) {
+        failed_ = true;
+        error_ = error;
+    }
+}
+
+//Annotate the records of one region
+uint64_t VariantsShards::annotate_shard(VariantShard &shard,
+                                        VariantsAnnotator &worker,
+                                        htsFile *in, bcf_hdr_t *header_in,
+                                        bcf_hdr_t *header_out) {
+    hts_itr_t *itr = bcf_ ?
+        bcf_itr_queryi(idx_, shard.tid, query_pos(shard.start),
+                       query_pos(shard.end)) :
+        tbx_itr_queryi(tbx_, shard.tid, query_pos(shard.start),
+                       query_pos(shard.end));
+    if(itr == NULL)
+        return 0;
+    htsFile *out = NULL;
+    bcf1_t *record = bcf_init();
+    kstring_t line = {0, 0, NULL};
+    string samples, chrom;
+    AnnotatedVariant v1;
+    uint64_t n_records = 0;
+    string error;
+    while(error.empty()) {
+        if(bcf_) {
+            if(bcf_itr_next(in, itr, record) < 0)
+                break;
+        } else {
+            if(tbx_itr_next(in, tbx_, itr, &line) < 0)
+                break;
+            if(reader_.parse_vcf_line(&line, header_in, record,
+                                      samples) < 0) {
+                error = "Unable to parse " + string(line.s);
+                break;
+            }
+        }
+        //Records that start in the region before belong to that shard
+        if(record->pos < shard.start)
+            continue;
+        if(out == NULL) {
+            out = hts_open(shard.file.c_str(), reader_.vcf_out_mode());
+            if(out == NULL) {
+                error = "Unable to open " + shard.file;
+                break;
+            }
+            shard.written = true;
+        }
+        chrom = bcf_hdr_id2name(header_in, record->rid);
+        worker.annotate_position(chrom, record->pos, v1);
+        try {
+            worker.set_annotation_info(header_out, record, v1);
+        } catch(const runtime_error &e) {
+            error = e.what();
+            break;
+        }
+        if(reader_.write_record(out, header_out, record, samples) < 0) {
+            error = "Unable to write " + shard.file;
+            break;
+        }
+        n_records++;
+    }
+    if(out)
+        hts_close(out);
+    free(line.s);
+    bcf_destroy(record);
+    hts_itr_destroy(itr);
+    if(!error.empty())
+        throw runtime_error(error);
+    return n_records;
+}
+
+//Annotate shards until none are left
+//Each worker reads the input through its own file handle, the index
+//and the annotation are shared
+void VariantsShards::annotate() {
+    htsFile *in = hts_open(reader_.vcf().c_str(), "r");
+    if(in == NULL) {
+        fail("Unable to open " + reader_.vcf());
+        return;
+    }
+    bcf_hdr_t *header_in = bcf_hdr_dup(header_in_);
+    bcf_hdr_t *header_out = bcf_hdr_dup(header_out_);
+    VariantsAnnotator worker;
+    worker.share_annotation(reader_);
+    try {
+        while(true) {
+            size_t i;
+            {
+                lock_guard<mutex> lock(mutex_);
+                if(failed_ || next_shard_ == shards_.size())
+                    break;
+                i = next_shard_++;
+            }
+            uint64_t n_records = annotate_shard(shards_[i], worker, in,
+                                                header_in, header_out);
+            lock_guard<mutex> lock(mutex_);
+            n_records_ += n_records;
+        }
+    } catch(const runtime_error &e) {
+        fail(e.what());
+    }
+    bcf_hdr_destroy(header_out);
+    bcf_hdr_destroy(header_in);
+    hts_close(in);
+}
+
+//Write the header of the output to its own BGZF file
+void VariantsShards::write_header(const string &file) {
+    htsFile *out = hts_open(file.c_str(), reader_.vcf_out_mode());
+    if(out == NULL) {
+        throw runtime_error("Unable to open " + file);
+    }
+    bcf_hdr_t *header = bcf_hdr_dup(reader_.header_out());
+    bcf_hdr_write(out, header);
+    bcf_hdr_destroy(header);
+    hts_close(out);
+}
+
+//Annotate and write every record
+uint64_t VariantsShards::run() {
+    plan();
+    reader_.create_header_out();
+    header_out_ = bcf_hdr_dup(reader_.header_out());
+    for(size_t i = 0; i < extra_contigs_.size(); i++)
+        bcf_hdr_append(header_out_, extra_contigs_[i].c_str());
+    bcf_hdr_sync(header_out_);
+    string header_file = reader_.vcf_out() + ".header";
+    try {
+        write_header(header_file);
+    } catch(const runtime_error &e) {
+        fail(e.what());
+    }
+    if(!failed_) {
+        vector<thread> threads;
+        for(int i = 0; i < n_threads_; i++) {
+            threads.push_back(thread(&VariantsShards::annotate, this));
+        }
+        for(size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+    if(!failed_) {
+        //Regions without records have no shard, only the shards
+        //written by this run are joined
+        vector<string> files(1, header_file);
+        for(size_t i = 0; i < shards_.size(); i++) {
+            if(shards_[i].written)
+                files.push_back(shards_[i].file);
+        }
+        try {
+            join_bgzf_files(files, reader_.vcf_out());
+        } catch(const runtime_error &e) {
+            fail(e.what());
+        }
+    }
+    remove(header_file.c_str());
+    for(size_t i = 0; i < shards_.size(); i++) {
+        if(shards_[i].written)
+            remove(shards_[i].file.c_str());
+    }
+    if(failed_)
+        throw runtime_error(error_);
+    return n_records_;
+}
@@ -0,0 +1,128 @@
+/*  variants_shards.h -- annotate regions of an indexed VCF on several threads
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#ifndef VARIANTS_SHARDS_H_
+#define VARIANTS_SHARDS_H_
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "variants_annotator.h"
+#include "htslib/tbx.h"
+
+using namespace std;
+
+//A region of the input, the records that start in the region are
+//annotated into one shard
+struct VariantShard {
+    //Contig ID in the index
+    int tid;
+    //Zero based start of the region
+    int64_t start;
+    //Zero based end of the region, exclusive
+    int64_t end;
+    //BGZF file the shard is written to, only created if the region
+    //has records
+    string file;
+    //Has this run written file, set by the worker of the shard
+    bool written;
+};
+
+//Annotate an indexed VCF/BCF in regions on several threads.
+//The contigs of the index are split into regions in the order of the
+//file. Worker threads read each region through the index and annotate
+//it into its own BGZF shard, each with its own VariantsAnnotator for
+//scratch space. The shards are then joined after the header by
+//copying their compressed blocks, without decompressing them, so the
+//output is one bgzipped VCF or BCF with the records of a serial run in
+//the same order.
+class VariantsShards {
+    private:
+        //Has parsed its options, loaded the annotation and opened the
+        //input VCF
+        VariantsAnnotator &reader_;
+        //Number of worker threads
+        int n_threads_;
+        //Is the input a BCF, otherwise it is a bgzipped VCF
+        bool bcf_;
+        //CSI index of a BCF
+        hts_idx_t *idx_;
+        //Tabix index of a bgzipped VCF
+        tbx_t *tbx_;
+        //Regions of the input, in the order of the file
+        vector<VariantShard> shards_;
+        //Contigs of a bgzipped VCF that are not in its header, as
+        //##contig lines
+        vector<string> extra_contigs_;
+        //Copies of the input and output headers with extra_contigs_,
+        //the workers parse and format records with them. The output
+        //file gets the header of a serial run.
+        bcf_hdr_t *header_in_;
+        bcf_hdr_t *header_out_;
+        //Protects everything below
+        mutex mutex_;
+        //Next shard without a worker
+        size_t next_shard_;
+        //Number of records annotated
+        uint64_t n_records_;
+        //Set when a thread fails, stops every thread
+        bool failed_;
+        //Error message of the first failure
+        string error_;
+        //Split the contigs of the index into regions
+        void plan();
+        //Annotate shards until none are left
+        void annotate();
+        //Annotate the records of one region, returns the number of
+        //records annotated
+        uint64_t annotate_shard(VariantShard &shard,
+                                VariantsAnnotator &worker, htsFile *in,
+                                bcf_hdr_t *header_in, bcf_hdr_t *header_out);
+        //Write the header of the output to its own BGZF file
+        void write_header(const string &file);
+        //Record the first failure
+        void fail(const string &error);
+        //Not copyable
+        VariantsShards(const VariantsShards &other);
+        VariantsShards& operator= (const VariantsShards &other);
+    public:
+        //Constructor, loads the index of the input if there is one
+        VariantsShards(VariantsAnnotator &reader, int n_threads);
+        //Destructor
+        ~VariantsShards();
+        //Can the input be annotated in regions, i.e is it an indexed
+        //BCF or bgzipped VCF written to a BCF or bgzipped VCF file
+        bool usable() const { return idx_ != NULL || tbx_ != NULL; }
+        //Annotate and write every record, returns the number of records
+        //annotated. Throws runtime_error if a thread fails.
+        uint64_t run();
+};
+
+//Join BGZF files into output by copying their compressed blocks.
+//Throws runtime_error if a file does not end with the empty block
+//that marks the end of a BGZF file.
+void join_bgzf_files(const vector<string> &files, const string &output);
+
+#endif
@@ -0,0 +1,266 @@
+/*  bench_transcript_index.cc -- compare the transcript index with the UCSC bin walk
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bedFile.h"
+#include "gtf_parser.h"
+#include "htslib/vcf.h"
+#include "transcript_index.h"
+
+using namespace std;
+
+//A query region, closed interval
+struct Query {
+    string chrom;
+    CHRPOS start;
+    CHRPOS end;
+    //Start before adjusting with the block sizes
+    CHRPOS floor;
+};
+
+//Order queries like a sorted BED, by chrom and then floor
+bool query_less(const Query &q1, const Query &q2) {
+    if(q1.chrom != q2.chrom)
+        return q1.chrom < q2.chrom;
+    return q1.floor < q2.floor;
+}
+
+//UCSC bins of the transcripts of one chromosome, values are
+//positions in the transcript index
+typedef map<BIN, vector<size_t> > BinToEntries;
+
+//The bin walk that the annotators used before the interval index
+class BinWalk {
+    private:
+        map<string, BinToEntries> chr_to_bins_;
+    public:
+        //Bin the entries of a chromosome's transcript index
+        void add_chromosome(const string &chr, const TranscriptIndex &index) {
+            if(chr_to_bins_.count(chr))
+                return;
+            BinToEntries &bins = chr_to_bins_[chr];
+            for(size_t i = 0; i < index.size(); i++) {
+                //getBin takes a half open interval
+                bins[getBin(index.start(i), index.end(i) + 1)].push_back(i);
+            }
+        }
+        //Collect the entries overlapping [start, end]
+        void query(const Query &q, const TranscriptIndex &index,
+                   vector<size_t> &hits) {
+            hits.clear();
+            map<string, BinToEntries>::iterator chr_it = chr_to_bins_.find(q.chrom);
+            if(chr_it == chr_to_bins_.end())
+                return;
+            BIN start_bin = q.start >> _binFirstShift;
+            BIN end_bin = q.end >> _binFirstShift;
+            for (BINLEVEL i = 0; i < _binLevels; ++i) {
+                BIN offset = _binOffsetsExtended[i];
+                for (BIN b = (start_bin + offset); b <= (end_bin + offset); ++b) {
+                    BinToEntries::const_iterator bin_it = chr_it->second.find(b);
+                    if(bin_it == chr_it->second.end())
+                        continue;
+                    const vector<size_t> &entries = bin_it->second;
+                    for(size_t j = 0; j < entries.size(); j++) {
+                        if(index.overlaps(entries[j], q.start, q.end))
+                            hits.push_back(entries[j]);
+                    }
+                }
+                start_bin >>= _binNextShift;
+                end_bin >>= _binNextShift;
+            }
+        }
+};
+
+//Index of the transcripts on a chromosome, empty if there are none
+const TranscriptIndex & transcript_index(const GtfParser &gtf, const string &chr) {
+    static const TranscriptIndex empty_index;
+    const ContigTranscripts *contig = gtf.contig_transcripts(chr);
+    return contig ? contig->index() : empty_index;
+}
+
+//Collect the entries overlapping [start, end] using the interval index
+void index_query(const Query &q, const TranscriptIndex &index,
+                 vector<size_t> &hits) {
+    hits.clear();
+    size_t first, last;
+    index.overlap(q.start, q.end, first, last);
+    for(size_t i = first; i < last; i++) {
+        if(index.overlaps(i, q.start, q.end))
+            hits.push_back(i);
+    }
+}
+
+//Collect the entries overlapping [start, end] with a sweep,
+//the queries have to be sorted for the sweep to stay on
+void sweep_query(const Query &q, const TranscriptIndex &index,
+                 TranscriptSweep &sweep, vector<size_t> &hits) {
+    hits.clear();
+    if(index.size() == 0)
+        return;
+    if(!sweep.advance(index, q.floor, q.end)) {
+        index_query(q, index, hits);
+        return;
+    }
+    const vector<size_t> &active = sweep.active();
+    for(size_t i = 0; i < active.size(); i++) {
+        if(index.overlaps(active[i], q.start, q.end))
+            hits.push_back(active[i]);
+    }
+}
+
+//Read junctions from a BED12 file, adjusting the ends with
+//the block sizes like `junctions annotate` does
+vector<Query> read_junctions(const string &bed) {
+    vector<Query> queries;
+    ifstream in(bed.c_str());
+    if(!in.is_open())
+        throw runtime_error("Unable to open " + bed);
+    string line;
+    while(getline(in, line)) {
+        if(line.empty() || line[0] == '#')
+            continue;
+        vector<string> fields;
+        Tokenize(line, fields);
+        if(fields.size() < 12)
+            continue;
+        vector<int> block_sizes;
+        Tokenize(fields[10], block_sizes, ',');
+        Query q;
+        q.chrom = fields[0];
+        q.floor = atol(fields[1].c_str());
+        q.start = atol(fields[1].c_str()) + block_sizes[0];
+        q.end = atol(fields[2].c_str()) - block_sizes[1] + 1;
+        queries.push_back(q);
+    }
+    return queries;
+}
+
+//Read variant positions from a VCF/BCF file
+vector<Query> read_variants(const string &vcf) {
+    vector<Query> queries;
+    htsFile *fp = bcf_open(vcf.c_str(), "r");
+    if(fp == NULL)
+        throw runtime_error("Unable to open " + vcf);
+    bcf_hdr_t *hdr = bcf_hdr_read(fp);
+    bcf1_t *rec = bcf_init();
+    while(bcf_read(fp, hdr, rec) == 0) {
+        Query q;
+        q.chrom = bcf_hdr_id2name(hdr, rec->rid);
+        q.start = rec->pos + 1;
+        q.end = rec->pos + 1;
+        q.floor = q.start;
+        queries.push_back(q);
+    }
+    bcf_destroy(rec);
+    bcf_hdr_destroy(hdr);
+    bcf_close(fp);
+    return queries;
+}
+
+//Time the lookups over a set of queries and check that they agree
+//The queries are sorted first, like `junctions extract` output
+void compare(const string &label, vector<Query> queries,
+             const GtfParser &gtf, int repeats) {
+    stable_sort(queries.begin(), queries.end(), query_less);
+    BinWalk bin_walk;
+    for(size_t i = 0; i < queries.size(); i++)
+        bin_walk.add_chromosome(queries[i].chrom,
+                                transcript_index(gtf, queries[i].chrom));
+    vector<size_t> hits1, hits2, hits3;
+    size_t mismatches = 0, total_hits = 0;
+    TranscriptSweep check_sweep;
+    for(size_t i = 0; i < queries.size(); i++) {
+        const TranscriptIndex &index = transcript_index(gtf, queries[i].chrom);
+        bin_walk.query(queries[i], index, hits1);
+        index_query(queries[i], index, hits2);
+        sweep_query(queries[i], index, check_sweep, hits3);
+        sort(hits1.begin(), hits1.end());
+        if(hits1 != hits2 || hits2 != hits3)
+            mismatches++;
+        total_hits += hits2.size();
+    }
+    size_t checksum = 0;
+    clock_t t0 = clock();
+    for(int r = 0; r < repeats; r++) {
+        for(size_t i = 0; i < queries.size(); i++) {
+            bin_walk.query(queries[i], transcript_index(gtf, queries[i].chrom), hits1);
+            checksum += hits1.size();
+        }
+    }
+    clock_t t1 = clock();
+    for(int r = 0; r < repeats; r++) {
+        for(size_t i = 0; i < queries.size(); i++) {
+            index_query(queries[i], transcript_index(gtf, queries[i].chrom), hits2);
+            checksum += hits2.size();
+        }
+    }
+    clock_t t2 = clock();
+    for(int r = 0; r < repeats; r++) {
+        TranscriptSweep sweep;
+        for(size_t i = 0; i < queries.size(); i++) {
+            sweep_query(queries[i], transcript_index(gtf, queries[i].chrom),
+                        sweep, hits3);
+            checksum += hits3.size();
+        }
+    }
+    clock_t t3 = clock();
+    double n = (double) queries.size() * repeats;
+    double bin_ns = n ? 1e9 * (t1 - t0) / CLOCKS_PER_SEC / n : 0;
+    double index_ns = n ? 1e9 * (t2 - t1) / CLOCKS_PER_SEC / n : 0;
+    double sweep_ns = n ? 1e9 * (t3 - t2) / CLOCKS_PER_SEC / n : 0;
+    cout << label << "\tqueries: " << queries.size()
+         << "\thits: " << total_hits
+         << "\tmismatches: " << mismatches
+         << "\tbin walk ns/query: " << bin_ns
+         << "\tindex ns/query: " << index_ns
+         << "\tsweep ns/query: " << sweep_ns
+         << "\tchecksum: " << checksum << endl;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 4) {
+        cerr << "\nUsage:\t\tBenchTranscriptIndex annotations.gtf junctions.bed "
+                "variants.vcf [repeats]\n";
+        return 1;
+    }
+    int repeats = argc > 4 ? atoi(argv[4]) : 100;
+    try {
+        GtfHandle gtf = load_annotation(argv[1]);
+        compare("junctions", read_junctions(argv[2]), *gtf, repeats);
+        compare("variants", read_variants(argv[3]), *gtf, repeats);
+    } catch(const runtime_error &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
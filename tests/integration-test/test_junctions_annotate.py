@@ -27,6 +27,8 @@ DEALINGS IN THE SOFTWARE.
 '''
 
 from integrationtest import IntegrationTest, main
+import os
+import shutil
 import unittest
 
 class TestAnnotate(IntegrationTest, unittest.TestCase):
@@ -41,5 +43,122 @@ class TestAnnotate(IntegrationTest, unittest.TestCase):
         self.assertEqual(rv, 0)
         self.assertFilesEqual(expected_file, output_file)
 
+    def test_junctions_annotate_single_exon(self):
+        junctions = self.inputFiles("bed/test_hcc1395_junctions.bed")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.gtf")[0]
+        fasta = self.inputFiles("fa/test_chr22.fa")[0]
+        output_file = self.tempFile("observed-annotate-single-exon.out")
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate-single-exon.out")[0]
+        params = ["junctions", "annotate", "-E", "-o", output_file, junctions, fasta, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(expected_file, output_file)
+
+    def test_junctions_annotate_sources(self):
+        junctions = self.inputFiles("bed/test_hcc1395_junctions.bed")[0]
+        gtf1 = self.inputFiles("gtf/test_ensemble_chr22.gtf")[0]
+        gtf2 = self.inputFiles("gtf/test_ensemble_chr22.2.gtf")[0]
+        fasta = self.inputFiles("fa/test_chr22.fa")[0]
+        output_file = self.tempFile("observed-annotate-sources.out")
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate-sources.out")[0]
+        sources = "ensembl=" + gtf1 + ",alt=" + gtf2
+        params = ["junctions", "annotate", "-o", output_file, junctions, fasta, sources]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(expected_file, output_file)
+
+    def test_junctions_annotate_gtf_path(self):
+        junctions = self.inputFiles("bed/test_hcc1395_junctions.bed")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.gtf")[0]
+        fasta = self.inputFiles("fa/test_chr22.fa")[0]
+        output_file = self.tempFile("observed-annotate-gtf-path.out")
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate.out")[0]
+        #An existing GTF is not split into named sources
+        gtf_dir = self.tempFile("run=1,2")
+        os.mkdir(gtf_dir)
+        gtf_copy = os.path.join(gtf_dir, "g.gtf")
+        shutil.copy(gtf, gtf_copy)
+        params = ["junctions", "annotate", "-o", output_file, junctions, fasta, gtf_copy]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(expected_file, output_file)
+
+    def test_junctions_annotate_threads(self):
+        junctions = self.inputFiles("bed/test_hcc1395_junctions.bed")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.gtf")[0]
+        fasta = self.inputFiles("fa/test_chr22.fa")[0]
+        output_file = self.tempFile("observed-annotate-threads.out")
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate.out")[0]
+        params = ["junctions", "annotate", "-t", "3", "-o", output_file, junctions, fasta, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(expected_file, output_file)
+    def test_junctions_annotate_cohort(self):
+        junctions = self.inputFiles("bed/test_hcc1395_junctions.bed")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.gtf")[0]
+        fasta = self.inputFiles("fa/test_chr22.fa")[0]
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate.out")[0]
+        samples = "tumor=%s,normal=%s" % (junctions, junctions)
+        params = ["junctions", "annotate", "-d", self.tmp_dir, samples, fasta, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(expected_file, self.tempFile("tumor.annotated.tsv"))
+        self.assertFilesEqual(expected_file, self.tempFile("normal.annotated.tsv"))
+    def test_junctions_annotate_junctions_path(self):
+        junctions = self.inputFiles("bed/test_hcc1395_junctions.bed")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.gtf")[0]
+        fasta = self.inputFiles("fa/test_chr22.fa")[0]
+        output_file = self.tempFile("observed-annotate-junctions-path.out")
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate.out")[0]
+        #An existing junctions file is not split into samples
+        junctions_dir = self.tempFile("a,b")
+        os.mkdir(junctions_dir)
+        junctions_copy = os.path.join(junctions_dir, "j.bed")
+        shutil.copy(junctions, junctions_copy)
+        params = ["junctions", "annotate", "-o", output_file, junctions_copy, fasta, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(expected_file, output_file)
+    def test_junctions_annotate_bam(self):
+        bam = self.inputFiles("bam/test_hcc1395.2.bam")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.gtf")[0]
+        fasta = self.inputFiles("fa/test_chr22.fa")[0]
+        output_file = self.tempFile("observed-annotate-bam.out")
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate-bam.out")[0]
+        params = ["junctions", "annotate", "-o", output_file, bam, fasta, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(expected_file, output_file)
+    def test_junctions_annotate_bam_multi_contig(self):
+        bam = self.inputFiles("bam/test_multi_contig.bam")[0]
+        gtf = self.inputFiles("gtf/test_multi_contig.gtf")[0]
+        fasta = self.inputFiles("fa/test_multi_contig.fa")[0]
+        junctions = self.tempFile("extracted-multi-contig.bed")
+        extracted_output = self.tempFile("observed-annotate-extracted-multi-contig.out")
+        output_file = self.tempFile("observed-annotate-bam-multi-contig.out")
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate-bam-multi-contig.out")[0]
+        #The header has chr1, chr2, chr10 - extract prints chr10 before chr2
+        params = ["junctions", "extract", "-o", junctions, bam]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        params = ["junctions", "annotate", "-o", extracted_output, junctions, fasta, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        params = ["junctions", "annotate", "-o", output_file, bam, fasta, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(extracted_output, output_file)
+        self.assertFilesEqual(expected_file, output_file)
+    def test_junctions_annotate_nearest_sites(self):
+        junctions = self.inputFiles("bed/test_hcc1395_junctions.bed")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.gtf")[0]
+        fasta = self.inputFiles("fa/test_chr22.fa")[0]
+        output_file = self.tempFile("observed-annotate-nearest-sites.out")
+        expected_file = self.inputFiles("junctions-annotate/expected-annotate-nearest-sites.out")[0]
+        params = ["junctions", "annotate", "-n", "-o", output_file, junctions, fasta, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0)
+        self.assertFilesEqual(expected_file, output_file)
+
 if __name__ == "__main__":
     main()
@@ -27,6 +27,7 @@ DEALINGS IN THE SOFTWARE.
 '''
 
 from integrationtest import IntegrationTest, main
+import gzip
 import unittest
 
 class TestAnnotate(IntegrationTest, unittest.TestCase):
@@ -115,6 +116,52 @@ class TestAnnotate(IntegrationTest, unittest.TestCase):
         rv, err = self.execute(params)
         self.assertEqual(rv, 0, err)
         self.assertFilesEqual(expected_file, output_file, err)
+    def test_variants_annotate_threads(self):
+        variants = self.inputFiles("vcf/test1.vcf")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.2.gtf")[0]
+        output_file = self.tempFile("observed-annotate.vcf")
+        expected_file = self.inputFiles("variants-annotate/expected-annotate-default.out")[0]
+        params = ["variants", "annotate", "-t", "3",
+                  "-o ", output_file, variants, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0, err)
+        self.assertFilesEqual(expected_file, output_file, err)
+    def test_variants_annotate_threads_regions(self):
+        variants = self.inputFiles("vcf/test1.vcf.gz")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.2.gtf")[0]
+        output_file = self.tempFile("observed-annotate.vcf.gz")
+        observed_file = self.tempFile("observed-annotate.vcf")
+        expected_file = self.inputFiles("variants-annotate/expected-annotate-default.out")[0]
+        params = ["variants", "annotate", "-t", "3",
+                  "-o ", output_file, variants, gtf]
+        rv, err = self.execute(params)
+        self.assertEqual(rv, 0, err)
+        #The regions are joined into one bgzipped VCF
+        with open(observed_file, "w") as observed:
+            observed.write(gzip.open(output_file).read())
+        self.assertFilesEqual(expected_file, observed_file, err)
+    def test_variants_annotate_threads_stale_shard(self):
+        #The records leave the region of the second shard empty, a
+        #file with its name from an earlier run is not joined
+        variants = self.inputFiles("vcf/test5.vcf.gz")[0]
+        gtf = self.inputFiles("gtf/test_ensemble_chr22.2.gtf")[0]
+        serial_file = self.tempFile("observed-annotate-serial.vcf.gz")
+        output_file = self.tempFile("observed-annotate-stale.vcf.gz")
+        expected_file = self.tempFile("expected-annotate-stale.vcf")
+        observed_file = self.tempFile("observed-annotate-stale.vcf")
+        with open(output_file + ".shard1", "wb") as stale:
+            stale.write(open(self.inputFiles("vcf/test1.vcf.gz")[0], "rb").read())
+        rv, err = self.execute(["variants", "annotate",
+                                "-o ", serial_file, variants, gtf])
+        self.assertEqual(rv, 0, err)
+        rv, err = self.execute(["variants", "annotate", "-t", "3",
+                                "-o ", output_file, variants, gtf])
+        self.assertEqual(rv, 0, err)
+        with open(expected_file, "w") as expected:
+            expected.write(gzip.open(serial_file).read())
+        with open(observed_file, "w") as observed:
+            observed.write(gzip.open(output_file).read())
+        self.assertFilesEqual(expected_file, observed_file, err)
 
 if __name__ == "__main__":
     main()
@@ -23,8 +23,12 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.  */
 
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "gtf_parser.h"
 
 class GtfParserTest : public ::testing::Test {
@@ -105,12 +109,21 @@ TEST_F(GtfParserTest, AddExonToTranscriptTest) {
               gp1.get_gene_from_transcript("ENST00000263253"));
     EXPECT_EQ("NA",
               gp1.get_gene_from_transcript("ENSTfake"));
-    gp1.annotate_transcript_with_bins();
-    EXPECT_EQ(37359u,
-              gp1.bin_from_transcript("ENST00000263253"));
-    std::vector<string> expected_transcript;
-    expected_transcript.push_back("ENST00000263253");
-    EXPECT_EQ(expected_transcript, gp1.transcripts_from_bin("22", 37359));
+    gp1.index_transcripts();
+    const ContigTranscripts * contig = gp1.contig_transcripts("22");
+    ASSERT_TRUE(contig != NULL);
+    const TranscriptIndex & index = contig->index();
+    ASSERT_EQ(1u, index.size());
+    EXPECT_EQ("ENST00000263253", contig->transcript_name(index.transcript(0)));
+    EXPECT_EQ("EP300", contig->gene_name(index.transcript(0)));
+    EXPECT_EQ(12791u, index.start(0));
+    EXPECT_EQ(14103u, index.end(0));
+    ExonView exons = contig->exons(index.transcript(0));
+    ASSERT_EQ(1u, exons.size());
+    EXPECT_EQ(STRAND_PLUS, exons.strand());
+    EXPECT_EQ(12791u, exons[0].start);
+    EXPECT_EQ(14103u, exons[0].end);
+    EXPECT_TRUE(gp1.contig_transcripts("fake_chr") == NULL);
 }
 
 //Test sorting of exons within a positive-strand transcript
@@ -272,3 +285,96 @@ TEST_F(GtfParserTest, SortExonTranscriptNsTest) {
     gp1.sort_exons_within_transcripts();
     EXPECT_EQ(expected_exons2, gp1.get_exons_from_transcript("ENST00000263253"));
 }
+
+//Lazily loaded contigs should match a full load, even when
+//the lines of a contig are not contiguous in the GTF
+TEST_F(GtfParserTest, LazyLoadTest) {
+    string gtf_file = "test_lazy_load.gtf";
+    ofstream out(gtf_file.c_str());
+    out << "#comment\n"
+        << "1\tt\texon\t300\t400\t.\t-\t.\tgene_name \"G1\"; transcript_id \"T1\";\n"
+        << "1\tt\tgene\t100\t400\t.\t-\t.\tgene_name \"G1\";\n"
+        << "2\tt\texon\t100\t200\t.\t+\t.\tgene_name \"G2\"; transcript_id \"T2\";\n"
+        << "1\tt\texon\t100\t200\t.\t-\t.\tgene_name \"G1\"; transcript_id \"T1\";\n"
+        << "3\tt\tgene\t100\t200\t.\t+\t.\tgene_name \"G3\";\n";
+    out.close();
+    GtfHandle eager = load_annotation(gtf_file);
+    GtfHandle lazy = load_annotation(gtf_file, true);
+    EXPECT_FALSE(eager->lazy());
+    EXPECT_TRUE(lazy->lazy());
+    const ContigTranscripts * contig = lazy->contig_transcripts("1");
+    ASSERT_TRUE(contig != NULL);
+    ASSERT_EQ(1u, contig->index().size());
+    EXPECT_EQ(100u, contig->index().start(0));
+    EXPECT_EQ(400u, contig->index().end(0));
+    EXPECT_EQ(eager->get_exons_from_transcript("T1"),
+              lazy->get_exons_from_transcript("T1"));
+    EXPECT_EQ(eager->get_exons_from_transcript("T2"),
+              lazy->get_exons_from_transcript("T2"));
+    EXPECT_EQ("G2", lazy->get_gene_from_transcript("T2"));
+    //Contigs without exons are treated as unknown
+    EXPECT_TRUE(lazy->contig_transcripts("3") == NULL);
+    EXPECT_TRUE(lazy->contig_transcripts("4") == NULL);
+    remove(gtf_file.c_str());
+}
+
+//A full load checks every line, a lazy load only the lines of the
+//contigs that are queried
+TEST_F(GtfParserTest, BadLineTest) {
+    string gtf_file = "test_bad_line.gtf";
+    ofstream out(gtf_file.c_str());
+    out << "1\tt\texon\t100\t200\t.\t+\t.\tgene_name \"G1\"; transcript_id \"T1\";\n"
+        << "2\tt\texon\t100\t200\t.\t+\tgene_name \"G2\"; transcript_id \"T2\";\n";
+    out.close();
+    EXPECT_THROW(load_annotation(gtf_file), runtime_error);
+    GtfHandle lazy = load_annotation(gtf_file, true);
+    EXPECT_TRUE(lazy->contig_transcripts("1") != NULL);
+    EXPECT_THROW(lazy->contig_transcripts("2"), runtime_error);
+    remove(gtf_file.c_str());
+}
+
+//A transcript lookup loads only the contig of the transcript
+TEST_F(GtfParserTest, LazyTranscriptLookupTest) {
+    string gtf_file = "test_lazy_lookup.gtf";
+    ofstream out(gtf_file.c_str());
+    out << "1\tt\texon\t100\t200\t.\t+\t.\tgene_name \"G1\"; transcript_id \"T1\";\n"
+        << "1\tt\texon\t300\t400\t.\t+\tgene_name \"G1\"; transcript_id \"T1\";\n"
+        << "2\tt\texon\t100\t200\t.\t+\t.\tgene_name \"G2\"; transcript_id \"T2\";\n";
+    out.close();
+    GtfHandle lazy = load_annotation(gtf_file, true);
+    EXPECT_EQ("G2", lazy->get_gene_from_transcript("T2"));
+    EXPECT_EQ(1u, lazy->get_exons_from_transcript("T2").size());
+    EXPECT_EQ("NA", lazy->get_gene_from_transcript("T3"));
+    EXPECT_TRUE(lazy->get_exons_from_transcript("T3").empty());
+    EXPECT_TRUE(lazy->contig_transcripts(2u) == NULL);
+    EXPECT_THROW(lazy->get_gene_from_transcript("T1"), runtime_error);
+    remove(gtf_file.c_str());
+}
+
+//A GTF whose path has ',' or '=' is a single source, a list
+//of name=file.gtf is split into named sources
+TEST_F(GtfParserTest, AnnotationSourcesTest) {
+    string dir = "run=1,2";
+    string gtf_file1 = dir + "/g.gtf";
+    string gtf_file2 = "test_sources.gtf";
+    mkdir(dir.c_str(), 0755);
+    ofstream out1(gtf_file1.c_str());
+    out1 << "1\tt\texon\t100\t200\t.\t+\t.\tgene_name \"G1\"; transcript_id \"T1\";\n";
+    out1.close();
+    ofstream out2(gtf_file2.c_str());
+    out2 << "1\tt\texon\t100\t200\t.\t+\t.\tgene_name \"G2\"; transcript_id \"T2\";\n";
+    out2.close();
+    AnnotationSources single = load_annotation_sources(gtf_file1);
+    ASSERT_EQ(1u, single.size());
+    EXPECT_EQ("g", single[0].name);
+    EXPECT_EQ("G1", single[0].gtf->get_gene_from_transcript("T1"));
+    AnnotationSources named = load_annotation_sources("a=" + gtf_file2 +
+                                                      ",b=" + gtf_file2);
+    ASSERT_EQ(2u, named.size());
+    EXPECT_EQ("a", named[0].name);
+    EXPECT_EQ("b", named[1].name);
+    EXPECT_EQ("G2", named[1].gtf->get_gene_from_transcript("T2"));
+    remove(gtf_file1.c_str());
+    remove(gtf_file2.c_str());
+    rmdir(dir.c_str());
+}
@@ -0,0 +1,119 @@
+/*  test_splice_graph.cc -- Unit-tests for the SpliceGraph class
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <gtest/gtest.h>
+#include "splice_graph.h"
+#include "transcript_store.h"
+
+class SpliceGraphTest : public ::testing::Test {
+    public:
+        SpliceGraph graph1;
+        //Add a transcript from its exons, first to last
+        void add(uint32_t transcript, const CHRPOS *starts,
+                 const CHRPOS *ends, uint32_t n, Strand strand) {
+            graph1.add_transcript(transcript,
+                                  ExonView(starts, ends, n, strand));
+        }
+        //Count the skipped exons with the given transcripts overlapping
+        SkippedCounts count(const vector<uint32_t> &transcripts,
+                            CHRPOS start, CHRPOS end) {
+            SkippedCounts counts;
+            uint32_t locus = graph1.locus(transcripts[0]);
+            vector<uint64_t> bits(graph1.locus_data(locus).words, 0);
+            for(size_t i = 0; i < transcripts.size(); i++) {
+                uint32_t bit = graph1.bit(transcripts[i]);
+                bits[bit / 64] |= (uint64_t) 1 << (bit % 64);
+            }
+            graph1.count_skipped(locus, bits, start, end, counts);
+            return counts;
+        }
+};
+
+//Overlapping transcripts share a locus, others get their own
+TEST_F(SpliceGraphTest, Loci) {
+    CHRPOS starts1[] = {100, 300}, ends1[] = {200, 400};
+    CHRPOS starts2[] = {350, 500}, ends2[] = {370, 600};
+    CHRPOS starts3[] = {1000, 1200}, ends3[] = {1100, 1300};
+    add(0, starts1, ends1, 2, STRAND_PLUS);
+    add(1, starts2, ends2, 2, STRAND_PLUS);
+    add(2, starts3, ends3, 2, STRAND_PLUS);
+    graph1.build(3);
+    ASSERT_EQ(2u, graph1.n_loci());
+    EXPECT_EQ(graph1.locus(0), graph1.locus(1));
+    EXPECT_NE(graph1.locus(0), graph1.locus(2));
+    EXPECT_NE(graph1.bit(0), graph1.bit(1));
+    EXPECT_TRUE(graph1.locus_data(graph1.locus(0)).regular);
+}
+
+//Positions used by several transcripts are counted once, and the
+//donor exon of the annotated intron is not skipped
+TEST_F(SpliceGraphTest, CountSkippedPositiveStrand) {
+    CHRPOS starts1[] = {100, 300, 500}, ends1[] = {200, 400, 600};
+    CHRPOS starts2[] = {100, 500}, ends2[] = {200, 600};
+    add(0, starts1, ends1, 3, STRAND_PLUS);
+    add(1, starts2, ends2, 2, STRAND_PLUS);
+    graph1.build(2);
+    vector<uint32_t> both;
+    both.push_back(0);
+    both.push_back(1);
+    //Exon skipping junction, the end at 200 still counts
+    //since transcript 0 does not splice 200-500
+    SkippedCounts counts = count(both, 200, 500);
+    EXPECT_EQ(2u, counts.starts);
+    EXPECT_EQ(2u, counts.ends);
+    EXPECT_TRUE(counts.exon);
+    //Transcript 1 splices 200-500, its exon ending at 200 is the donor
+    vector<uint32_t> second;
+    second.push_back(1);
+    counts = count(second, 200, 500);
+    EXPECT_EQ(1u, counts.starts);
+    EXPECT_EQ(0u, counts.ends);
+    EXPECT_FALSE(counts.exon);
+    //Nothing inside the intron
+    counts = count(both, 201, 299);
+    EXPECT_EQ(0u, counts.starts);
+    EXPECT_EQ(0u, counts.ends);
+    EXPECT_FALSE(counts.exon);
+}
+
+//On the negative strand the donor exon starts at the junction end
+TEST_F(SpliceGraphTest, CountSkippedNegativeStrand) {
+    CHRPOS starts1[] = {500, 100}, ends1[] = {600, 200};
+    add(0, starts1, ends1, 2, STRAND_MINUS);
+    graph1.build(1);
+    vector<uint32_t> first;
+    first.push_back(0);
+    SkippedCounts counts = count(first, 200, 500);
+    EXPECT_EQ(0u, counts.starts);
+    EXPECT_EQ(1u, counts.ends);
+    EXPECT_FALSE(counts.exon);
+}
+
+//Transcripts with overlapping exons make the locus irregular
+TEST_F(SpliceGraphTest, IrregularLocus) {
+    CHRPOS starts1[] = {100, 150}, ends1[] = {300, 400};
+    add(0, starts1, ends1, 2, STRAND_PLUS);
+    graph1.build(1);
+    EXPECT_FALSE(graph1.locus_data(graph1.locus(0)).regular);
+}
@@ -0,0 +1,104 @@
+/*  test_splice_sites.cc -- Unit-tests for the SpliceSites class
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <gtest/gtest.h>
+#include "splice_sites.h"
+#include "transcript_store.h"
+
+class SpliceSitesTest : public ::testing::Test {
+    public:
+        SpliceSites sites1;
+        //Add a transcript from its exons, first to last
+        void add(const CHRPOS *starts, const CHRPOS *ends,
+                 uint32_t n, Strand strand) {
+            sites1.add_transcript(ExonView(starts, ends, n, strand));
+        }
+};
+
+//Exon boundaries and introns of a positive strand transcript
+TEST_F(SpliceSitesTest, PositiveStrand) {
+    CHRPOS starts[] = {100, 300, 500};
+    CHRPOS ends[] = {200, 400, 600};
+    add(starts, ends, 3, STRAND_PLUS);
+    sites1.build();
+    EXPECT_TRUE(sites1.has_exon_end(200, false));
+    EXPECT_TRUE(sites1.has_exon_end(600, false));
+    EXPECT_TRUE(sites1.has_exon_start(100, false));
+    EXPECT_TRUE(sites1.has_exon_start(500, false));
+    EXPECT_FALSE(sites1.has_exon_start(200, false));
+    EXPECT_TRUE(sites1.has_intron(200, 300));
+    EXPECT_TRUE(sites1.has_intron(400, 500));
+    EXPECT_FALSE(sites1.has_intron(200, 500));
+}
+
+//Introns of a negative strand transcript are stored left to right
+TEST_F(SpliceSitesTest, NegativeStrand) {
+    CHRPOS starts[] = {500, 300, 100};
+    CHRPOS ends[] = {600, 400, 200};
+    add(starts, ends, 3, STRAND_MINUS);
+    sites1.build();
+    EXPECT_TRUE(sites1.has_intron(200, 300));
+    EXPECT_TRUE(sites1.has_intron(400, 500));
+    EXPECT_FALSE(sites1.has_intron(300, 200));
+}
+
+//Single exon transcripts only count when asked for
+TEST_F(SpliceSitesTest, SingleExon) {
+    CHRPOS starts[] = {1000};
+    CHRPOS ends[] = {2000};
+    add(starts, ends, 1, STRAND_PLUS);
+    sites1.build();
+    EXPECT_FALSE(sites1.has_exon_start(1000, false));
+    EXPECT_TRUE(sites1.has_exon_start(1000, true));
+    EXPECT_FALSE(sites1.has_exon_end(2000, false));
+    EXPECT_TRUE(sites1.has_exon_end(2000, true));
+}
+
+//The closest intron ends to a position, before or after it
+TEST_F(SpliceSitesTest, Nearest) {
+    int64_t distance;
+    EXPECT_FALSE(sites1.nearest_intron_left(200, distance));
+    CHRPOS starts[] = {100, 300, 500};
+    CHRPOS ends[] = {200, 400, 600};
+    add(starts, ends, 3, STRAND_PLUS);
+    sites1.build();
+    ASSERT_TRUE(sites1.nearest_intron_left(200, distance));
+    EXPECT_EQ(0, distance);
+    ASSERT_TRUE(sites1.nearest_intron_left(210, distance));
+    EXPECT_EQ(10, distance);
+    ASSERT_TRUE(sites1.nearest_intron_left(390, distance));
+    EXPECT_EQ(-10, distance);
+    ASSERT_TRUE(sites1.nearest_intron_left(50, distance));
+    EXPECT_EQ(-150, distance);
+    //The last exon end is not an intron end
+    ASSERT_TRUE(sites1.nearest_intron_left(700, distance));
+    EXPECT_EQ(300, distance);
+    //Ties go to the intron end before the position
+    ASSERT_TRUE(sites1.nearest_intron_left(300, distance));
+    EXPECT_EQ(100, distance);
+    ASSERT_TRUE(sites1.nearest_intron_right(480, distance));
+    EXPECT_EQ(-20, distance);
+    ASSERT_TRUE(sites1.nearest_intron_right(100, distance));
+    EXPECT_EQ(-200, distance);
+}
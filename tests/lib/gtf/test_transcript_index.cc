@@ -0,0 +1,155 @@
+/*  test_transcript_index.cc -- Unit-tests for the TranscriptIndex class
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <gtest/gtest.h>
+#include "transcript_index.h"
+
+class TranscriptIndexTest : public ::testing::Test {
+    public:
+        TranscriptIndex index1;
+        //Collect the entries that overlap [start, end]
+        vector<uint32_t> query(CHRPOS start, CHRPOS end) {
+            vector<uint32_t> hits;
+            size_t first, last;
+            index1.overlap(start, end, first, last);
+            for(size_t i = first; i < last; i++) {
+                if(index1.overlaps(i, start, end))
+                    hits.push_back(index1.transcript(i));
+            }
+            return hits;
+        }
+        //Collect the entries that overlap [start, end] with a sweep
+        vector<uint32_t> sweep_query(TranscriptSweep &sweep, CHRPOS floor,
+                                     CHRPOS start, CHRPOS end) {
+            vector<uint32_t> hits;
+            if(!sweep.advance(index1, floor, end))
+                return query(start, end);
+            for(size_t i = 0; i < sweep.active().size(); i++) {
+                size_t entry = sweep.active()[i];
+                if(index1.overlaps(entry, start, end))
+                    hits.push_back(index1.transcript(entry));
+            }
+            return hits;
+        }
+};
+
+//Entries are ordered by start irrespective of insertion order
+TEST_F(TranscriptIndexTest, BuildSortsByStart) {
+    index1.add(500, 600, 3);
+    index1.add(100, 1000, 1);
+    index1.add(200, 300, 2);
+    index1.build();
+    ASSERT_EQ(3u, index1.size());
+    EXPECT_EQ(1u, index1.transcript(0));
+    EXPECT_EQ(2u, index1.transcript(1));
+    EXPECT_EQ(3u, index1.transcript(2));
+}
+
+//A long transcript keeps the range open for shorter ones after it
+TEST_F(TranscriptIndexTest, OverlapQuery) {
+    index1.add(100, 1000, 1);
+    index1.add(200, 300, 2);
+    index1.add(500, 600, 3);
+    index1.add(2000, 3000, 4);
+    index1.build();
+    vector<uint32_t> expected;
+    expected.push_back(1);
+    expected.push_back(3);
+    EXPECT_EQ(expected, query(400, 550));
+    //Closed intervals - touching ends overlap
+    expected.clear();
+    expected.push_back(1);
+    expected.push_back(2);
+    EXPECT_EQ(expected, query(300, 300));
+    expected.clear();
+    expected.push_back(4);
+    EXPECT_EQ(expected, query(1500, 2000));
+    EXPECT_TRUE(query(1001, 1999).empty());
+    EXPECT_TRUE(query(3001, 4000).empty());
+    EXPECT_TRUE(query(1, 99).empty());
+}
+
+//Querying an empty index returns an empty range
+TEST_F(TranscriptIndexTest, EmptyIndex) {
+    size_t first = 1, last = 1;
+    index1.overlap(10, 20, first, last);
+    EXPECT_EQ(first, last);
+}
+
+//Coordinates past 512Mb, the limit of the UCSC binning scheme
+TEST_F(TranscriptIndexTest, LongContig) {
+    index1.add(536870000, 536880000, 1);
+    index1.add(3000000000U, 3000001000U, 2);
+    index1.build();
+    vector<uint32_t> expected;
+    expected.push_back(1);
+    EXPECT_EQ(expected, query(536870912, 536870912));
+    expected.clear();
+    expected.push_back(2);
+    EXPECT_EQ(expected, query(3000000500U, 3000002000U));
+    EXPECT_TRUE(query(600000000, 2999999999U).empty());
+}
+
+//A sweep over sorted queries finds the same entries as the index
+//and keeps only the entries that can still overlap
+TEST_F(TranscriptIndexTest, SweepSortedQueries) {
+    index1.add(100, 1000, 1);
+    index1.add(200, 300, 2);
+    index1.add(500, 600, 3);
+    index1.add(2000, 3000, 4);
+    index1.build();
+    TranscriptSweep sweep;
+    CHRPOS queries[][3] = {{150, 160, 250}, {250, 290, 550},
+                           {300, 400, 550}, {350, 1500, 2500},
+                           {1500, 1600, 1700}, {2500, 2600, 4000},
+                           {3500, 3600, 3700}};
+    for(size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        EXPECT_EQ(query(queries[i][1], queries[i][2]),
+                  sweep_query(sweep, queries[i][0],
+                              queries[i][1], queries[i][2]));
+    }
+    //Everything has ended before the last floor
+    EXPECT_TRUE(sweep.advance(index1, 3500, 3700));
+    EXPECT_TRUE(sweep.active().empty());
+}
+
+//Queries that go backwards turn the sweep off
+TEST_F(TranscriptIndexTest, SweepUnsortedQueries) {
+    index1.add(100, 1000, 1);
+    index1.add(2000, 3000, 2);
+    index1.build();
+    TranscriptSweep sweep;
+    EXPECT_TRUE(sweep.advance(index1, 2500, 2600));
+    EXPECT_FALSE(sweep.advance(index1, 200, 300));
+    //Off for good, even for sorted queries after
+    EXPECT_FALSE(sweep.advance(index1, 2600, 2700));
+    //Coming back to an index is also out of order
+    TranscriptIndex index2;
+    index2.add(10, 20, 1);
+    index2.build();
+    TranscriptSweep sweep2;
+    EXPECT_TRUE(sweep2.advance(index1, 10, 20));
+    EXPECT_TRUE(sweep2.advance(index2, 10, 20));
+    EXPECT_FALSE(sweep2.advance(index1, 30, 40));
+}
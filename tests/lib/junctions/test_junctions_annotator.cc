@@ -23,9 +23,15 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.  */
 
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "junctions_annotator.h"
+#include "junctions_cohort.h"
+#include "junctions_pipeline.h"
 
 class JunctionsAnnotatorTest : public ::testing::Test {
     public:
@@ -43,3 +49,244 @@ TEST_F(JunctionsAnnotatorTest, ParseInput) {
     ASSERT_EQ(expected_gtf, ja1.gtf_file());
     ASSERT_EQ(0, ret);
 }
+
+//Bases sliced from the reference windows match fai_fetch, both for
+//sorted input and after the junctions go back to an earlier contig
+TEST_F(JunctionsAnnotatorTest, ReferenceSequence) {
+    string fa_file = "test_reference_sequence.fa";
+    ofstream out(fa_file.c_str());
+    out << ">1\nACGTACGTAC\nGGTTA\n"
+        << ">2\nTTTTGGGGCC\nCCAA\n";
+    out.close();
+    remove((fa_file + ".fai").c_str());
+    int argc = 4;
+    char * argv[] = {"annotate",
+                     "test.bed",
+                     (char *) fa_file.c_str(),
+                     "test.gtf"};
+    JunctionsAnnotator ja2;
+    ja2.parse_options(argc, argv);
+    EXPECT_EQ("CGTA", ja2.get_reference_sequence("1", 2, 5));
+    EXPECT_EQ(ja2.get_reference_sequence("1:9-12"),
+              ja2.get_reference_sequence("1", 9, 12));
+    //Clipped at the end of the contig
+    EXPECT_EQ("TA", ja2.get_reference_sequence("1", 14, 20));
+    EXPECT_EQ("", ja2.get_reference_sequence("1", 16, 17));
+    EXPECT_EQ("GGCC", ja2.get_reference_sequence("2", 7, 10));
+    //Back on contig 1, read from the FASTA
+    EXPECT_EQ("CGTA", ja2.get_reference_sequence("1", 2, 5));
+    EXPECT_EQ("CCAA", ja2.get_reference_sequence("2", 11, 14));
+    EXPECT_THROW(ja2.get_reference_sequence("3", 1, 2), std::runtime_error);
+    remove(fa_file.c_str());
+    remove((fa_file + ".fai").c_str());
+}
+
+//A contig longer than the reference windows, lookups in and across
+//windows match fai_fetch
+TEST_F(JunctionsAnnotatorTest, ReferenceSequenceWindows) {
+    string fa_file = "test_reference_windows.fa";
+    const char bases[] = "ACGT";
+    CHRPOS len = 3 * ReferenceWindow::kSize + 17;
+    ofstream out(fa_file.c_str());
+    out << ">1\n";
+    for(CHRPOS i = 0; i < len; i++) {
+        out << bases[(i * 7 + i / 5) % 4];
+        if(i % 60 == 59)
+            out << "\n";
+    }
+    out << "\n";
+    out.close();
+    remove((fa_file + ".fai").c_str());
+    int argc = 4;
+    char * argv[] = {"annotate",
+                     "test.bed",
+                     (char *) fa_file.c_str(),
+                     "test.gtf"};
+    JunctionsAnnotator ja2;
+    ja2.parse_options(argc, argv);
+    CHRPOS starts[] = {1, 100, 2 * ReferenceWindow::kSize - 1,
+                       ReferenceWindow::kSize - 3, 5,
+                       len - 2, 3 * ReferenceWindow::kSize};
+    for(size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        CHRPOS end = starts[i] + 3;
+        EXPECT_EQ(ja2.get_reference_sequence("1:" +
+                                             common::num_to_str(starts[i]) +
+                                             "-" + common::num_to_str(end)),
+                  ja2.get_reference_sequence("1", starts[i], end));
+    }
+    //Wider than a window, read directly
+    EXPECT_EQ(ja2.get_reference_sequence("1:10-" +
+                  common::num_to_str(ReferenceWindow::kSize + 20)),
+              ja2.get_reference_sequence("1", 10,
+                                         ReferenceWindow::kSize + 20));
+    remove(fa_file.c_str());
+    remove((fa_file + ".fai").c_str());
+}
+
+//Overlapping transcripts and their genes print sorted by name and
+//without repeats, also past the IDs held inline
+TEST_F(JunctionsAnnotatorTest, TranscriptOverlap) {
+    ContigTranscripts contig("1");
+    const char *transcripts[] = {"T9", "T1", "T5", "T3", "T7", "T2",
+                                 "T8", "T4", "T6", "T10"};
+    for(size_t i = 0; i < 10; i++) {
+        contig.add_exon(transcripts[i], i % 2 ? "GB" : "GA", STRAND_PLUS,
+                        100, 200);
+    }
+    contig.build_index();
+    TranscriptOverlap overlap;
+    stringstream empty;
+    overlap.print_genes(empty);
+    overlap.print_transcripts(empty);
+    EXPECT_EQ("NANA", empty.str());
+    uint32_t id;
+    ASSERT_TRUE(contig.find_transcript("T5", id));
+    overlap.add(contig, id);
+    overlap.add(contig, id);
+    stringstream one;
+    overlap.print_genes(one);
+    one << "\t";
+    overlap.print_transcripts(one);
+    EXPECT_EQ("GA\tT5", one.str());
+    for(size_t i = 0; i < 10; i++) {
+        ASSERT_TRUE(contig.find_transcript(transcripts[i], id));
+        overlap.add(contig, id);
+    }
+    stringstream all;
+    overlap.print_genes(all);
+    all << "\t";
+    overlap.print_transcripts(all);
+    EXPECT_EQ("GA,GB\tT1,T10,T2,T3,T4,T5,T6,T7,T8,T9", all.str());
+    overlap.clear();
+    stringstream cleared;
+    overlap.print_transcripts(cleared);
+    EXPECT_EQ("NA", cleared.str());
+}
+
+//Every overlapping transcript on the strand of the junction is
+//listed once the junction has a known donor or acceptor, whatever
+//the order the transcripts are visited in. TB shares no end with
+//the junction and is visited before TZ, which knows both ends.
+//Single exon transcripts are left out without -E.
+TEST_F(JunctionsAnnotatorTest, OverlapMembership) {
+    string gtf_file = "test_overlap_membership.gtf";
+    ofstream out(gtf_file.c_str());
+    const char *exons[] = {
+        "100\t200\t+\tGZ\tTZ",
+        "250\t260\t+\tGZ\tTZ",
+        "400\t500\t+\tGZ\tTZ",
+        "150\t180\t+\tGB\tTB",
+        "450\t600\t+\tGB\tTB",
+        "100\t200\t-\tGM\tTM",
+        "400\t500\t-\tGM\tTM",
+        "300\t350\t+\tGS\tTS"
+    };
+    for(size_t i = 0; i < 8; i++) {
+        vector<string> f;
+        Tokenize(exons[i], f, '\t');
+        out << "1\tt\texon\t" << f[0] << "\t" << f[1] << "\t.\t" <<
+               f[2] << "\t.\tgene_id \"" << f[3] << "\"; transcript_id \"" <<
+               f[4] << "\"; gene_name \"" << f[3] << "\";\n";
+    }
+    out.close();
+    JunctionsAnnotator ja2("NA", load_annotation(gtf_file));
+    const CHRPOS ends[][2] = {{200, 400}, {170, 430}};
+    const char *expected[] = {"NDA\tGB,GZ\tTB,TZ", "N\tNA\tNA"};
+    for(size_t i = 0; i < 2; i++) {
+        AnnotatedJunction junction("1", ends[i][0], ends[i][1]);
+        junction.strand = "+";
+        ja2.annotate_junction_with_gtf(junction);
+        stringstream columns;
+        columns << junction.anchor << "\t";
+        junction.overlap.print_genes(columns);
+        columns << "\t";
+        junction.overlap.print_transcripts(columns);
+        EXPECT_EQ(expected[i], columns.str());
+    }
+    remove(gtf_file.c_str());
+}
+
+//Output that fails with an exception other than runtime_error
+class ThrowingBuffer : public streambuf {
+    protected:
+        int overflow(int) {
+            throw logic_error("write failed");
+        }
+};
+
+//A failure in the reader thread or while printing reaches the caller
+//of run() as the exception that was thrown
+TEST_F(JunctionsAnnotatorTest, PipelineFailure) {
+    string gtf_file = "test_pipeline.gtf";
+    string fa_file = "test_pipeline.fa";
+    string bed_file = "test_pipeline.bed";
+    ofstream gtf(gtf_file.c_str());
+    gtf << "1\tt\texon\t2\t4\t.\t+\t.\tgene_id \"G\"; "
+           "transcript_id \"T\";\n";
+    gtf.close();
+    ofstream fa(fa_file.c_str());
+    fa << ">1\nACGTACGTACGTACGTACGT\n";
+    fa.close();
+    remove((fa_file + ".fai").c_str());
+    char * argv[] = {"annotate",
+                     (char *) bed_file.c_str(),
+                     (char *) fa_file.c_str(),
+                     (char *) gtf_file.c_str()};
+    ofstream bed(bed_file.c_str());
+    bed << "1\t2\t14\tJ1\t5\t+\t2\t14\t255,0,0\t2\t2,2\t0,10\n";
+    bed << "1\tnot a junction\n";
+    bed.close();
+    JunctionsAnnotator reader;
+    reader.parse_options(4, argv);
+    reader.load_gtf();
+    reader.open_junctions();
+    stringstream out;
+    EXPECT_THROW(JunctionsPipeline(reader, 2).run(out), runtime_error);
+    reader.close_junctions();
+
+    bed.open(bed_file.c_str());
+    bed << "1\t2\t14\tJ1\t5\t+\t2\t14\t255,0,0\t2\t2,2\t0,10\n";
+    bed.close();
+    JunctionsAnnotator reader2;
+    reader2.parse_options(4, argv);
+    reader2.load_gtf();
+    reader2.open_junctions();
+    ThrowingBuffer buffer;
+    ostream failing(&buffer);
+    failing.exceptions(ios::badbit);
+    EXPECT_THROW(JunctionsPipeline(reader2, 2).run(failing), logic_error);
+    reader2.close_junctions();
+    remove(gtf_file.c_str());
+    remove(fa_file.c_str());
+    remove((fa_file + ".fai").c_str());
+    remove(bed_file.c_str());
+}
+
+//A junctions file whose path has ',' is a single sample, a list of
+//name=junctions.bed is split into named samples
+TEST_F(JunctionsAnnotatorTest, JunctionSamples) {
+    string dir = "a,b";
+    string bed_file = dir + "/j.bed";
+    mkdir(dir.c_str(), 0755);
+    ofstream out(bed_file.c_str());
+    out.close();
+    vector<JunctionSample> single = parse_junction_samples(bed_file);
+    ASSERT_EQ(1u, single.size());
+    EXPECT_EQ("j", single[0].name);
+    EXPECT_EQ(bed_file, single[0].bed);
+    vector<JunctionSample> named = parse_junction_samples("s1=x.bed,s2=y.bed");
+    ASSERT_EQ(2u, named.size());
+    EXPECT_EQ("s1", named[0].name);
+    EXPECT_EQ("y.bed", named[1].bed);
+    remove(bed_file.c_str());
+    rmdir(dir.c_str());
+}
+
+//The cohort reads every file twice, stdin is rejected before
+//anything is read from it
+TEST_F(JunctionsAnnotatorTest, CohortRejectsStdin) {
+    vector<JunctionSample> samples = parse_junction_samples("s1=x.bed,s2=-");
+    ASSERT_EQ(2u, samples.size());
+    JunctionsCohort cohort(ja1, samples);
+    EXPECT_THROW(cohort.annotate(), runtime_error);
+}
@@ -0,0 +1,186 @@
+/*  test_junctions_reader.cc -- Unit-tests for the JunctionsReader class
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <zlib.h>
+#include "htslib/bgzf.h"
+#include "htslib/tbx.h"
+#include "junctions_annotator.h"
+#include "junctions_reader.h"
+
+class JunctionsReaderTest : public ::testing::Test {
+    public:
+        string bed_file;
+        JunctionsReader reader1;
+        void SetUp() {
+            bed_file = "test_junctions_reader.bed";
+        }
+        void TearDown() {
+            reader1.close();
+            remove(bed_file.c_str());
+            remove((bed_file + ".tbi").c_str());
+        }
+        //Write lines to a bgzipped BED with a tabix index
+        void write_indexed(const string &lines) {
+            BGZF *out = bgzf_open(bed_file.c_str(), "w");
+            bgzf_write(out, lines.c_str(), lines.size());
+            bgzf_close(out);
+            ASSERT_EQ(0, tbx_index_build(bed_file.c_str(), 0, &tbx_conf_bed));
+        }
+        //Names of the junctions read
+        string read_names() {
+            AnnotatedJunction j1;
+            string names;
+            while(reader1.next(j1)) {
+                names += j1.name + " ";
+            }
+            return names;
+        }
+        string lines() {
+            return "track name=junctions\n"
+                   "#comment\n"
+                   "1\t100\t400\tJUNC1\t7\t+\t100\t400\t255,0,0\t2\t10,20\t0,280\n"
+                   "\n"
+                   "2\t50\t90\tJUNC2\t3\t-\t50\t90\t255,0,0\t2\t5,6,\t0,34,\r\n"
+                   "2\t60\t99\tJUNC3\t1\t?\t60\t99\t255,0,0\t2\t1,2\t0,37";
+        }
+        void check_junctions() {
+            AnnotatedJunction j1;
+            ASSERT_TRUE(reader1.next(j1));
+            EXPECT_EQ("1", j1.chrom);
+            EXPECT_EQ(100u, j1.start);
+            EXPECT_EQ(400u, j1.end);
+            EXPECT_EQ("JUNC1", j1.name);
+            EXPECT_EQ("7", j1.score);
+            EXPECT_EQ("+", j1.strand);
+            EXPECT_EQ(10u, j1.block_size1);
+            EXPECT_EQ(20u, j1.block_size2);
+            ASSERT_TRUE(reader1.next(j1));
+            EXPECT_EQ("2", j1.chrom);
+            EXPECT_EQ("JUNC2", j1.name);
+            EXPECT_EQ("-", j1.strand);
+            EXPECT_EQ(5u, j1.block_size1);
+            EXPECT_EQ(6u, j1.block_size2);
+            ASSERT_TRUE(reader1.next(j1));
+            EXPECT_EQ("JUNC3", j1.name);
+            EXPECT_EQ(99u, j1.end);
+            EXPECT_EQ(2u, j1.block_size2);
+            EXPECT_FALSE(reader1.next(j1));
+            EXPECT_FALSE(reader1.next(j1));
+        }
+};
+
+//Header, comment and blank lines are skipped, CRLF line ends and a
+//missing newline at the end are accepted
+TEST_F(JunctionsReaderTest, Plain) {
+    ofstream out(bed_file.c_str());
+    out << lines();
+    out.close();
+    reader1.open(bed_file);
+    check_junctions();
+}
+
+//Gzipped files are read the same as plain ones
+TEST_F(JunctionsReaderTest, Gzipped) {
+    gzFile out = gzopen(bed_file.c_str(), "w");
+    gzwrite(out, lines().c_str(), lines().size());
+    gzclose(out);
+    reader1.open(bed_file);
+    check_junctions();
+}
+
+//Lines that are not BED12 are errors
+TEST_F(JunctionsReaderTest, NotBed12) {
+    AnnotatedJunction j1;
+    ofstream out(bed_file.c_str());
+    out << "1\t100\t400\tJUNC1\t7\t+\n";
+    out << "1\t100\t400\tJUNC1\t7\t+\t100\t400\t255,0,0\t2\t10\t0\n";
+    out << "1\t1x0\t400\tJUNC1\t7\t+\t100\t400\t255,0,0\t2\t10,20\t0,280\n";
+    out.close();
+    reader1.open(bed_file);
+    EXPECT_THROW(reader1.next(j1), runtime_error);
+    EXPECT_THROW(reader1.next(j1), runtime_error);
+    EXPECT_THROW(reader1.next(j1), runtime_error);
+    EXPECT_EQ(3u, reader1.line_num());
+    EXPECT_THROW(reader1.open("test_junctions_reader_missing.bed"),
+                 runtime_error);
+}
+
+//Regions are one based and closed, stored zero based and half open
+TEST_F(JunctionsReaderTest, ParseRegion) {
+    JunctionRegion region = parse_junction_region("chr1:101-200");
+    EXPECT_EQ("chr1", region.chrom);
+    EXPECT_EQ(100, region.start);
+    EXPECT_EQ(200, region.end);
+    region = parse_junction_region("chr2");
+    EXPECT_EQ("chr2", region.chrom);
+    EXPECT_EQ(0, region.start);
+    EXPECT_EQ(INT64_MAX, region.end);
+    //Past 2^31 and 2^32
+    region = parse_junction_region("chr3:3,000,000,001-5000000000");
+    EXPECT_EQ("chr3", region.chrom);
+    EXPECT_EQ(3000000000LL, region.start);
+    EXPECT_EQ(5000000000LL, region.end);
+    EXPECT_EQ("chr3:3000000001-5000000000",
+              common::create_region_string("chr3", region.start + 1,
+                                           region.end));
+    EXPECT_THROW(parse_junction_region(":1-100"), runtime_error);
+    EXPECT_THROW(parse_junction_region("chr1:200-100"), runtime_error);
+    EXPECT_THROW(parse_junction_region("chr1:100+200"), runtime_error);
+}
+
+//Only the lines that overlap the regions are read, once each and in
+//the order of the file
+TEST_F(JunctionsReaderTest, Regions) {
+    bed_file = "test_junctions_reader.bed.gz";
+    write_indexed(
+        "1\t100\t400\tJ1\t1\t+\t100\t400\t255,0,0\t2\t10,20\t0,280\n"
+        "1\t300\t900\tJ2\t1\t+\t300\t900\t255,0,0\t2\t10,20\t0,580\n"
+        "1\t1000\t1200\tJ3\t1\t+\t1000\t1200\t255,0,0\t2\t10,20\t0,180\n"
+        "2\t100\t400\tJ4\t1\t+\t100\t400\t255,0,0\t2\t10,20\t0,280\n");
+    vector<JunctionRegion> regions;
+    regions.push_back(parse_junction_region("1:350-360"));
+    reader1.open(bed_file, regions);
+    EXPECT_EQ("J1 J2 ", read_names());
+    regions.clear();
+    regions.push_back(parse_junction_region("2:1-1000"));
+    regions.push_back(parse_junction_region("1:850-950"));
+    regions.push_back(parse_junction_region("1:50-120"));
+    regions.push_back(parse_junction_region("3:1-1000"));
+    reader1.open(bed_file, regions);
+    EXPECT_EQ("J1 J2 J4 ", read_names());
+    //Lines that overlap two regions are read once
+    regions.clear();
+    regions.push_back(parse_junction_region("1:380-390"));
+    regions.push_back(parse_junction_region("1:350-360"));
+    regions.push_back(parse_junction_region("1:1100-1110"));
+    reader1.open(bed_file, regions);
+    EXPECT_EQ("J1 J2 J3 ", read_names());
+    reader1.close();
+    remove((bed_file + ".tbi").c_str());
+    EXPECT_THROW(reader1.open(bed_file, regions), runtime_error);
+}
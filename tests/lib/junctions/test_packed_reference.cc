@@ -0,0 +1,98 @@
+/*  test_packed_reference.cc -- Unit-tests for the PackedReference class
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "common.h"
+#include "packed_reference.h"
+
+class PackedReferenceTest : public ::testing::Test {
+    public:
+        string fa_file;
+        PackedReference ref1;
+        void SetUp() {
+            fa_file = "test_packed_reference.fa";
+            ofstream out(fa_file.c_str());
+            out << ">1 first contig\nACGTacgtNN\nnnGGTTRA\n"
+                << ">2\nTTTTG\n";
+            out.close();
+            remove((fa_file + ".fai").c_str());
+            remove(PackedReference::packed_file(fa_file).c_str());
+        }
+        void TearDown() {
+            ref1.close();
+            remove(fa_file.c_str());
+            remove((fa_file + ".fai").c_str());
+            remove(PackedReference::packed_file(fa_file).c_str());
+        }
+};
+
+//The bases read back from the packed copy, including Ns and
+//soft-masked bases. IUPAC codes other than N read back as N.
+TEST_F(PackedReferenceTest, Sequence) {
+    ref1.open(fa_file);
+    ASSERT_TRUE(ref1.is_open());
+    uint32_t contig1, contig2, contig3;
+    ASSERT_TRUE(ref1.find_contig("1", contig1));
+    ASSERT_TRUE(ref1.find_contig("2", contig2));
+    EXPECT_FALSE(ref1.find_contig("3", contig3));
+    EXPECT_EQ(18u, ref1.length(contig1));
+    EXPECT_EQ(5u, ref1.length(contig2));
+    EXPECT_EQ("ACGTacgtNNnnGGTTNA", ref1.sequence(contig1, 0, 18));
+    EXPECT_EQ("tNNn", ref1.sequence(contig1, 7, 11));
+    EXPECT_EQ("TTTTG", ref1.sequence(contig2, 0, 5));
+    //Clipped at the end of the contig
+    EXPECT_EQ("NA", ref1.sequence(contig1, 16, 30));
+    EXPECT_EQ("", ref1.sequence(contig1, 18, 30));
+    EXPECT_EQ(2u, ref1.code(contig1, 2));
+    EXPECT_EQ(0u, ref1.code(contig1, 3) ^ 3u);
+    EXPECT_TRUE(ref1.is_n(contig1, 8));
+    EXPECT_TRUE(ref1.is_n(contig1, 16));
+    EXPECT_FALSE(ref1.is_n(contig1, 12));
+    EXPECT_TRUE(ref1.is_masked(contig1, 4));
+    EXPECT_TRUE(ref1.is_masked(contig1, 11));
+    EXPECT_FALSE(ref1.is_masked(contig1, 8));
+}
+
+//A packed copy that is already built is mapped as is
+TEST_F(PackedReferenceTest, Reopen) {
+    ref1.open(fa_file);
+    ref1.close();
+    EXPECT_FALSE(ref1.is_open());
+    PackedReference ref2;
+    ref2.open_packed(PackedReference::packed_file(fa_file));
+    uint32_t contig2;
+    ASSERT_TRUE(ref2.find_contig("2", contig2));
+    EXPECT_EQ("TTTTG", ref2.sequence(contig2, 0, 5));
+    EXPECT_THROW(ref2.open_packed(fa_file), std::runtime_error);
+}
+
+//Reverse complement, anything other than ACGT is N
+TEST_F(PackedReferenceTest, RevComp) {
+    EXPECT_EQ("ACGTN", common::rev_comp("NACGT"));
+    EXPECT_EQ("NNAC", common::rev_comp("GTag"));
+    EXPECT_EQ("", common::rev_comp(""));
+}
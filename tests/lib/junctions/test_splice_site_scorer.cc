@@ -0,0 +1,174 @@
+/*  test_splice_site_scorer.cc -- Unit-tests for the SpliceSiteScorer class
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "junctions_annotator.h"
+#include "splice_site_scorer.h"
+
+//The MaxEntScan tables are not shipped, the tests write synthetic
+//ones in the same layout. The expected scores were worked out from
+//these tables with the arithmetic of score5.pl and score3.pl.
+class SpliceSiteScorerTest : public ::testing::Test {
+    public:
+        string dir;
+        void SetUp() {
+            dir = "test_splice_models";
+            mkdir(dir.c_str(), 0755);
+            mkdir((dir + "/splicemodels").c_str(), 0755);
+            //Every 7 base sequence, last one first
+            const char bases[] = "ACGT";
+            const int n_donor = 1 << 14;
+            ofstream sequences((dir + "/splicemodels/splice5sequences").c_str());
+            ofstream me2x5((dir + "/me2x5").c_str());
+            for(int i = 0; i < n_donor; i++) {
+                int code = n_donor - 1 - i;
+                for(int shift = 12; shift >= 0; shift -= 2)
+                    sequences << bases[(code >> shift) & 3];
+                sequences << "\n";
+                me2x5 << 1 + (i % 97) / 10.0 << "\n";
+            }
+            const int lengths[9] = {7, 7, 7, 7, 7, 3, 4, 3, 4};
+            for(int k = 1; k <= 9; k++) {
+                ofstream table(acceptor_table(k).c_str());
+                for(int j = 0; j < 1 << (2 * lengths[k - 1]); j++)
+                    table << 1 + ((j * 31 + k) % 89) / 16.0 << "\n";
+            }
+        }
+        void TearDown() {
+            remove((dir + "/splicemodels/splice5sequences").c_str());
+            remove((dir + "/me2x5").c_str());
+            for(int k = 1; k <= 9; k++)
+                remove(acceptor_table(k).c_str());
+            rmdir((dir + "/splicemodels").c_str());
+            rmdir(dir.c_str());
+        }
+        string acceptor_table(int k) {
+            stringstream ss;
+            ss << dir << "/splicemodels/me2x3acc" << k;
+            return ss.str();
+        }
+        static string to_str(double score) {
+            stringstream ss;
+            AnnotatedJunction::print_splice_score(ss, score);
+            return ss.str();
+        }
+};
+
+TEST_F(SpliceSiteScorerTest, Scores) {
+    SpliceSiteScorer scorer;
+    scorer.load(dir);
+    double score;
+    ASSERT_TRUE(scorer.score_donor("CAGGTAAGT", score));
+    EXPECT_EQ("5.86", to_str(score));
+    ASSERT_TRUE(scorer.score_donor("gggGTGAGG", score));
+    EXPECT_EQ("6.81", to_str(score));
+    ASSERT_TRUE(scorer.score_acceptor("TTTCTTTTTTTTTTTTTTAGGTC", score));
+    EXPECT_EQ("7.70", to_str(score));
+    ASSERT_TRUE(scorer.score_acceptor("CCTGCAATACGTAGCCAGACGTT", score));
+    EXPECT_EQ("-4.86", to_str(score));
+    EXPECT_FALSE(scorer.score_donor("CAGGTNAGT", score));
+    EXPECT_FALSE(scorer.score_acceptor("TTTCTTTTTTTTTTTTTTNGGTC", score));
+    EXPECT_EQ("NA", to_str(NAN));
+}
+
+TEST_F(SpliceSiteScorerTest, BadModels) {
+    SpliceSiteScorer scorer;
+    EXPECT_THROW(scorer.load("test_splice_models_missing"),
+                 std::runtime_error);
+    //A value that is not a number
+    {
+        ofstream table(acceptor_table(6).c_str());
+        table << "1.5\nx\n";
+    }
+    EXPECT_THROW(scorer.load(dir), std::runtime_error);
+    //A table with too few values
+    {
+        ofstream table(acceptor_table(6).c_str());
+        table << "1.5\n";
+    }
+    EXPECT_THROW(scorer.load(dir), std::runtime_error);
+    //A sequence listed twice
+    {
+        ofstream sequences((dir + "/splicemodels/splice5sequences").c_str());
+        sequences << "AAAAAAA\nAAAAAAA\n";
+    }
+    EXPECT_THROW(scorer.load(dir), std::runtime_error);
+}
+
+//The same splice sites score the same on either strand, junctions
+//too close to the ends of the contig or on an unknown strand are NA
+TEST_F(SpliceSiteScorerTest, AnnotatorStrands) {
+    string fa_file = "test_splice_scores.fa";
+    string plus = string("AAAAA") + "CAG" + "GTAAGT" + "ACGTACGTAC" +
+                  "TTTCTTTTTTTTTTTTTTAG" + "GTC" + "AAAAA";
+    ofstream out(fa_file.c_str());
+    out << ">plus\n" << plus << "\n"
+        << ">minus\n" << common::rev_comp(plus) << "\n";
+    out.close();
+    remove((fa_file + ".fai").c_str());
+    int argc = 6;
+    char * argv[] = {"annotate",
+                     "-s", (char *) dir.c_str(),
+                     "test.bed",
+                     (char *) fa_file.c_str(),
+                     "test.gtf"};
+    JunctionsAnnotator ja2;
+    ja2.parse_options(argc, argv);
+    ASSERT_TRUE(ja2.score_splice_sites());
+    const char *chroms[] = {"plus", "minus"};
+    const char *strands[] = {"+", "-"};
+    for(int i = 0; i < 2; i++) {
+        AnnotatedJunction line;
+        line.chrom = chroms[i];
+        line.start = 8;
+        line.end = 45;
+        line.strand = strands[i];
+        ja2.get_splice_site(line);
+        EXPECT_EQ("GT-AG", line.splice_site);
+        EXPECT_EQ("5.86", to_str(line.donor_score));
+        EXPECT_EQ("7.70", to_str(line.acceptor_score));
+    }
+    AnnotatedJunction line;
+    line.chrom = "plus";
+    line.start = 8;
+    line.end = 45;
+    line.strand = "?";
+    ja2.get_splice_site(line);
+    EXPECT_EQ("NA", to_str(line.donor_score));
+    EXPECT_EQ("NA", to_str(line.acceptor_score));
+    //The acceptor context runs off the end of the contig
+    line.strand = "+";
+    line.end = 52;
+    ja2.get_splice_site(line);
+    EXPECT_EQ("5.86", to_str(line.donor_score));
+    EXPECT_EQ("NA", to_str(line.acceptor_score));
+    remove(fa_file.c_str());
+    remove((fa_file + ".fai").c_str());
+}
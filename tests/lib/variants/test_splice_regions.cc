@@ -0,0 +1,412 @@
+/*  test_splice_regions.cc -- Unit-tests for the splice region index
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include "splice_regions.h"
+#include "variants_annotator.h"
+
+//The per exon check VariantsAnnotator used before the splice region
+//index, kept as the reference the index is checked against
+class PerExonCheck {
+    private:
+        SpliceRegionOptions options_;
+        void set_variant_cis_effect_limits(const ExonView &exons,
+                                           AnnotatedVariant& variant,
+                                           uint32_t i);
+        void set_variant_cis_effect_limits_ns(const ExonView &exons,
+                                              AnnotatedVariant& variant,
+                                              uint32_t i);
+        void set_variant_cis_effect_limits_ps(const ExonView &exons,
+                                              AnnotatedVariant& variant,
+                                              uint32_t i);
+        void get_variant_overlaps_spliceregion_ps(const ExonView &exons,
+                                                  AnnotatedVariant &variant);
+        void get_variant_overlaps_spliceregion_ns(const ExonView &exons,
+                                                  AnnotatedVariant &variant);
+    public:
+        PerExonCheck(const SpliceRegionOptions &options)
+            : options_(options) {}
+        //Check if the variant is in a splice relevant region of a
+        //transcript, the result is stored in variant
+        void get_variant_overlaps_spliceregion(const ExonView &exons,
+                                               AnnotatedVariant &variant);
+};
+
+//Set limits on + strand
+void PerExonCheck::set_variant_cis_effect_limits_ps(const ExonView &exons,
+                                                      AnnotatedVariant& variant,
+                                                      uint32_t i) {
+    //Check if the cis effect limits have increased.
+    if(i != 0) {
+        if(exons[i-1].start < variant.cis_effect_start) {
+            variant.cis_effect_start = exons[i-1].start;
+        }
+    } else {
+        if(exons[0].start < variant.cis_effect_start) {
+            variant.cis_effect_start = exons[0].start;
+        }
+    }
+    if(i != exons.size() - 1) {
+        if(exons[i+1].end > variant.cis_effect_end) {
+            variant.cis_effect_end = exons[i+1].end;
+        }
+    } else {
+        if(exons[exons.size() - 1].end > variant.cis_effect_end) {
+            variant.cis_effect_end = exons[exons.size() - 1].end;
+        }
+    }
+    return;
+}
+
+//Set limits on - strand
+void PerExonCheck::set_variant_cis_effect_limits_ns(const ExonView &exons,
+                                                      AnnotatedVariant& variant,
+                                                      uint32_t i) {
+    if(i != 0) {
+        //Check if the cis effect limits have increased.
+        if(exons[i-1].end > variant.cis_effect_end) {
+            variant.cis_effect_end = exons[i-1].end;
+        }
+    } else {
+        if(exons[0].end > variant.cis_effect_end) {
+            variant.cis_effect_end = exons[0].end;
+        }
+    }
+    if(i != exons.size() -1) {
+        if(exons[i+1].start < variant.cis_effect_start) {
+            variant.cis_effect_start = exons[i+1].start;
+        }
+    } else {
+        if(exons[exons.size() - 1].start < variant.cis_effect_start) {
+            variant.cis_effect_start = exons[exons.size() - 1].start;
+        }
+    }
+    return;
+}
+
+//Get the coordinates which limit the effect of this variant.
+//The cis-splice-effects command uses these fields to pull out
+//junctions which might be related to the presence of this variant.
+//This is set to the nearest acceptor and donor of the neigboring
+//exons. The calculation will vary according to the strand of this
+//transcript.
+void PerExonCheck::set_variant_cis_effect_limits(const ExonView &exons,
+                                                      AnnotatedVariant& variant,
+                                                      uint32_t i) {
+    if(exons.strand() == STRAND_PLUS) {
+        set_variant_cis_effect_limits_ps(exons, variant, i);
+        return;
+    }
+    if(exons.strand() == STRAND_MINUS) {
+        set_variant_cis_effect_limits_ns(exons, variant, i);
+        return;
+    }
+}
+
+//Overlap splice region in the negative strand
+void PerExonCheck::get_variant_overlaps_spliceregion_ns(const ExonView &exons,
+                                                      AnnotatedVariant& variant) {
+    variant.score = "-1";
+    variant.annotation = "non_splice_region";
+    //check if variant inside transcript coords for negative strand
+    if(exons[exons.size() - 1].start > variant.end ||
+       exons[0].end < variant.end) {
+        return;
+    }
+    for(uint32_t i = 0; i < exons.size(); i++) {
+        if(options_.all_exonic_space) {
+            //The exon start and end are in 1-based
+            if(variant.end >= exons[i].start && variant.end <= exons[i].end) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
+                                                        exons[i].end - variant.end));
+                variant.annotation = "exonic";
+                return;
+            }
+        }
+        if(options_.all_intronic_space) {
+            //The exon start and end are in 1-based
+            if(i != exons.size() - 1 && variant.end < exons[i].start && variant.end > exons[i+1].end) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i+1].end,
+                                                        exons[i].start - variant.end));
+                variant.annotation = "intronic";
+                return;
+            }
+        }
+        {
+            //the rest of the exons are outside the junction - ns
+            if(exons[i].end + options_.intronic_min_distance < variant.end) {
+                return;
+            }
+            //exonic near start and not last exon
+            if(i != exons.size() - 1 && variant.end >= exons[i].start &&
+               variant.end <= exons[i].end &&
+               variant.end <= exons[i].start + options_.exonic_min_distance) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
+                                                        exons[i].end - variant.end));
+                variant.annotation = "splicing_exonic";
+                set_variant_cis_effect_limits(exons, variant, i);
+                return;
+            }
+            //intronic near start (make sure not first/last exon.)
+            //make sure this isn't exonic in next exon
+            if(variant.end < exons[i].start &&
+            variant.end >= exons[i].start - options_.intronic_min_distance &&
+            i != exons.size() - 1 && variant.end > exons[i+1].end) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i+1].end,
+                                                        exons[i].start - variant.end));
+                variant.annotation = "splicing_intronic";
+                set_variant_cis_effect_limits(exons, variant, i);
+                return;
+            }
+            //exonic near end and not first exon
+            if(i != 0 &&
+               variant.end <= exons[i].end &&
+               variant.end >= exons[i].start &&
+               variant.end >= exons[i].end - options_.exonic_min_distance) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
+                                                        exons[i].end - variant.end));
+                variant.annotation = "splicing_exonic";
+                set_variant_cis_effect_limits(exons, variant, i);
+                return;
+            }
+            //intronic near end (make sure not first/last exon.)
+            //make sure this isn't exonic in prev exon
+            if(variant.end > exons[i].end &&
+            variant.end <= exons[i].end + options_.intronic_min_distance &&
+            i != 0 && variant.end < exons[i-1].start) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].end,
+                                                        exons[i-1].start - variant.end));
+                variant.annotation = "splicing_intronic";
+                set_variant_cis_effect_limits(exons, variant, i);
+                return;
+            }
+        }
+    }
+    return;
+}
+
+//Overlap splice region in the positive strand
+void PerExonCheck::get_variant_overlaps_spliceregion_ps(const ExonView &exons,
+                                                             AnnotatedVariant& variant) {
+    variant.score = "-1";
+    variant.annotation = "non_splice_region";
+    //check if variant inside transcript coords for positive strand
+    if(exons[0].start > variant.end ||
+       exons[exons.size() - 1].end < variant.end) {
+        return;
+    }
+    for(uint32_t i = 0; i < exons.size(); i++) {
+        if(options_.all_exonic_space) {
+            //The exon start and end are in 1-based
+            if(variant.end >= exons[i].start &&
+               variant.end <= exons[i].end) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
+                                                        exons[i].end - variant.end));
+                variant.annotation = "exonic";
+                return;
+            }
+        }
+        if(options_.all_intronic_space) {
+            //The exon start and end are in 1-based
+            if(i != exons.size() - 1 &&
+               variant.end > exons[i].end && variant.end < exons[i+1].start) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].end,
+                                                        exons[i+1].start - variant.end));
+                variant.annotation = "intronic";
+                return;
+            }
+        }
+        {
+            //the rest of the exons are outside the junction - ps
+            if(exons[i].start - options_.intronic_min_distance > variant.end) {
+                return;
+            }
+            //exonic near start and not first exon
+            if(i != 0 &&
+               variant.end >= exons[i].start &&
+               variant.end <= exons[i].end &&
+               variant.end <= exons[i].start + options_.exonic_min_distance) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
+                                                        exons[i].end - variant.end));
+                variant.annotation = "splicing_exonic";
+                set_variant_cis_effect_limits(exons, variant, i);
+                return;
+            }
+            //intronic near start (make sure not first/last exon.)
+            //make sure this isn't exonic in prev exon
+            if(variant.end < exons[i].start &&
+            variant.end >= exons[i].start - options_.intronic_min_distance &&
+            i != 0 && variant.end > exons[i-1].end) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i-1].end,
+                                                        exons[i].start - variant.end));
+                variant.annotation = "splicing_intronic";
+                set_variant_cis_effect_limits(exons, variant, i);
+                return;
+            }
+            //exonic near end
+            if(i != exons.size() - 1 &&
+               variant.end <= exons[i].end &&
+               variant.end >= exons[i].start &&
+               variant.end >= exons[i].end - options_.exonic_min_distance) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].start,
+                                                        exons[i].end - variant.end));
+                variant.annotation = "splicing_exonic";
+                set_variant_cis_effect_limits(exons, variant, i);
+                return;
+            }
+            //intronic near end (make sure not first/last exon.)
+            //make sure this isn't exonic in next exon
+            if(variant.end > exons[i].end &&
+            variant.end <= exons[i].end + options_.intronic_min_distance &&
+            i != exons.size() - 1 && variant.end < exons[i+1].start) {
+                variant.score =  common::num_to_str(min(variant.end - exons[i].end,
+                                                        exons[i+1].start - variant.end));
+                variant.annotation = "splicing_intronic";
+                set_variant_cis_effect_limits(exons, variant, i);
+                return;
+            }
+        }
+    }
+    return;
+}
+
+//Given a transcript ID and variant position,
+//check if the variant is in a splice relevant region
+//relevance depends on the user params
+//options_.intronic_min_distance and options_.exonic_min_distance
+//The zero-based arithmetic is always fun.
+//The variant object is one-based.
+//GTF i.e the exon is one based
+void PerExonCheck::get_variant_overlaps_spliceregion(const ExonView &exons,
+                                                      AnnotatedVariant& variant) {
+    if(exons.strand() == STRAND_PLUS) {
+        get_variant_overlaps_spliceregion_ps(exons, variant);
+    } else if (exons.strand() == STRAND_MINUS) {
+        get_variant_overlaps_spliceregion_ns(exons, variant);
+    } else {
+        throw runtime_error("Unknown strand " +
+                            string(strand_to_str(exons.strand())));
+    }
+    return;
+}
+
+//Random transcripts with short exons and introns, some exons overlap
+class SpliceRegionsTest : public ::testing::Test {
+    public:
+        ContigTranscripts contig;
+        CHRPOS contig_end;
+        SpliceRegionsTest() : contig("1"), contig_end(0) {}
+        void SetUp() {
+            srand(47);
+            for(int t = 0; t < 200; t++) {
+                Strand strand = rand() % 2 ? STRAND_PLUS : STRAND_MINUS;
+                int n_exons = 1 + rand() % 5;
+                CHRPOS pos = 1 + rand() % 500;
+                for(int i = 0; i < n_exons; i++) {
+                    CHRPOS start = pos;
+                    if(i != 0 && rand() % 8 == 0)
+                        start -= rand() % 10;
+                    CHRPOS end = start + rand() % 30;
+                    contig.add_exon("T" + common::num_to_str(t),
+                                    "G" + common::num_to_str(t / 3),
+                                    strand, start, end);
+                    pos = end + 1 + rand() % 20;
+                }
+                contig_end = max(contig_end, pos);
+            }
+            contig.build_index();
+        }
+        //Check every position of every transcript against the per
+        //exon check with the options in argv
+        void check(int argc, char *argv[]) {
+            VariantsAnnotator va;
+            va.parse_options(argc, argv);
+            SpliceRegionOptions options = va.splice_region_options();
+            ContigSpliceRegions regions(contig, options);
+            PerExonCheck per_exon(options);
+            const TranscriptIndex &index = regions.index();
+            for(CHRPOS pos = 1; pos <= contig_end; pos++) {
+                vector<string> found(contig.n_transcripts(), "non_splice_region");
+                vector<string> distances(contig.n_transcripts(), "-1");
+                vector<CHRPOS> cis_starts(contig.n_transcripts(), 0);
+                vector<CHRPOS> cis_ends(contig.n_transcripts(), 0);
+                size_t first, last;
+                index.overlap(pos, pos, first, last);
+                for(size_t i = first; i < last; i++) {
+                    if(!index.overlaps(i, pos, pos))
+                        continue;
+                    const SpliceRegion &r1 = regions.region(index.transcript(i));
+                    ASSERT_EQ("non_splice_region", found[r1.transcript]);
+                    found[r1.transcript] = splice_region_type_to_str(r1.type);
+                    distances[r1.transcript] = common::num_to_str(r1.distance(pos));
+                    if(r1.has_cis_effect()) {
+                        cis_starts[r1.transcript] = r1.cis_effect_start;
+                        cis_ends[r1.transcript] = r1.cis_effect_end;
+                    }
+                }
+                for(uint32_t t = 0; t < contig.n_transcripts(); t++) {
+                    ExonView exons = contig.exons(t);
+                    AnnotatedVariant v1("1", pos - 1, pos);
+                    v1.annotation = "non_splice_region";
+                    v1.score = "-1";
+                    //The variant has to be in the span of the transcript
+                    //in the index, and single exon transcripts are skipped
+                    //unless -S
+                    CHRPOS start = min(exons[0].start, exons[exons.size() - 1].start);
+                    CHRPOS end = max(exons[0].end, exons[exons.size() - 1].end);
+                    if(start <= pos && pos <= end &&
+                       (exons.size() > 1 || !options.skip_single_exon_genes)) {
+                        per_exon.get_variant_overlaps_spliceregion(exons, v1);
+                    }
+                    if(v1.cis_effect_end == 0)
+                        v1.cis_effect_start = 0;
+                    EXPECT_EQ(v1.annotation, found[t]) << "T" << t << " at " << pos;
+                    EXPECT_EQ(v1.score, distances[t]) << "T" << t << " at " << pos;
+                    EXPECT_EQ(v1.cis_effect_start, cis_starts[t]);
+                    EXPECT_EQ(v1.cis_effect_end, cis_ends[t]);
+                }
+            }
+        }
+};
+
+TEST_F(SpliceRegionsTest, Default) {
+    char *argv[] = {"annotate", "in.vcf", "in.gtf"};
+    check(3, argv);
+}
+
+TEST_F(SpliceRegionsTest, SingleExon) {
+    char *argv[] = {"annotate", "-S", "in.vcf", "in.gtf"};
+    check(4, argv);
+}
+
+TEST_F(SpliceRegionsTest, ExonicAndIntronicSpace) {
+    char *argv[] = {"annotate", "-E", "-I", "-S", "in.vcf", "in.gtf"};
+    check(6, argv);
+}
+
+TEST_F(SpliceRegionsTest, WideRegions) {
+    char *argv[] = {"annotate", "-e", "12", "-i", "800", "in.vcf", "in.gtf"};
+    check(7, argv);
+}
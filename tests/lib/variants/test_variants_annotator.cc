@@ -23,6 +23,8 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.  */
 
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
 #include "variants_annotator.h"
 
 class VariantsAnnotatorTest : public ::testing::Test {
@@ -37,3 +39,177 @@ TEST_F(VariantsAnnotatorTest, LessThanOperator) {
     ASSERT_EQ(av1, av2);
     ASSERT_LT(av1, av3);
 }
+
+//Two transcripts of one gene on contig 1, a third gene on contig 2
+class VariantsAnnotatorSweepTest : public ::testing::Test {
+    public:
+        string gtf_file;
+        void SetUp() {
+            gtf_file = "test_variants_sweep.gtf";
+            ofstream out(gtf_file.c_str());
+            const char *exons[] = {
+                "1\t100\t200\t+\tG1\tT1",
+                "1\t300\t400\t+\tG1\tT1",
+                "1\t500\t600\t+\tG1\tT1",
+                "1\t100\t200\t+\tG1\tT2",
+                "1\t500\t700\t+\tG1\tT2",
+                "2\t1000\t1100\t-\tG2\tT3",
+                "2\t2000\t2100\t-\tG2\tT3"
+            };
+            for(size_t i = 0; i < 7; i++) {
+                vector<string> f;
+                Tokenize(exons[i], f, '\t');
+                out << f[0] << "\ttest\texon\t" << f[1] << "\t" << f[2] <<
+                       "\t.\t" << f[3] << "\t.\tgene_id \"" << f[4] <<
+                       "\"; transcript_id \"" << f[5] << "\"; gene_name \"" <<
+                       f[4] << "\";\n";
+            }
+            out.close();
+        }
+        void TearDown() {
+            remove(gtf_file.c_str());
+        }
+        //Annotation of a variant as genes|transcripts|distances|annotations
+        static string summary(const AnnotatedVariant &v1) {
+            return v1.overlapping_genes + "|" + v1.overlapping_transcripts +
+                   "|" + v1.overlapping_distances + "|" + v1.annotation;
+        }
+};
+
+//Sorted variants are annotated with the sweep, going back falls back
+//to the index lookup, both give the same annotation
+TEST_F(VariantsAnnotatorSweepTest, SortedAndUnsorted) {
+    GtfHandle gtf = load_annotation(gtf_file);
+    const char *chroms[] = {"1", "1", "1", "1", "1", "2", "2"};
+    CHRPOS positions[] = {50, 199, 201, 450, 499, 1998, 1050};
+    const char *expected[] = {
+        "NA|NA|NA|NA",
+        "G1|T1,T2|0,0|splicing_exonic,splicing_exonic",
+        "G1|T1,T2|2,2|splicing_intronic,splicing_intronic",
+        "NA|NA|NA|NA",
+        "G1|T1,T2|0,0|splicing_exonic,splicing_exonic",
+        "G2|T3|1|splicing_intronic",
+        "NA|NA|NA|NA"
+    };
+    VariantsAnnotator sorted("NA", gtf, "NA");
+    for(size_t i = 0; i < 7; i++) {
+        EXPECT_EQ(expected[i],
+                  summary(sorted.annotate_position(chroms[i], positions[i])));
+    }
+    //Back to contig 1 turns the sweep off
+    VariantsAnnotator unsorted("NA", gtf, "NA");
+    for(size_t i = 7; i-- > 0; ) {
+        EXPECT_EQ(expected[i],
+                  summary(unsorted.annotate_position(chroms[i], positions[i])));
+    }
+    for(size_t i = 0; i < 7; i++) {
+        EXPECT_EQ(expected[i],
+                  summary(unsorted.annotate_position(chroms[i], positions[i])));
+    }
+}
+
+//The FORMAT and sample columns of a VCF are written as they were read,
+//only INFO gets the annotation
+TEST_F(VariantsAnnotatorSweepTest, SampleColumnsCopied) {
+    string vcf_in = "test_variants_samples.vcf";
+    string vcf_out = "test_variants_samples.out.vcf";
+    const char *samples[] = {
+        "GT:DP:AF\t0/1:07:0.50\t./.:.:.",
+        "GT:DP\t1|1:12\t0/0",
+        "GT\t0/1\t1/1"
+    };
+    ofstream out(vcf_in.c_str());
+    out << "##fileformat=VCFv4.1\n"
+           "##contig=<ID=1>\n"
+           "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">\n"
+           "##FORMAT=<ID=DP,Number=1,Type=Integer,Description=\"Depth\">\n"
+           "##FORMAT=<ID=AF,Number=1,Type=Float,Description=\"Fraction\">\n"
+           "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tS1\tS2\n";
+    out << "1\t200\t.\tA\tC\t.\t.\t.\t" << samples[0] << "\n";
+    out << "1\t450\t.\tA\tC\t.\t.\t.\t" << samples[1] << "\n";
+    out << "1\t500\t.\tA\tC\t.\t.\t.\t" << samples[2] << "\n";
+    out.close();
+    {
+        VariantsAnnotator va(vcf_in, load_annotation(gtf_file), vcf_out);
+        va.annotate_vcf();
+    }
+    ifstream in(vcf_out.c_str());
+    string line;
+    vector<string> records;
+    while(getline(in, line)) {
+        if(line[0] != '#')
+            records.push_back(line);
+    }
+    in.close();
+    remove(vcf_in.c_str());
+    remove(vcf_out.c_str());
+    ASSERT_EQ(3u, records.size());
+    for(size_t i = 0; i < 3; i++) {
+        vector<string> f;
+        Tokenize(records[i], f, '\t');
+        ASSERT_LT(8u, f.size());
+        string copied = f[8];
+        for(size_t j = 9; j < f.size(); j++)
+            copied += "\t" + f[j];
+        EXPECT_EQ(samples[i], copied);
+    }
+    EXPECT_NE(string::npos, records[0].find("transcripts=T1,T2;"));
+    EXPECT_NE(string::npos, records[1].find("genes=NA;"));
+}
+
+//A variant reused across positions is annotated like a new one, and
+//keeps its buffers once they are large enough
+TEST_F(VariantsAnnotatorSweepTest, ReusedVariant) {
+    GtfHandle gtf = load_annotation(gtf_file);
+    VariantsAnnotator va("NA", gtf, "NA");
+    CHRPOS positions[] = {199, 450, 201, 199};
+    AnnotatedVariant reused;
+    const char *transcripts_buffer = NULL;
+    for(size_t i = 0; i < 4; i++) {
+        va.annotate_position("1", positions[i], reused);
+        VariantsAnnotator fresh("NA", gtf, "NA");
+        AnnotatedVariant expected = fresh.annotate_position("1", positions[i]);
+        EXPECT_EQ(summary(expected), summary(reused));
+        EXPECT_EQ(expected.score, reused.score);
+        EXPECT_EQ(expected.cis_effect_start, reused.cis_effect_start);
+        EXPECT_EQ(expected.cis_effect_end, reused.cis_effect_end);
+        if(i == 0)
+            transcripts_buffer = reused.overlapping_transcripts.data();
+    }
+    EXPECT_EQ(transcripts_buffer, reused.overlapping_transcripts.data());
+}
+
+//Transcripts print by their start, then by transcript ID. TA sorts
+//first by ID but starts last, TC is on the negative strand.
+TEST_F(VariantsAnnotatorSweepTest, StartOrder) {
+    string order_gtf = "test_variants_order.gtf";
+    ofstream out(order_gtf.c_str());
+    const char *exons[] = {
+        "16385\t16390\t+\tGA\tTA",
+        "16400\t16500\t+\tGA\tTA",
+        "16000\t16200\t+\tGB\tTB",
+        "16400\t16600\t+\tGB\tTB",
+        "16400\t16600\t-\tGC\tTC",
+        "16000\t16200\t-\tGC\tTC"
+    };
+    for(size_t i = 0; i < 6; i++) {
+        vector<string> f;
+        Tokenize(exons[i], f, '\t');
+        out << "3\ttest\texon\t" << f[0] << "\t" << f[1] <<
+               "\t.\t" << f[2] << "\t.\tgene_id \"" << f[3] <<
+               "\"; transcript_id \"" << f[4] << "\"; gene_name \"" <<
+               f[3] << "\";\n";
+    }
+    out.close();
+    GtfHandle gtf = load_annotation(order_gtf);
+    VariantsAnnotator va("NA", gtf, "NA");
+    EXPECT_EQ("GB,GC,GA|TB,TC,TA|0,0,0|"
+              "splicing_exonic,splicing_exonic,splicing_exonic",
+              summary(va.annotate_position("3", 16399)));
+    //The score is the distance of the last transcript listed
+    AnnotatedVariant v1 = va.annotate_position("3", 16401);
+    EXPECT_EQ("TB,TC,TA", v1.overlapping_transcripts);
+    EXPECT_EQ("2", v1.score);
+    EXPECT_EQ("-1", va.annotate_position("3", 30000).score);
+    remove(order_gtf.c_str());
+}
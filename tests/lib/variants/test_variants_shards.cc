@@ -0,0 +1,87 @@
+/*  test_variants_shards.cc -- Unit-tests for joining BGZF shards
+
+    Copyright (c) 2015, The Griffith Lab
+
+    Author: Avinash Ramu <aramu@genome.wustl.edu>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.  */
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include "variants_shards.h"
+#include "htslib/bgzf.h"
+
+class JoinBgzfTest : public ::testing::Test {
+    public:
+        vector<string> files;
+        string output;
+        void SetUp() {
+            output = "test_join_bgzf.out.gz";
+        }
+        void TearDown() {
+            for(size_t i = 0; i < files.size(); i++)
+                remove(files[i].c_str());
+            remove(output.c_str());
+        }
+        //Write text to a new BGZF file
+        void write_bgzf(const string &text) {
+            string file = "test_join_bgzf." +
+                          common::num_to_str(files.size()) + ".gz";
+            BGZF *fp = bgzf_open(file.c_str(), "w");
+            ASSERT_TRUE(fp != NULL);
+            ASSERT_EQ((ssize_t) text.size(),
+                      bgzf_write(fp, text.data(), text.size()));
+            bgzf_close(fp);
+            files.push_back(file);
+        }
+        //Decompress a BGZF file
+        static string read_bgzf(const string &file) {
+            BGZF *fp = bgzf_open(file.c_str(), "r");
+            string text;
+            char buffer[4096];
+            ssize_t n;
+            while((n = bgzf_read(fp, buffer, sizeof(buffer))) > 0)
+                text.append(buffer, n);
+            bgzf_close(fp);
+            return text;
+        }
+};
+
+//The joined file decompresses to the files one after the other,
+//an empty file adds nothing
+TEST_F(JoinBgzfTest, Join) {
+    write_bgzf("##fileformat=VCFv4.1\n");
+    write_bgzf("");
+    string records;
+    for(int i = 0; i < 20000; i++)
+        records += "1\t" + common::num_to_str(i) + "\t.\tA\tC\t.\t.\t.\n";
+    write_bgzf(records);
+    join_bgzf_files(files, output);
+    EXPECT_EQ("##fileformat=VCFv4.1\n" + records, read_bgzf(output));
+}
+
+//A file that does not end with the BGZF end of file block
+TEST_F(JoinBgzfTest, NotBgzf) {
+    files.push_back("test_join_bgzf.txt");
+    ofstream out(files[0].c_str());
+    out << "not a BGZF file, not a BGZF file, not a BGZF file\n";
+    out.close();
+    EXPECT_THROW(join_bgzf_files(files, output), runtime_error);
+}